@@ -13,6 +13,22 @@
 #   endif
 #endif
 
+#ifndef SIA_INLINE
+#   if defined(_MSC_VER) && !defined(__cplusplus)
+#       define SIA_INLINE static __inline
+#   else
+#       define SIA_INLINE static inline
+#   endif
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#   define SIA_LIKELY(x) __builtin_expect(!!(x), 1)
+#   define SIA_UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#   define SIA_LIKELY(x) (x)
+#   define SIA_UNLIKELY(x) (x)
+#endif
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -30,6 +46,33 @@ typedef sia_i32 sia_b32;
 #define SIA_MiB(x) (sia_u64)((sia_u64)(x) << 20)
 #define SIA_GiB(x) (sia_u64)((sia_u64)(x) << 30) 
 
+#define SIA_ALIGN_UP_POW2(x, b) (((sia_u64)(x) + ((sia_u64)(b) - 1)) & (~((sia_u64)(b) - 1)))
+#define SIA_ALIGN_DOWN_POW2(x, b) ((sia_u64)(x) & (~((sia_u64)(b) - 1)))
+
+#ifndef SIA_MEMSET
+#   include <string.h>
+#   define SIA_MEMSET memset
+#endif
+
+#if defined(__SANITIZE_ADDRESS__)
+#   define SIA_ASAN
+#elif defined(__has_feature)
+#   if __has_feature(address_sanitizer)
+#       define SIA_ASAN
+#   endif
+#endif
+
+// Unused arena memory is poisoned in ASan builds, so overflows into
+// free space or into popped allocations get reported
+#if defined(SIA_ASAN) && !defined(SIA_NO_ASAN_POISON)
+#   include <sanitizer/asan_interface.h>
+#   define SIA_ASAN_POISON(ptr, size) ASAN_POISON_MEMORY_REGION((ptr), (size))
+#   define SIA_ASAN_UNPOISON(ptr, size) ASAN_UNPOISON_MEMORY_REGION((ptr), (size))
+#else
+#   define SIA_ASAN_POISON(ptr, size) ((void)(ptr), (void)(size))
+#   define SIA_ASAN_UNPOISON(ptr, size) ((void)(ptr), (void)(size))
+#endif
+
 typedef struct _sia_malloc_node {
     struct _sia_malloc_node* prev;
     sia_u64 size;
@@ -37,11 +80,63 @@ typedef struct _sia_malloc_node {
     sia_u8* data;
 } _sia_malloc_node;
 
+// Out-of-line allocation owned by an arena (e.g. a guarded allocation)
+// Released when the arena pops below end_pos
+typedef struct _sia_mapping {
+    struct _sia_mapping* prev;
+    sia_u64 end_pos;
+    void* base;
+    sia_u64 map_size;
+    // Large allocations keep this record in the arena, and the mapping is all data
+    sia_b32 is_large;
+    // Read only file mapping from sia_map_file, also with the record in the arena
+    sia_b32 is_file;
+} _sia_mapping;
+
+typedef void (sia_cleanup_func)(void* ptr);
+
+// Tagged push record, stored in the arena right before the allocation
+// The bytes go back to the tag when the arena pops below end_pos
+typedef struct _sia_tag_record {
+    struct _sia_tag_record* prev;
+    sia_u64 end_pos;
+    sia_u64 size;
+    sia_u32 tag;
+} _sia_tag_record;
+
+// Tag 0 is untagged, every other tag is below SIA_MAX_TAGS
+#ifndef SIA_MAX_TAGS
+#   define SIA_MAX_TAGS 8
+#endif
+#define SIA_TAG_NONE 0
+
+// Cleanup callback registered with sia_add_cleanup
+// Stored in the arena, and run when the arena pops below end_pos
+typedef struct _sia_cleanup {
+    struct _sia_cleanup* prev;
+    sia_u64 end_pos;
+    sia_cleanup_func* func;
+    void* ptr;
+} _sia_cleanup;
+
 typedef struct {
     _sia_malloc_node* cur_node;
+    // Total size of all nodes
+    sia_u64 node_total;
 } _sia_malloc_backend;
 typedef struct {
     sia_u64 commit_pos;
+
+    // Only used by arenas created with SIA_FLAG_CHECKPOINT
+    sia_i32 memfd;
+    sia_b32 in_checkpoint;
+    sia_u64 checkpoint_pos;
+    sia_u64 checkpoint_commit_pos;
+
+    // Set on arenas that live in a slot of an address space
+    struct sia_space* space;
+    // Can be more than the arena size, arenas that can go in the cache reserve a power of 2
+    sia_u64 reserve_size;
 } _sia_reserve_backend;
 
 typedef enum {
@@ -55,7 +150,13 @@ typedef enum {
     SIA_ERR_INVALID_PTR,
     SIA_ERR_MERGE_FAILED,
     SIA_ERR_POOL_FULL,
-    SIA_ERR_INVALID_POOL_PTR
+    SIA_ERR_INVALID_POOL_PTR,
+    SIA_ERR_INVALID_ALIGN,
+    SIA_ERR_CHECKPOINT_FAILED,
+    SIA_ERR_INVALID_HANDLE,
+    SIA_ERR_INVALID_TAG,
+    SIA_ERR_GOVERNOR_LIMIT,
+    SIA_ERR_IO_FAILED
 } sia_error_code;
 
 typedef struct {
@@ -65,31 +166,114 @@ typedef struct {
 
 typedef void (sia_error_callback)(sia_error error);
 
+struct si_arena;
+// Called by the tagged push that takes a tag over its budget, with the bytes the tag has now
+typedef void (sia_budget_callback)(struct si_arena* arena, sia_u32 tag, sia_u64 bytes);
+
+typedef enum {
+    SIA_FLAG_NONE = 0,
+    // Buffer arenas continue in a heap arena once the buffer is full
+    SIA_FLAG_OVERFLOW = 1 << 0,
+    // Backs the arena with a memfd so that it supports sia_checkpoint (Linux only)
+    SIA_FLAG_CHECKPOINT = 1 << 1,
+    // Pools only. Tracks free blocks with a bitmap per chunk instead of a free list
+    SIA_FLAG_BITMAP = 1 << 2,
+    // Doubles the commit step (node size for the malloc backend) while the arena grows,
+    // and drops it back to min_block_size when the arena pops back to the start
+    SIA_FLAG_ADAPTIVE = 1 << 3,
+    // Maps the whole arena readable and writable up front without reserving swap,
+    // so commits are bookkeeping only and rely on demand paging (Linux only)
+    SIA_FLAG_NORESERVE = 1 << 4,
+    // Commits (nodes for the malloc backend) count against the global governor
+    SIA_FLAG_GOVERNED = 1 << 5
+} sia_flags;
+
+typedef struct {
+    sia_u64 desired_max_size;
+    sia_u32 desired_block_size;
+    sia_u32 align;
+    sia_error_callback* error_callback;
+    sia_u32 guard_sample_rate;
+    sia_u32 flags;
+    // Shown by sia_registry_dump, must outlive the arena
+    const char* name;
+    // Pushes of at least this many bytes get their own mapping. 0 disables it
+    sia_u64 large_threshold;
+    // Bounds of the commit step with SIA_FLAG_ADAPTIVE, rounded like desired_block_size
+    sia_u32 min_block_size;
+    sia_u32 max_block_size;
+    // Takes a slot of this address space instead of reserving memory. Low level backend only
+    struct sia_space* space;
+    // Called when a tag goes over the budget set with sia_set_tag_budget
+    sia_budget_callback* budget_callback;
+} sia_desc;
 
 typedef struct {
+    // Created on the first push that does not fit in the buffer,
+    // and kept around until the buffer arena is destroyed
+    struct si_arena* overflow;
+    sia_desc overflow_desc;
+    sia_b32 overflowing;
+    // Arena position where the overflow arena takes over,
+    // and the position of the overflow arena at that point
+    sia_u64 overflow_pos;
+    sia_u64 overflow_start;
+} _sia_buffer_backend;
+
+typedef struct si_arena {
     sia_u64 _pos;
 
+    // Fast path state, kept up to date by the slow path.
+    // The next allocation is at address _fast_base + _pos,
+    // pushes can move _pos up to _fast_limit and pops can move it down to _fast_floor
+    sia_u64 _fast_base;
+    sia_u64 _fast_limit;
+    sia_u64 _fast_floor;
+
     sia_u64 _size;
+    // Current commit step, always between the two bounds
     sia_u64 _block_size;
+    sia_u64 _min_block_size;
+    sia_u64 _max_block_size;
     sia_u32 _align;
+    sia_u32 _flags;
 
     union {
         _sia_malloc_backend _malloc_backend;
         _sia_reserve_backend _reserve_backend;
+        _sia_buffer_backend _buffer_backend;
     };
 
+    sia_u32 _guard_sample_rate;
+    sia_u32 _guard_countdown;
+    sia_u64 _guard_rng;
+    // UINT64_MAX when disabled, so that the fast path only needs one compare
+    sia_u64 _large_threshold;
+    _sia_mapping* _mappings;
+    _sia_cleanup* _cleanups;
+
+    // Bytes of every tag, and their budgets (0 when there is none)
+    _sia_tag_record* _tag_records;
+    sia_u64 _tag_bytes[SIA_MAX_TAGS];
+    sia_u64 _tag_budgets[SIA_MAX_TAGS];
+    sia_budget_callback* _budget_callback;
+
+    // Lifetime statistics for sia_get_memory_stats
+    // _peak_pos is updated whenever the position goes down, so the current position may be above it
+    sia_u64 _peak_pos;
+    sia_u64 _num_commits;
+    sia_u64 _num_decommits;
+    sia_u64 _faulted_pages;
+
+    const char* _name;
+    sia_u32 _registry_slot;
+
     sia_error _last_error;
     sia_error_callback* error_callback;
 } si_arena;
 
-typedef struct {
-    sia_u64 desired_max_size;
-    sia_u32 desired_block_size;
-    sia_u32 align;
-    sia_error_callback* error_callback;
-} sia_desc;
-
 SIA_FUNC_DEF si_arena* sia_create(const sia_desc* desc);
+SIA_FUNC_DEF si_arena* sia_create_from_buffer(void* buf, sia_u64 size, const sia_desc* desc);
 SIA_FUNC_DEF void sia_destroy(si_arena* arena);
 
 SIA_FUNC_DEF sia_error sia_get_error(si_arena* arena);
@@ -101,23 +285,61 @@ SIA_FUNC_DEF sia_u32 sia_get_align(si_arena* arena);
 
 SIA_FUNC_DEF void* sia_push(si_arena* arena, sia_u64 size);
 SIA_FUNC_DEF void* sia_push_zero(si_arena* arena, sia_u64 size);
+SIA_FUNC_DEF void* sia_push_aligned(si_arena* arena, sia_u64 size, sia_u32 align);
+SIA_FUNC_DEF void* sia_push_zero_aligned(si_arena* arena, sia_u64 size, sia_u32 align);
 SIA_FUNC_DEF void* sia_realloc(si_arena* arena, void* ptr, sia_u64 old_size, sia_u64 new_size);
+SIA_FUNC_DEF void* sia_realloc_aligned(si_arena* arena, void* ptr, sia_u64 old_size, sia_u64 new_size, sia_u32 align);
 
 SIA_FUNC_DEF void sia_pop(si_arena* arena, sia_u64 size);
 SIA_FUNC_DEF void sia_pop_to(si_arena* arena, sia_u64 pos);
 
 SIA_FUNC_DEF void sia_reset(si_arena* arena);
 
+SIA_FUNC_DEF sia_b32 sia_add_cleanup(si_arena* arena, void* ptr, sia_cleanup_func* func);
+SIA_FUNC_DEF void* sia_push_with_cleanup(si_arena* arena, sia_u64 size, sia_cleanup_func* func);
+SIA_FUNC_DEF void* sia_push_aligned_with_cleanup(si_arena* arena, sia_u64 size, sia_u32 align, sia_cleanup_func* func);
+
+// Tagged pushes count their bytes against the tag until they are popped
+// Tag SIA_TAG_NONE pushes without counting
+SIA_FUNC_DEF void* sia_push_tagged(si_arena* arena, sia_u64 size, sia_u32 tag);
+SIA_FUNC_DEF void* sia_push_zero_tagged(si_arena* arena, sia_u64 size, sia_u32 tag);
+SIA_FUNC_DEF void* sia_push_aligned_tagged(si_arena* arena, sia_u64 size, sia_u32 align, sia_u32 tag);
+SIA_FUNC_DEF void* sia_realloc_tagged(si_arena* arena, void* ptr, sia_u64 old_size, sia_u64 new_size, sia_u32 tag);
+SIA_FUNC_DEF sia_u64 sia_get_tag_bytes(si_arena* arena, sia_u32 tag);
+// A budget of 0 removes it
+SIA_FUNC_DEF void sia_set_tag_budget(si_arena* arena, sia_u32 tag, sia_u64 budget);
+
 #define SIA_PUSH_STRUCT(arena, type) (type*)sia_push(arena, sizeof(type))
 #define SIA_PUSH_ZERO_STRUCT(arena, type) (type*)sia_push_zero(arena, sizeof(type))
 #define SIA_PUSH_ARRAY(arena, type, num) (type*)sia_push(arena, sizeof(type) * (num))
 #define SIA_PUSH_ZERO_ARRAY(arena, type, num) (type*)sia_push_zero(arena, sizeof(type) * (num))
+#define SIA_PUSH_ARRAY_ALIGNED(arena, type, num, align) (type*)sia_push_aligned(arena, sizeof(type) * (num), align)
+#define SIA_PUSH_ZERO_ARRAY_ALIGNED(arena, type, num, align) (type*)sia_push_zero_aligned(arena, sizeof(type) * (num), align)
 
 typedef struct {
     si_arena* arena;
     sia_u64 _pos;
 } sia_temp;
 
+typedef struct {
+    sia_u64 pos;
+    sia_u64 peak_pos;
+    sia_u64 size;
+    // Bytes of memory committed by the arena (the size of all nodes for the malloc backend)
+    sia_u64 committed;
+    // Bytes of committed memory that are currently in physical memory
+    sia_u64 resident;
+    // Bytes left unused at the end of every node before the current one (malloc backend)
+    sia_u64 slack;
+    // Commits and decommits for the low level backend, node allocations and frees for the malloc backend
+    sia_u64 num_commits;
+    sia_u64 num_decommits;
+    // Pages that were faulted in, counted from the resident pages when memory is decommitted
+    sia_u64 faulted_pages;
+} sia_memory_stats;
+
+SIA_FUNC_DEF sia_memory_stats sia_get_memory_stats(si_arena* arena);
+
 SIA_FUNC_DEF sia_temp sia_temp_begin(si_arena* arena);
 SIA_FUNC_DEF void sia_temp_end(sia_temp temp);
 
@@ -125,42 +347,112 @@ SIA_FUNC_DEF void sia_scratch_set_desc(const sia_desc* desc);
 SIA_FUNC_DEF sia_temp sia_scratch_get(si_arena** conflicts, sia_u32 num_conflicts);
 SIA_FUNC_DEF void sia_scratch_release(sia_temp scratch);
 
+// Thread local allocation scopes on the scratch arenas
+// sia_scope_get returns the arena of the innermost scope, or NULL outside of a scope
+SIA_FUNC_DEF void sia_scope_begin(void);
+SIA_FUNC_DEF void sia_scope_end(void);
+SIA_FUNC_DEF si_arena* sia_scope_get(void);
+
 SIA_FUNC_DEF si_arena*  sia_merge(si_arena** arenas, sia_u32 num_arenas);
 
+typedef struct {
+    si_arena* arena;
+    sia_u64 _pos;
+} sia_snapshot;
+
+SIA_FUNC_DEF sia_snapshot sia_checkpoint(si_arena* arena);
+SIA_FUNC_DEF void sia_rollback(sia_snapshot snapshot);
+SIA_FUNC_DEF void sia_accept(sia_snapshot snapshot);
+
+// Inline versions of the push and pop functions above
+// Only the bump fast path is inlined at the call site, everything else calls the slow paths
+SIA_INLINE void* sia_push_fast(si_arena* arena, sia_u64 size);
+SIA_INLINE void* sia_push_zero_fast(si_arena* arena, sia_u64 size);
+SIA_INLINE void* sia_push_aligned_fast(si_arena* arena, sia_u64 size, sia_u32 align);
+SIA_INLINE void* sia_push_zero_aligned_fast(si_arena* arena, sia_u64 size, sia_u32 align);
+SIA_INLINE void sia_pop_fast(si_arena* arena, sia_u64 size);
+
+// Slow paths of the inline functions below
+// These handle commits, new nodes, sampling, and errors
+SIA_FUNC_DEF void* _sia_push_slow(si_arena* arena, sia_u64 size, sia_u32 align);
+SIA_FUNC_DEF void _sia_pop_slow(si_arena* arena, sia_u64 size);
+
+#ifdef SIA_ENABLE_TRACE
+// Traced functions wrap the real implementation, which gets this name instead
+#   define _SIA_TRACED(name) _##name##_untraced
+SIA_FUNC_DEF void* _sia_push_traced(si_arena* arena, sia_u64 size, sia_u32 align);
+SIA_FUNC_DEF void _sia_pop_traced(si_arena* arena, sia_u64 size);
+#else
+#   define _SIA_TRACED(name) name
+#endif
 
-typedef struct _sia_pool_block{
-    struct _sia_pool_block* next;
-} _sia_pool_block;
+SIA_INLINE void* _SIA_TRACED(sia_push_aligned_fast)(si_arena* arena, sia_u64 size, sia_u32 align) {
+    sia_u64 base = arena->_fast_base;
+    sia_u64 start = SIA_ALIGN_UP_POW2(base + arena->_pos, align) - base;
+    sia_u64 end = start + size;
+
+    if (SIA_UNLIKELY(
+        end > arena->_fast_limit || end < start ||
+        align == 0 || (align & (align - 1)) != 0 ||
+        arena->_guard_countdown <= 1 || size >= arena->_large_threshold
+    )) {
+        return _sia_push_slow(arena, size, align);
+    }
 
-typedef struct{
-    si_arena* arena;
-    sia_u64 block_size;
-    sia_u32 align;
+    // With sampling disabled, the countdown stays at its maximum
+    if (arena->_guard_sample_rate != 0) {
+        arena->_guard_countdown--;
+    }
+    arena->_pos = end;
 
-    _sia_pool_block* free_list;
-    sia_u64 total_blocks;
-    sia_u64 free_blocks;
-    void* block_memory;
-} _sia_pool;
+    void* out = (void*)(uintptr_t)(base + start);
+    SIA_ASAN_UNPOISON(out, size);
 
-typedef struct {
-    si_arena* arena;
-    sia_u64 block_size;
-    sia_u32 align;
-    sia_u64 initial_capacity;
-} sia_pool_desc;
+    return out;
+}
+
+#ifdef SIA_ENABLE_TRACE
+SIA_INLINE void* sia_push_aligned_fast(si_arena* arena, sia_u64 size, sia_u32 align) {
+    return _sia_push_traced(arena, size, align);
+}
+#endif
+
+SIA_INLINE void* sia_push_zero_aligned_fast(si_arena* arena, sia_u64 size, sia_u32 align) {
+    void* out = sia_push_aligned_fast(arena, size, align);
+    if (SIA_LIKELY(out != NULL)) {
+        SIA_MEMSET(out, 0, size);
+    }
+
+    return out;
+}
+
+SIA_INLINE void* sia_push_fast(si_arena* arena, sia_u64 size) {
+    return sia_push_aligned_fast(arena, size, arena->_align);
+}
+
+SIA_INLINE void* sia_push_zero_fast(si_arena* arena, sia_u64 size) {
+    return sia_push_zero_aligned_fast(arena, size, arena->_align);
+}
+
+SIA_INLINE void _SIA_TRACED(sia_pop_fast)(si_arena* arena, sia_u64 size) {
+    sia_u64 new_pos = arena->_pos - size;
+    arena->_peak_pos = arena->_pos > arena->_peak_pos ? arena->_pos : arena->_peak_pos;
+
+    if (SIA_UNLIKELY(size > arena->_pos || new_pos < arena->_fast_floor)) {
+        _sia_pop_slow(arena, size);
+        return;
+    }
+
+    SIA_ASAN_POISON((void*)(uintptr_t)(arena->_fast_base + new_pos), size);
+    arena->_pos = new_pos;
+}
+
+#ifdef SIA_ENABLE_TRACE
+SIA_INLINE void sia_pop_fast(si_arena* arena, sia_u64 size) {
+    _sia_pop_traced(arena, size);
+}
+#endif
 
-// Memory Pool functions
-SIA_FUNC_DEF sia_pool* sia_pool_create(const sia_pool_desc* desc);
-SIA_FUNC_DEF void sia_pool_destroy(sia_pool* pool);
-SIA_FUNC_DEF void* sia_pool_alloc(sia_pool* pool);
-SIA_FUNC_DEF void* sia_pool_alloc_zero(sia_pool* pool);
-SIA_FUNC_DEF void sia_pool_free(sia_pool* pool, void* ptr);
-SIA_FUNC_DEF sia_b32 sia_pool_grow(sia_pool* pool, sia_u64 num_blocks);
-SIA_FUNC_DEF sia_u64 sia_pool_get_block_size(sia_pool* pool);
-SIA_FUNC_DEF sia_u64 sia_pool_get_capacity(sia_pool* pool);
-SIA_FUNC_DEF sia_u64 sia_pool_get_used(sia_pool* pool);
-SIA_FUNC_DEF sia_u64 sia_pool_get_free(sia_pool* pool);
 
 // Memory Pool structures
 typedef struct _sia_pool_block {
@@ -175,6 +467,19 @@ typedef struct {
     sia_u64 total_blocks;
     sia_u64 free_blocks;
     void* block_memory;
+    const char* name;
+    sia_u32 _registry_slot;
+    sia_u32 flags;
+
+    // Only used by pools created with SIA_FLAG_BITMAP
+    struct _sia_pool_chunk* _chunks;
+    struct _sia_pool_chunk* _last_chunk;
+    // No chunk before this one has a free block
+    struct _sia_pool_chunk* _hint;
+    sia_u32 _chunk_size;
+    sia_u32 _chunk_header;
+    sia_u32 _chunk_blocks;
+    sia_u32 tag;
 } sia_pool;
 
 typedef struct {
@@ -182,6 +487,12 @@ typedef struct {
     sia_u64 block_size;
     sia_u32 align;
     sia_u64 initial_capacity;
+    // Shown by sia_registry_dump, must outlive the pool
+    const char* name;
+    // Combination of sia_flags, only SIA_FLAG_BITMAP applies to pools
+    sia_u32 flags;
+    // Memory of the pool counts against this tag of its arena
+    sia_u32 tag;
 } sia_pool_desc;
 
 // Memory Pool functions
@@ -190,6 +501,8 @@ SIA_FUNC_DEF void sia_pool_destroy(sia_pool* pool);
 SIA_FUNC_DEF void* sia_pool_alloc(sia_pool* pool);
 SIA_FUNC_DEF void* sia_pool_alloc_zero(sia_pool* pool);
 SIA_FUNC_DEF void sia_pool_free(sia_pool* pool, void* ptr);
+SIA_FUNC_DEF sia_b32 sia_pool_alloc_n(sia_pool* pool, void** ptrs, sia_u64 num);
+SIA_FUNC_DEF void sia_pool_free_n(sia_pool* pool, void** ptrs, sia_u64 num);
 SIA_FUNC_DEF sia_b32 sia_pool_grow(sia_pool* pool, sia_u64 num_blocks);
 SIA_FUNC_DEF sia_u64 sia_pool_get_block_size(sia_pool* pool);
 SIA_FUNC_DEF sia_u64 sia_pool_get_capacity(sia_pool* pool);
@@ -199,6 +512,404 @@ SIA_FUNC_DEF sia_u64 sia_pool_get_free(sia_pool* pool);
 #define SIA_POOL_ALLOC_STRUCT(pool, type) (type*)sia_pool_alloc(pool)
 #define SIA_POOL_ALLOC_ZERO_STRUCT(pool, type) (type*)sia_pool_alloc_zero(pool)
 
+// Refers to an item of a slot map. Handles are never 0
+typedef struct {
+    sia_u32 index;
+    sia_u32 gen;
+} sia_handle;
+
+typedef struct {
+    // Index of the item while the slot is used, or the next free slot
+    sia_u32 target;
+    // Odd while the slot is used
+    sia_u32 gen;
+} _sia_slot;
+
+// Items that stay densely packed, referred to by handles that survive items moving around
+typedef struct {
+    si_arena* arena;
+    sia_u64 item_size;
+    sia_u32 align;
+
+    // Items, the slot of each item, and the slots share one allocation in the arena.
+    // items is a plain array of count items, item_size bytes apart
+    void* items;
+    sia_u32* _item_slots;
+    _sia_slot* _slots;
+    sia_u32 count;
+    sia_u32 capacity;
+    sia_u32 _num_slots;
+    sia_u32 _free_slot;
+} sia_slot_map;
+
+typedef struct {
+    si_arena* arena;
+    sia_u64 item_size;
+    // Alignment of the items array, defaults to the alignment of the arena
+    sia_u32 align;
+    sia_u32 initial_capacity;
+} sia_slot_map_desc;
+
+// Slot map functions
+SIA_FUNC_DEF sia_slot_map* sia_slot_map_create(const sia_slot_map_desc* desc);
+SIA_FUNC_DEF void* sia_slot_map_alloc(sia_slot_map* map, sia_handle* handle);
+SIA_FUNC_DEF void* sia_slot_map_get(sia_slot_map* map, sia_handle handle);
+SIA_FUNC_DEF sia_b32 sia_slot_map_free(sia_slot_map* map, sia_handle handle);
+SIA_FUNC_DEF sia_handle sia_slot_map_get_handle(sia_slot_map* map, sia_u32 item_index);
+
+#define SIA_SLOT_MAP_ALLOC_STRUCT(map, type, handle) (type*)sia_slot_map_alloc(map, handle)
+#define SIA_SLOT_MAP_GET_STRUCT(map, type, handle) (type*)sia_slot_map_get(map, handle)
+
+// Each power of 2 size range is split into 32 linear ranges.
+// Blocks below 256 bytes only use the second level, and blocks go up to 256 GiB
+#define _SIA_TLSF_SL_LOG2 5
+#define _SIA_TLSF_SL_COUNT (1 << _SIA_TLSF_SL_LOG2)
+#define _SIA_TLSF_FL_SHIFT (_SIA_TLSF_SL_LOG2 + 3)
+#define _SIA_TLSF_FL_MAX 38
+#define _SIA_TLSF_FL_COUNT (_SIA_TLSF_FL_MAX - _SIA_TLSF_FL_SHIFT + 1)
+
+// General purpose allocator with O(1) alloc and free
+typedef struct {
+    // Private arena that the memory comes from
+    si_arena* arena;
+    sia_u64 grow_size;
+
+    sia_u32 _fl_bitmap;
+    sia_u32 _sl_bitmaps[_SIA_TLSF_FL_COUNT];
+    struct _sia_tlsf_block* _free_lists[_SIA_TLSF_FL_COUNT][_SIA_TLSF_SL_COUNT];
+
+    // End of the last memory pushed, so that the next push can extend it
+    sia_u8* _region_end;
+} sia_tlsf;
+
+typedef struct {
+    // Used to create the private arena
+    sia_desc arena_desc;
+    // Memory to get from the arena up front
+    sia_u64 initial_size;
+    // Minimum amount of memory to get from the arena when there is no free block that fits.
+    // Defaults to the block size of the arena
+    sia_u64 grow_size;
+} sia_tlsf_desc;
+
+// TLSF functions
+SIA_FUNC_DEF sia_tlsf* sia_tlsf_create(const sia_tlsf_desc* desc);
+SIA_FUNC_DEF void sia_tlsf_destroy(sia_tlsf* tlsf);
+SIA_FUNC_DEF void* sia_tlsf_alloc(sia_tlsf* tlsf, sia_u64 size);
+SIA_FUNC_DEF void sia_tlsf_free(sia_tlsf* tlsf, void* ptr);
+SIA_FUNC_DEF sia_u64 sia_tlsf_get_size(void* ptr);
+
+// Single producer, single consumer byte ring
+// The ring memory is mapped twice back to back, so every push is contiguous.
+// Each side writes to its own cache lines
+typedef struct {
+    sia_u8* _data;
+    sia_u64 _size;
+    sia_u64 _map_size;
+    sia_u32 _align;
+    sia_i32 _memfd;
+    sia_error_callback* error_callback;
+    sia_u8 _pad0[24];
+
+    // Producer side
+    sia_u64 _write;
+    sia_u64 _tail_cache;
+    sia_error _last_error;
+    sia_u8 _pad1[48 - sizeof(sia_error)];
+
+    // Bytes published by the producer and consumed by the consumer, since the ring was created
+    sia_u64 _head;
+    sia_u8 _pad2[56];
+    sia_u64 _tail;
+    sia_u8 _pad3[56];
+
+    // Consumer side
+    sia_u64 _head_cache;
+} sia_ring;
+
+typedef struct {
+    // Rounded up to a power of 2 that is at least the page size
+    sia_u64 size;
+    // Defaults to 1, so that the consumer sees the pushes without padding
+    sia_u32 align;
+    sia_error_callback* error_callback;
+} sia_ring_desc;
+
+// Ring functions
+// Producer: sia_ring_push, sia_ring_publish
+// Consumer: sia_ring_peek, sia_ring_consume
+SIA_FUNC_DEF sia_ring* sia_ring_create(const sia_ring_desc* desc);
+SIA_FUNC_DEF void sia_ring_destroy(sia_ring* ring);
+SIA_FUNC_DEF sia_error sia_ring_get_error(sia_ring* ring);
+SIA_FUNC_DEF sia_u64 sia_ring_get_size(sia_ring* ring);
+SIA_FUNC_DEF void* sia_ring_push(sia_ring* ring, sia_u64 size);
+SIA_FUNC_DEF void sia_ring_publish(sia_ring* ring);
+SIA_FUNC_DEF void* sia_ring_peek(sia_ring* ring, sia_u64* size);
+SIA_FUNC_DEF void sia_ring_consume(sia_ring* ring, sia_u64 size);
+
+#ifndef SIA_FRAME_MAX_READERS
+#   define SIA_FRAME_MAX_READERS 8
+#endif
+#define SIA_FRAME_NO_READER UINT32_MAX
+
+typedef struct {
+    // Number of frames the reader released, or UINT64_MAX if the slot is free
+    sia_u64 released;
+    sia_u8 _pad[56];
+} _sia_frame_reader;
+
+// K arenas that one producer fills in turn, for any number of registered readers
+// A frame is reset only after every reader released it
+typedef struct {
+    _sia_frame_reader _readers[SIA_FRAME_MAX_READERS];
+
+    // Number of frames published since the ring was created
+    sia_u64 _published;
+    sia_u8 _pad[56];
+
+    si_arena* arena;
+    si_arena** _frames;
+    void** _data;
+    sia_u32 _num_frames;
+} sia_frame_ring;
+
+typedef struct {
+    // Holds the frame ring, like the arena of a pool
+    si_arena* arena;
+    // Defaults to 3
+    sia_u32 num_frames;
+    // Used to create every frame arena
+    sia_desc frame_desc;
+} sia_frame_ring_desc;
+
+// A published frame, as seen by one reader
+typedef struct {
+    sia_frame_ring* ring;
+    // NULL if there was no new frame
+    si_arena* arena;
+    void* data;
+    sia_u64 index;
+    sia_u32 _reader;
+} sia_frame;
+
+// Frame ring functions
+// Producer: sia_frame_begin, sia_frame_publish
+// Readers: sia_frame_acquire, sia_frame_release
+SIA_FUNC_DEF sia_frame_ring* sia_frame_ring_create(const sia_frame_ring_desc* desc);
+SIA_FUNC_DEF void sia_frame_ring_destroy(sia_frame_ring* ring);
+SIA_FUNC_DEF sia_u32 sia_frame_reader_register(sia_frame_ring* ring);
+SIA_FUNC_DEF void sia_frame_reader_unregister(sia_frame_ring* ring, sia_u32 reader);
+SIA_FUNC_DEF si_arena* sia_frame_begin(sia_frame_ring* ring);
+SIA_FUNC_DEF void sia_frame_publish(sia_frame_ring* ring, void* data);
+SIA_FUNC_DEF sia_frame sia_frame_acquire(sia_frame_ring* ring, sia_u32 reader);
+SIA_FUNC_DEF void sia_frame_release(sia_frame frame);
+
+#ifdef SIA_ENABLE_REGISTRY
+// Writes one JSON object per line for every live arena and pool to fd
+// Safe to call from a signal handler
+SIA_FUNC_DEF void sia_registry_dump(int fd);
+#endif
+
+// Operations in a trace, see the docs for the record fields that each one uses
+typedef enum {
+    SIA_TRACE_CREATE = 1,
+    SIA_TRACE_DESTROY,
+    SIA_TRACE_PUSH,
+    SIA_TRACE_POP,
+    SIA_TRACE_POP_TO,
+    SIA_TRACE_RESET,
+    SIA_TRACE_REALLOC,
+    SIA_TRACE_TEMP_BEGIN,
+    SIA_TRACE_TEMP_END,
+    SIA_TRACE_POOL_CREATE,
+    SIA_TRACE_POOL_DESTROY,
+    SIA_TRACE_POOL_GROW,
+    SIA_TRACE_POOL_ALLOC,
+    SIA_TRACE_POOL_FREE,
+    SIA_TRACE_POOL_ALLOC_N,
+    SIA_TRACE_POOL_FREE_N,
+    // One pointer of the SIA_TRACE_POOL_ALLOC_N or SIA_TRACE_POOL_FREE_N before it
+    SIA_TRACE_PTR
+} sia_trace_op;
+
+typedef struct {
+    sia_u32 op;
+    sia_u32 align;
+    // Address of the arena or pool
+    sia_u64 target;
+    sia_u64 size;
+    // Second size or count, e.g. the old size of a realloc
+    sia_u64 arg;
+    // Position of the arena after the operation
+    sia_u64 pos;
+    sia_u64 ptr;
+    sia_u64 result;
+} sia_trace_record;
+
+#define SIA_TRACE_MAGIC "SIATRACE"
+#define SIA_TRACE_VERSION 1
+
+// Start of a trace, followed by the records
+typedef struct {
+    char magic[8];
+    sia_u32 version;
+    sia_u32 record_size;
+} sia_trace_header;
+
+#ifdef SIA_ENABLE_TRACE
+// Writes every traced operation in the process to fd, until sia_trace_stop
+// Fails if a trace is already running
+SIA_FUNC_DEF sia_b32 sia_trace_start(int fd);
+SIA_FUNC_DEF void sia_trace_stop(void);
+#endif
+
+// One reservation that is split into aligned slots, one for each arena created with it.
+// Slots of destroyed arenas are reused with the start of their memory still committed
+typedef struct sia_space {
+    sia_u8* _slots;
+    sia_u64 _slot_size;
+    sia_u64 _warm_size;
+    sia_u64 _reserve_size;
+    sia_u32 _num_slots;
+    sia_b32 _noreserve;
+
+    // Top of the free slot stack plus 1 (0 when empty) in the low half,
+    // and a tag in the high half that changes on every update
+    sia_u64 _free_head;
+    // Slots past this one were never handed out
+    sia_u32 _next_slot;
+    sia_u32 _num_used;
+    // Per slot, the next free slot plus 1, and the bytes that are still committed
+    sia_u32* _free_next;
+    sia_u64* _slot_commit;
+
+    sia_error _last_error;
+    sia_error_callback* error_callback;
+} sia_space;
+
+typedef struct {
+    // Rounded down to a multiple of slot_size. Defaults to 1024 slots
+    sia_u64 size;
+    // Largest arena that fits in a slot, rounded up to a power of 2. Defaults to 64 MiB
+    sia_u64 slot_size;
+    // Committed bytes at the start of a slot that stay committed when its arena is destroyed.
+    // Defaults to 64 KiB
+    sia_u64 warm_size;
+    sia_error_callback* error_callback;
+    // SIA_FLAG_NORESERVE maps the whole space up front like a no reserve arena (Linux only).
+    // Falls back to reserving and committing when the mapping fails
+    sia_u32 flags;
+} sia_space_desc;
+
+// Address space functions
+// Every arena created with the space has to be destroyed before the space
+SIA_FUNC_DEF sia_space* sia_space_create(const sia_space_desc* desc);
+SIA_FUNC_DEF void sia_space_destroy(sia_space* space);
+SIA_FUNC_DEF sia_error sia_space_get_error(sia_space* space);
+SIA_FUNC_DEF sia_u64 sia_space_get_slot_size(sia_space* space);
+SIA_FUNC_DEF sia_u32 sia_space_get_capacity(sia_space* space);
+SIA_FUNC_DEF sia_u32 sia_space_get_used(sia_space* space);
+
+#ifndef SIA_GOVERNOR_MAX_TRIMS
+#   define SIA_GOVERNOR_MAX_TRIMS 16
+#endif
+
+// Called when the governed memory goes over the watermark.
+// arena is the arena whose commit crossed it, or NULL while an arena is created
+typedef void (sia_trim_callback)(si_arena* arena, sia_u64 used, void* user);
+
+typedef struct {
+    // Bytes that every governed arena together can commit, 0 for no limit
+    sia_u64 limit;
+    // Trim callbacks run when the governed arenas commit more than this, 0 disables them
+    sia_u64 watermark;
+} sia_governor_desc;
+
+// Global governor functions, for arenas created with SIA_FLAG_GOVERNED
+SIA_FUNC_DEF void sia_governor_set(const sia_governor_desc* desc);
+SIA_FUNC_DEF sia_u64 sia_governor_get_used(void);
+SIA_FUNC_DEF sia_b32 sia_governor_add_trim(sia_trim_callback* func, void* user);
+// Waits for running trim callbacks, so it must not be called from one
+SIA_FUNC_DEF void sia_governor_remove_trim(sia_trim_callback* func, void* user);
+
+#ifndef SIA_CACHE_MAX_PER_CLASS
+#   define SIA_CACHE_MAX_PER_CLASS 8
+#endif
+
+// Arena cache functions
+// While the cache is on, destroyed arenas keep their reservation and first block
+// for the next sia_create of the same size class. Only the low level backend caches arenas
+SIA_FUNC_DEF void sia_cache_set_limit(sia_u64 max_bytes);
+SIA_FUNC_DEF void sia_cache_trim(sia_u64 keep_bytes);
+SIA_FUNC_DEF sia_u64 sia_cache_get_retained(void);
+
+// Length and pointer to bytes that are not changed through the view, usually in an arena.
+// Views are not null terminated, except for the ones that a builder returns
+typedef struct {
+    sia_u64 len;
+    const char* data;
+} sia_str;
+
+#define SIA_STR(literal) ((sia_str){ sizeof(literal) - 1, (literal) })
+// For printf, e.g. printf("%.*s", SIA_STR_ARG(str))
+#define SIA_STR_ARG(str) (int)(str).len, (str).data
+#define SIA_STR_NPOS UINT64_MAX
+
+// Appends to one allocation at the end of the arena, which grows in place
+// as long as nothing else is pushed to the arena before sia_str_end
+typedef struct {
+    si_arena* arena;
+    char* data;
+    sia_u64 len;
+    sia_u64 cap;
+    // Set once an append fails, sia_str_end then returns an empty view
+    sia_b32 failed;
+} sia_str_builder;
+
+// String builder functions
+SIA_FUNC_DEF sia_str_builder sia_str_begin(si_arena* arena);
+SIA_FUNC_DEF sia_b32 sia_str_append(sia_str_builder* builder, sia_str str);
+SIA_FUNC_DEF sia_b32 sia_str_append_cstr(sia_str_builder* builder, const char* cstr);
+SIA_FUNC_DEF sia_b32 sia_str_append_char(sia_str_builder* builder, char c);
+SIA_FUNC_DEF sia_b32 sia_str_append_join(sia_str_builder* builder, const sia_str* parts, sia_u64 count, sia_str sep);
+SIA_FUNC_DEF sia_str sia_str_end(sia_str_builder* builder);
+
+// String functions
+// Only sia_str_copy, sia_str_join, and sia_str_fmt allocate, everything else returns views into str
+SIA_FUNC_DEF sia_str sia_str_from_cstr(const char* cstr);
+SIA_FUNC_DEF sia_str sia_str_copy(si_arena* arena, sia_str str);
+SIA_FUNC_DEF sia_str sia_str_join(si_arena* arena, const sia_str* parts, sia_u64 count, sia_str sep);
+SIA_FUNC_DEF sia_str sia_str_slice(sia_str str, sia_u64 start, sia_u64 end);
+SIA_FUNC_DEF sia_b32 sia_str_split(sia_str* rest, sia_str sep, sia_str* part);
+SIA_FUNC_DEF sia_u64 sia_str_find(sia_str str, sia_str needle);
+SIA_FUNC_DEF sia_b32 sia_str_eq(sia_str a, sia_str b);
+
+#ifndef SIA_NO_STDIO
+#include <stdarg.h>
+
+SIA_FUNC_DEF sia_b32 sia_str_appendf(sia_str_builder* builder, const char* fmt, ...);
+SIA_FUNC_DEF sia_b32 sia_str_appendfv(sia_str_builder* builder, const char* fmt, va_list args);
+SIA_FUNC_DEF sia_str sia_str_fmt(si_arena* arena, const char* fmt, ...);
+#endif
+
+// I/O
+// Reads straight into arena memory, instead of into a buffer that then gets copied.
+// Only Linux and macOS support these, elsewhere they fail with SIA_ERR_IO_FAILED
+typedef enum {
+    SIA_FILE_NONE = 0,
+    // Reads past the page cache (O_DIRECT, F_NOCACHE on macOS) into memory aligned to the block size of the file.
+    // Falls back to regular reads where the file system does not support it
+    SIA_FILE_DIRECT = 1 << 0
+} sia_file_flags;
+
+// Does one read of up to max bytes from fd, and gives the part that was not filled back to the arena.
+// Returns NULL with *size_out = 0 at the end of the file, and when a non-blocking fd has no data (errno is EAGAIN)
+SIA_FUNC_DEF void* sia_push_read(si_arena* arena, sia_i32 fd, sia_u64 max, sia_u64* size_out);
+// Reads the whole file, followed by a 0 that is not counted in *size_out
+SIA_FUNC_DEF void* sia_push_file(si_arena* arena, const char* path, sia_u32 flags, sia_u64* size_out);
+// Maps the whole file read only. It is unmapped when the arena pops to before the call
+SIA_FUNC_DEF const void* sia_map_file(si_arena* arena, const char* path, sia_u64* size_out);
+
 #ifdef __cplusplus
 }
 #endif
@@ -235,6 +946,13 @@ extern "C" {
 #    define SIA_PLATFORM_UNKNOWN
 #endif
 
+#ifdef SIA_ENABLE_TRACE
+// The traced functions at the end of the implementation are the only callers
+#   define _SIA_UNTRACED static
+#else
+#   define _SIA_UNTRACED
+#endif
+
 #if defined(SIA_MEM_RESERVE) && defined(SIA_MEM_COMMIT) && defined(SIA_MEM_DECOMMIT) && defined(SIA_MEM_RELEASE) && defined(SIA_MEM_PAGESIZE)
 #elif !defined(SIA_MEM_RESERVE) && !defined(SIA_MEM_COMMIT) && !defined(SIA_MEM_DECOMMIT) && !defined(SIA_MEM_RELEASE) && !defined(SIA_MEM_PAGESIZE)
 #else
@@ -247,6 +965,7 @@ extern "C" {
 #    define SIA_MEM_DECOMMIT _sia_mem_decommit
 #    define SIA_MEM_RELEASE _sia_mem_release
 #    define SIA_MEM_PAGESIZE _sia_mem_pagesize
+#    define _SIA_DEFAULT_MEM_FUNCS
 #endif
 
 // This is needed for the size and block_size calculations
@@ -271,11 +990,6 @@ extern "C" {
 #    endif
 #endif
 
-#ifndef SIA_MEMSET
-#   include <string.h>
-#   define SIA_MEMSET memset
-#endif
-
 #ifndef SIA_MEMCPY
 #   include <string.h>
 #   define SIA_MEMCPY memcpy
@@ -305,7 +1019,6 @@ extern "C" {
 #define SIA_MIN(a, b) ((a) < (b) ? (a) : (b))
 #define SIA_MAX(a, b) ((a) > (b) ? (a) : (b))
 
-#define SIA_ALIGN_UP_POW2(x, b) (((sia_u64)(x) + ((sia_u64)(b) - 1)) & (~((sia_u64)(b) - 1)))
 
 #ifdef SIA_PLATFORM_WIN32
 
@@ -339,6 +1052,45 @@ static sia_u32 _sia_mem_pagesize() {
     return (sia_u32)si.dwPageSize;
 }
 
+#define SIA_HAS_GUARD_PAGES
+
+// Maps size bytes of read/write memory followed by one inaccessible page
+static void* _sia_guard_map(sia_u64 size, sia_u32 page_size) {
+    void* out = VirtualAlloc(0, size + page_size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    DWORD old_protect = 0;
+    if (out != NULL && !VirtualProtect((sia_u8*)out + size, page_size, PAGE_NOACCESS, &old_protect)) {
+        VirtualFree(out, 0, MEM_RELEASE);
+        out = NULL;
+    }
+    return out;
+}
+static void _sia_guard_unmap(void* ptr, sia_u64 size) {
+    SIA_UNUSED(size);
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+
+#define SIA_HAS_LARGE_OBJECTS
+
+static void* _sia_large_map(sia_u64 size) {
+    return VirtualAlloc(0, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+static void _sia_large_unmap(void* ptr, sia_u64 size) {
+    SIA_UNUSED(size);
+    VirtualFree(ptr, 0, MEM_RELEASE);
+}
+// Windows can not move a mapping, so realloc falls back to copying
+static void* _sia_large_remap(void* ptr, sia_u64 old_size, sia_u64 new_size) {
+    SIA_UNUSED(ptr); SIA_UNUSED(old_size); SIA_UNUSED(new_size);
+    return NULL;
+}
+
+// Bytes of [ptr, ptr + size) that are in physical memory
+// Windows only reports this per page through QueryWorkingSetEx, so committed memory counts as resident
+static sia_u64 _sia_mem_resident(void* ptr, sia_u64 size) {
+    SIA_UNUSED(ptr);
+    return size;
+}
+
 #endif // SIA_PLATFORM_WIN32
 
 #if defined(SIA_PLATFORM_LINUX) || defined(SIA_PLATFORM_APPLE)
@@ -367,40 +1119,338 @@ static sia_u32 _sia_mem_pagesize() {
     return (sia_u32)sysconf(_SC_PAGESIZE);
 }
 
-#endif // SIA_PLATFORM_LINUX || SIA_PLATFORM_APPLE
+#if defined(SIA_PLATFORM_LINUX) && defined(_SIA_DEFAULT_MEM_FUNCS)
 
-#ifdef SIA_PLATFORM_UNKNOWN
+#include <sys/syscall.h>
+#include <fcntl.h>
 
-#ifndef SIA_FORCE_MALLOC
-static void* _sia_mem_reserve(sia_u64 size) { SIA_UNUSED(size); return NULL; }
-static void _sia_mem_commit(void* ptr, sia_u64 size) { SIA_UNUSED(ptr); SIA_UNUSED(size); }
-static void _sia_mem_decommit(void* ptr, sia_u64 size) { SIA_UNUSED(ptr); SIA_UNUSED(size); }
-static void _sia_mem_release(void* ptr, sia_u64 size) { SIA_UNUSED(ptr); SIA_UNUSED(size); }
-#endif
-static sia_u32 _sia_mem_pagesize(){ return 4096; }
+#define SIA_HAS_CHECKPOINTS
 
-#endif // SIA_PLATFORM_UNKNOWN
+// Same as _sia_mem_reserve, but backed by a memfd,
+// so the committed range can be remapped as a copy-on-write view
+static void* _sia_memfd_reserve(sia_u64 size, sia_i32* fd_out) {
+    int fd = (int)syscall(SYS_memfd_create, "si_arena", 1 /* MFD_CLOEXEC */);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return NULL;
+    }
 
-// https://graphics.stanford.edu/~seander/bithacks.html#RoundUpPowerOf2
-static sia_u32 _sia_round_pow2(sia_u32 v) {
-    v--;
-    v |= v >> 1;
-    v |= v >> 2;
-    v |= v >> 4;
-    v |= v >> 8;
-    v |= v >> 16;
-    v++;
-    
-    return v;
-}
+    void* out = mmap(NULL, size, PROT_NONE, MAP_SHARED, fd, (off_t)0);
+    if (out == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
 
+    *fd_out = fd;
+    return out;
+}
+// Pages of a memfd stay in the file after MADV_DONTNEED, so they have to be removed too.
+// MADV_REMOVE fails on copy-on-write ranges, where MADV_DONTNEED is enough
+static void _sia_memfd_decommit(void* ptr, sia_u64 size) {
+    madvise(ptr, size, MADV_REMOVE);
+    _sia_mem_decommit(ptr, size);
+}
+// Maps [offset, offset + size) of the memfd back over the same range of base,
+// either shared or as a private copy-on-write view
+static sia_b32 _sia_memfd_remap(void* base, sia_u64 offset, sia_u64 size, sia_i32 fd, sia_b32 copy_on_write, sia_b32 writable) {
+    if (size == 0) {
+        return SIA_TRUE;
+    }
 
-typedef struct {
-    sia_error_callback* error_callback;
-    sia_u64 max_size;
-    sia_u32 block_size;
-    sia_u32 align;
-} _sia_init_data;
+    int prot = writable ? PROT_READ | PROT_WRITE : PROT_NONE;
+    int flags = MAP_FIXED | (copy_on_write ? MAP_PRIVATE : MAP_SHARED);
+
+    return mmap((sia_u8*)base + offset, size, prot, flags, fd, (off_t)offset) != MAP_FAILED;
+}
+// Writes the pages of [base, base + size) that differ from the memfd back into it.
+// Pages that were never written to are still mapped from the file, and get skipped
+static sia_b32 _sia_memfd_write_back(void* base, sia_u64 size, sia_i32 fd, sia_u32 page_size) {
+    // Bit 63 is present, bit 62 is swapped, and bit 61 is file page.
+    // If pagemap is not available, every page gets written
+    int pagemap = open("/proc/self/pagemap", O_RDONLY | O_CLOEXEC);
+
+    sia_u64 entries[512];
+    sia_u64 num_pages = size / page_size;
+    sia_u64 first_page = (sia_u64)base / page_size;
+
+    for (sia_u64 i = 0; i < num_pages; i += 512) {
+        sia_u64 batch = SIA_MIN(num_pages - i, 512);
+        sia_b32 have_entries = pagemap >= 0 &&
+            pread(pagemap, entries, batch * 8, (off_t)((first_page + i) * 8)) == (ssize_t)(batch * 8);
+
+        for (sia_u64 j = 0; j < batch; j++) {
+            if (have_entries) {
+                sia_u64 entry = entries[j];
+                sia_b32 in_memory = ((entry >> 63) & 1) || ((entry >> 62) & 1);
+                if (!in_memory || ((entry >> 61) & 1)) {
+                    continue;
+                }
+            }
+
+            sia_u64 offset = (i + j) * page_size;
+            sia_u8* page = (sia_u8*)base + offset;
+#ifdef SIA_ASAN
+            // ASan checks the buffer passed to pwrite, and free arena memory is poisoned
+            ssize_t written = syscall(SYS_pwrite64, fd, page, (size_t)page_size, (off_t)offset);
+#else
+            ssize_t written = pwrite(fd, page, page_size, (off_t)offset);
+#endif
+            if (written != (ssize_t)page_size) {
+                if (pagemap >= 0) { close(pagemap); }
+                return SIA_FALSE;
+            }
+        }
+    }
+
+    if (pagemap >= 0) { close(pagemap); }
+    return SIA_TRUE;
+}
+
+#define SIA_HAS_NORESERVE
+
+// Pages are only backed by memory once they are touched, and do not count against the commit limit
+static void* _sia_noreserve_reserve(sia_u64 size) {
+    void* out = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, (off_t)0);
+    return out == MAP_FAILED ? NULL : out;
+}
+// Gives pages back without changing the mapping.
+// MADV_FREE lets the kernel take them lazily, and is not available before Linux 4.5
+static void _sia_noreserve_decommit(void* ptr, sia_u64 size) {
+#ifdef MADV_FREE
+    if (madvise(ptr, size, MADV_FREE) == 0) {
+        return;
+    }
+#endif
+    madvise(ptr, size, MADV_DONTNEED);
+}
+
+#endif // SIA_PLATFORM_LINUX && _SIA_DEFAULT_MEM_FUNCS
+
+#ifdef SIA_PLATFORM_LINUX
+
+#include <sys/syscall.h>
+
+#define SIA_HAS_RINGS
+
+// Maps header_size bytes of private memory, followed by
+// the same size bytes of a new memfd twice in a row.
+// Everything comes from one reservation, so the views are always adjacent
+static void* _sia_ring_map(sia_u64 header_size, sia_u64 size, sia_i32* fd_out) {
+    int fd = (int)syscall(SYS_memfd_create, "si_arena_ring", 1 /* MFD_CLOEXEC */);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (ftruncate(fd, (off_t)size) != 0) {
+        close(fd);
+        return NULL;
+    }
+
+    sia_u64 map_size = header_size + size * 2;
+    sia_u8* out = (sia_u8*)mmap(NULL, map_size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, (off_t)0);
+    if ((void*)out == MAP_FAILED) {
+        close(fd);
+        return NULL;
+    }
+
+    sia_u8* data = out + header_size;
+    if (mmap(out, header_size, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, (off_t)0) == MAP_FAILED ||
+        mmap(data, size, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd, (off_t)0) == MAP_FAILED ||
+        mmap(data + size, size, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_SHARED, fd, (off_t)0) == MAP_FAILED) {
+        munmap(out, map_size);
+        close(fd);
+        return NULL;
+    }
+
+    *fd_out = fd;
+    return out;
+}
+static void _sia_ring_unmap(void* ptr, sia_u64 map_size, sia_i32 fd) {
+    munmap(ptr, map_size);
+    close(fd);
+}
+
+#endif // SIA_PLATFORM_LINUX
+
+#define SIA_HAS_GUARD_PAGES
+
+// Maps size bytes of read/write memory followed by one inaccessible page
+static void* _sia_guard_map(sia_u64 size, sia_u32 page_size) {
+    void* out = mmap(NULL, size + page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, (off_t)0);
+    if (out == MAP_FAILED) {
+        return NULL;
+    }
+    if (mprotect((sia_u8*)out + size, page_size, PROT_NONE) != 0) {
+        munmap(out, size + page_size);
+        return NULL;
+    }
+    return out;
+}
+static void _sia_guard_unmap(void* ptr, sia_u64 size) {
+    munmap(ptr, size);
+}
+
+#define SIA_HAS_LARGE_OBJECTS
+
+static void* _sia_large_map(sia_u64 size) {
+    void* out = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, (off_t)0);
+    return out == MAP_FAILED ? NULL : out;
+}
+static void _sia_large_unmap(void* ptr, sia_u64 size) {
+    munmap(ptr, size);
+}
+// Moves the pages to a new size without copying them, or returns NULL if it can not
+static void* _sia_large_remap(void* ptr, sia_u64 old_size, sia_u64 new_size) {
+#ifdef SIA_PLATFORM_LINUX
+    // Through syscall, because mremap is only declared with _GNU_SOURCE
+    void* out = (void*)syscall(SYS_mremap, ptr, (size_t)old_size, (size_t)new_size, 1 /* MREMAP_MAYMOVE */);
+    return out == MAP_FAILED ? NULL : out;
+#else
+    SIA_UNUSED(ptr); SIA_UNUSED(old_size); SIA_UNUSED(new_size);
+    return NULL;
+#endif
+}
+
+// Bytes of [ptr, ptr + size) that are in physical memory
+static sia_u64 _sia_mem_resident(void* ptr, sia_u64 size) {
+    sia_u32 page_size = _sia_mem_pagesize();
+    sia_u64 start = SIA_ALIGN_DOWN_POW2(ptr, page_size);
+    sia_u64 end = SIA_ALIGN_UP_POW2((sia_u64)ptr + size, page_size);
+
+#ifdef SIA_PLATFORM_APPLE
+    char vec[1024];
+#else
+    unsigned char vec[1024];
+#endif
+
+    sia_u64 out = 0;
+    for (sia_u64 chunk = start; chunk < end; chunk += sizeof(vec) * (sia_u64)page_size) {
+        sia_u64 chunk_size = SIA_MIN(end - chunk, sizeof(vec) * (sia_u64)page_size);
+        if (mincore((void*)chunk, chunk_size, vec) != 0) {
+            continue;
+        }
+
+        for (sia_u64 i = 0; i < chunk_size / page_size; i++) {
+            out += (vec[i] & 1) ? page_size : 0;
+        }
+    }
+
+    return out;
+}
+
+#define SIA_HAS_FILE_IO
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+
+// glibc only defines O_DIRECT with _GNU_SOURCE
+#if defined(O_DIRECT)
+#   define _SIA_O_DIRECT O_DIRECT
+#elif defined(__O_DIRECT)
+#   define _SIA_O_DIRECT __O_DIRECT
+#endif
+
+// Opens path for reading, past the page cache if direct is set and the file system allows it
+static int _sia_file_open(const char* path, sia_b32 direct) {
+    int fd = -1;
+#ifdef _SIA_O_DIRECT
+    if (direct) {
+        fd = open(path, O_RDONLY | O_CLOEXEC | _SIA_O_DIRECT);
+    }
+#endif
+    if (fd < 0) {
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+    }
+#ifdef F_NOCACHE
+    if (fd >= 0 && direct) {
+        fcntl(fd, F_NOCACHE, 1);
+    }
+#endif
+    return fd;
+}
+// Reads until size bytes are in or the file ends, and returns SIA_FALSE on an error
+static sia_b32 _sia_file_read(int fd, void* ptr, sia_u64 size, sia_u64* read_out) {
+    sia_u64 total = 0;
+    *read_out = 0;
+    while (total < size) {
+        // Linux never reads more than 2GiB at a time anyway
+        sia_u64 chunk = SIA_MIN(size - total, SIA_GiB(1));
+        ssize_t got = read(fd, (sia_u8*)ptr + total, (size_t)chunk);
+#ifdef _SIA_O_DIRECT
+        if (got < 0 && errno == EINVAL && (fcntl(fd, F_GETFL) & _SIA_O_DIRECT)) {
+            // The file system took O_DIRECT on open but not on read, or the tail is not aligned
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~_SIA_O_DIRECT);
+            continue;
+        }
+#endif
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got < 0) {
+            return SIA_FALSE;
+        }
+        if (got == 0) {
+            break;
+        }
+        total += (sia_u64)got;
+        *read_out = total;
+    }
+    return SIA_TRUE;
+}
+static void* _sia_file_map(int fd, sia_u64 size) {
+    void* out = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, (off_t)0);
+    return out == MAP_FAILED ? NULL : out;
+}
+static void _sia_file_unmap(void* ptr, sia_u64 size) {
+    munmap(ptr, size);
+}
+
+#endif // SIA_PLATFORM_LINUX || SIA_PLATFORM_APPLE
+
+#ifdef SIA_PLATFORM_UNKNOWN
+
+#ifndef SIA_FORCE_MALLOC
+static void* _sia_mem_reserve(sia_u64 size) { SIA_UNUSED(size); return NULL; }
+static void _sia_mem_commit(void* ptr, sia_u64 size) { SIA_UNUSED(ptr); SIA_UNUSED(size); }
+static void _sia_mem_decommit(void* ptr, sia_u64 size) { SIA_UNUSED(ptr); SIA_UNUSED(size); }
+static void _sia_mem_release(void* ptr, sia_u64 size) { SIA_UNUSED(ptr); SIA_UNUSED(size); }
+#endif
+static sia_u32 _sia_mem_pagesize(){ return 4096; }
+static sia_u64 _sia_mem_resident(void* ptr, sia_u64 size) { SIA_UNUSED(ptr); return size; }
+
+#endif // SIA_PLATFORM_UNKNOWN
+
+// https://graphics.stanford.edu/~seander/bithacks.html#RoundUpPowerOf2
+static sia_u32 _sia_round_pow2(sia_u32 v) {
+    v--;
+    v |= v >> 1;
+    v |= v >> 2;
+    v |= v >> 4;
+    v |= v >> 8;
+    v |= v >> 16;
+    v++;
+    
+    return v;
+}
+
+
+typedef struct {
+    sia_error_callback* error_callback;
+    sia_u64 max_size;
+    sia_u32 block_size;
+    sia_u32 min_block_size;
+    sia_u32 max_block_size;
+    sia_u32 align;
+    sia_u32 guard_sample_rate;
+    sia_u32 flags;
+    const char* name;
+    sia_u64 large_threshold;
+    sia_space* space;
+    sia_budget_callback* budget_callback;
+} _sia_init_data;
 
 
 static void _sia_empty_error_callback(sia_error error) {
@@ -423,13 +1473,38 @@ static _sia_init_data _sia_init_common(const sia_desc* desc) {
     sia_u32 page_size = SIA_MEM_PAGESIZE();
     
     out.max_size = SIA_ALIGN_UP_POW2(desc->desired_max_size, page_size);
+    // Arenas in an address space default to the whole slot
+    if (desc->space != NULL && desc->desired_max_size == 0) {
+        out.max_size = desc->space->_slot_size;
+    }
     sia_u32 desired_block_size = desc->desired_block_size == 0 ? 
         SIA_ALIGN_UP_POW2(out.max_size / 8, page_size) : desc->desired_block_size;
     desired_block_size = SIA_ALIGN_UP_POW2(desired_block_size, page_size);
     
     out.block_size = _sia_round_pow2(desired_block_size);
+    out.min_block_size = out.block_size;
+    out.max_block_size = out.block_size;
+
+    if (desc->flags & SIA_FLAG_ADAPTIVE) {
+        // By default, the step never goes above the block size the arena would have without the flag
+        sia_u32 min_block_size = desc->min_block_size == 0 ?
+            SIA_MIN(SIA_KiB(64), out.block_size) : desc->min_block_size;
+        sia_u32 max_block_size = desc->max_block_size == 0 ? out.block_size : desc->max_block_size;
+
+        out.min_block_size = _sia_round_pow2(SIA_ALIGN_UP_POW2(min_block_size, page_size));
+        out.max_block_size = _sia_round_pow2(SIA_ALIGN_UP_POW2(max_block_size, page_size));
+        out.max_block_size = SIA_MAX(out.min_block_size, out.max_block_size);
+        out.block_size = out.min_block_size;
+    }
     
     out.align = desc->align == 0 ? (sizeof(void*)) : desc->align;
+
+    out.guard_sample_rate = desc->guard_sample_rate;
+    out.flags = desc->flags;
+    out.name = desc->name;
+    out.large_threshold = desc->large_threshold == 0 ? UINT64_MAX : desc->large_threshold;
+    out.space = desc->space;
+    out.budget_callback = desc->budget_callback;
     
     return out;
 }
@@ -441,192 +1516,616 @@ static SIA_THREAD_VAR sia_error_callback* _sia_global_error_callback = NULL;
 // it has to be above the implementations that reference it
 static SIA_THREAD_VAR sia_error last_error;
 
-#ifdef SIA_FORCE_MALLOC
+static void _sia_guard_init(si_arena* arena, sia_u32 sample_rate);
+static void _sia_tags_init(si_arena* arena, sia_budget_callback* callback);
+static void _sia_release_tags(si_arena* arena, sia_u64 pos);
+static void _sia_release_mappings(si_arena* arena, sia_u64 pos);
+static void _sia_run_cleanups(si_arena* arena, sia_u64 pos);
+static sia_u64 _sia_release_floor(si_arena* arena);
+
+// Set on arenas created with sia_create_from_buffer
+// Every backend function hands these arenas to the _sia_buffer functions
+#define _SIA_FLAG_BUFFER (1u << 31)
+
+static void _sia_buffer_destroy(si_arena* arena);
+static void _sia_buffer_update_fast(si_arena* arena);
+static void* _sia_buffer_push(si_arena* arena, sia_u64 size, sia_u32 align);
+static sia_b32 _sia_buffer_grow_last(si_arena* arena, sia_u64 size);
+static void _sia_buffer_pop(si_arena* arena, sia_u64 size);
+
+// Each backend implements these two for the inline fast paths
+// _sia_sync brings the backend up to date with pushes and pops done on the fast path
+// _sia_update_fast recomputes the fast path state after the backend changes
+static void _sia_sync(si_arena* arena);
+static void _sia_update_fast(si_arena* arena);
+
+// Atomics used by everything that can be touched from more than one thread
+// All of these are sequentially consistent, except for SIA_ATOMIC_LOAD_RELAXED_U64
+#if defined(_MSC_VER) && !defined(__clang__)
+#   include <intrin.h>
+#   define SIA_ATOMIC_LOAD_U32(p) ((sia_u32)_InterlockedOr((volatile long*)(p), 0))
+#   define SIA_ATOMIC_ADD_U32(p, v) ((sia_u32)_InterlockedExchangeAdd((volatile long*)(p), (long)(v)))
+#   define SIA_ATOMIC_SUB_U32(p, v) ((sia_u32)_InterlockedExchangeAdd((volatile long*)(p), -(long)(v)))
+#   define SIA_ATOMIC_STORE_U32(p, v) ((void)_InterlockedExchange((volatile long*)(p), (long)(v)))
+#   define SIA_ATOMIC_LOAD_U64(p) ((sia_u64)_InterlockedOr64((volatile long long*)(p), 0))
+#   define SIA_ATOMIC_LOAD_RELAXED_U64(p) (*(volatile sia_u64*)(p))
+#   define SIA_ATOMIC_STORE_U64(p, v) ((void)_InterlockedExchange64((volatile long long*)(p), (long long)(v)))
+#   define SIA_ATOMIC_ADD_U64(p, v) ((sia_u64)_InterlockedExchangeAdd64((volatile long long*)(p), (long long)(v)))
+#   define SIA_ATOMIC_SUB_U64(p, v) ((sia_u64)_InterlockedExchangeAdd64((volatile long long*)(p), -(long long)(v)))
+#   define SIA_ATOMIC_CAS_U32(p, expected, desired) \
+        ((sia_u32)_InterlockedCompareExchange((volatile long*)(p), (long)(desired), (long)(expected)) == (sia_u32)(expected))
+#   define SIA_ATOMIC_CAS_U64(p, expected, desired) \
+        ((sia_u64)_InterlockedCompareExchange64((volatile long long*)(p), (long long)(desired), (long long)(expected)) == (sia_u64)(expected))
+#else
+#   define SIA_ATOMIC_LOAD_U32(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#   define SIA_ATOMIC_ADD_U32(p, v) __atomic_fetch_add((p), (v), __ATOMIC_SEQ_CST)
+#   define SIA_ATOMIC_SUB_U32(p, v) __atomic_fetch_sub((p), (v), __ATOMIC_SEQ_CST)
+#   define SIA_ATOMIC_STORE_U32(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#   define SIA_ATOMIC_LOAD_U64(p) __atomic_load_n((p), __ATOMIC_SEQ_CST)
+#   define SIA_ATOMIC_LOAD_RELAXED_U64(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#   define SIA_ATOMIC_STORE_U64(p, v) __atomic_store_n((p), (v), __ATOMIC_SEQ_CST)
+#   define SIA_ATOMIC_ADD_U64(p, v) __atomic_fetch_add((p), (v), __ATOMIC_SEQ_CST)
+#   define SIA_ATOMIC_SUB_U64(p, v) __atomic_fetch_sub((p), (v), __ATOMIC_SEQ_CST)
+#   define SIA_ATOMIC_CAS_U32(p, expected, desired) _sia_atomic_cas_u32((p), (expected), (desired))
+#   define SIA_ATOMIC_CAS_U64(p, expected, desired) _sia_atomic_cas_u64((p), (expected), (desired))
+
+SIA_INLINE sia_b32 _sia_atomic_cas_u32(sia_u32* ptr, sia_u32 expected, sia_u32 desired) {
+    return __atomic_compare_exchange_n(ptr, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+SIA_INLINE sia_b32 _sia_atomic_cas_u64(sia_u64* ptr, sia_u64 expected, sia_u64 desired) {
+    return __atomic_compare_exchange_n(ptr, &expected, desired, 0, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+#endif
 
-/*
-Malloc Backend
-======================================================================
-  __  __   _   _    _    ___   ___   ___   _   ___ _  _____ _  _ ___  
- |  \/  | /_\ | |  | |  / _ \ / __| | _ ) /_\ / __| |/ / __| \| |   \
- | |\/| |/ _ \| |__| |_| (_) | (__  | _ \/ _ \ (__| ' <| _|| .` | |) |
- |_|  |_/_/ \_\____|____\___/ \___| |___/_/ \_\___|_|\_\___|_|\_|___/ 
+// Index of the lowest and highest set bit, x must not be 0
+#if defined(_MSC_VER) && !defined(__clang__)
+SIA_INLINE sia_u32 _sia_ctz64(sia_u64 x) {
+    unsigned long out;
+    _BitScanForward64(&out, x);
+    return (sia_u32)out;
+}
+SIA_INLINE sia_u32 _sia_fls64(sia_u64 x) {
+    unsigned long out;
+    _BitScanReverse64(&out, x);
+    return (sia_u32)out;
+}
+#else
+SIA_INLINE sia_u32 _sia_ctz64(sia_u64 x) {
+    return (sia_u32)__builtin_ctzll(x);
+}
+SIA_INLINE sia_u32 _sia_fls64(sia_u64 x) {
+    return 63 - (sia_u32)__builtin_clzll(x);
+}
+#endif
 
-======================================================================
-*/
-                                                                      
-si_arena* sia_create(const sia_desc* desc) {
-    _sia_init_data init_data = _sia_init_common(desc);
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#   include <emmintrin.h>
+#   define SIA_SSE2
+#endif
 
-    si_arena* out = (si_arena*)malloc(sizeof(si_arena));
+#if defined(SIA_PLATFORM_LINUX) || defined(SIA_PLATFORM_APPLE)
+#   include <sched.h>
+#endif
 
-    if (out == NULL) {
-        last_error.code = SIA_ERR_INIT_FAILED;
-        last_error.msg = "Failed to malloc initial memory for arena";
-        init_data.error_callback(last_error);
-        return NULL;
+// Waits a little longer every call, for the few places that wait on another thread.
+// Pauses the cpu at first, then gives the rest of the time slice away
+SIA_INLINE void _sia_backoff(sia_u32* spins) {
+    if (*spins < 64) {
+        (*spins)++;
+#if defined(SIA_SSE2)
+        _mm_pause();
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+        __asm__ __volatile__("yield");
+#endif
+        return;
     }
-    
-    out->_pos = 0;
-    out->_size = init_data.max_size;
-    out->_block_size = init_data.block_size;
-    out->_align = init_data.align;
-    out->_last_error = (sia_error){ .code=SIA_ERR_NONE, .msg="" };
-    out->error_callback = init_data.error_callback;
-
-    out->_malloc_backend.cur_node = (_sia_malloc_node*)malloc(sizeof(_sia_malloc_node));
-    *out->_malloc_backend.cur_node = (_sia_malloc_node){
-        .prev = NULL,
-        .size = out->_block_size,
-        .pos = 0,
-        .data = (sia_u8*)malloc(out->_block_size)
-    };
 
-    return out;
+#if defined(SIA_PLATFORM_WIN32)
+    SwitchToThread();
+#elif defined(SIA_PLATFORM_LINUX) || defined(SIA_PLATFORM_APPLE)
+    sched_yield();
+#endif
 }
-void sia_destroy(si_arena* arena) {
-    _sia_malloc_node* node = arena->_malloc_backend.cur_node;
-    while (node != NULL) {
-        free(node->data);
 
-        _sia_malloc_node* temp = node;
-        node = node->prev;
-        free(temp);
-    }
-    
-    free(arena);
-}
+#ifdef SIA_ENABLE_REGISTRY
 
-void* sia_push(si_arena* arena, sia_u64 size) {
-    if (arena->_pos + size > arena->_size) {
-        last_error.code = SIA_ERR_OUT_OF_MEMORY;
-        last_error.msg = "Arena ran out of memory";
-        arena->_last_error = last_error;
-        arena->error_callback(last_error);
-        return NULL;
-    }
+/*
+Registry
+=====================================
+  ___ ___ ___ ___ ___ _____ _____   __
+ | _ \ __/ __|_ _/ __|_   _| _ \ \ / /
+ |   / _| (_ || |\__ \ | | |   /\ V / 
+ |_|_\___\___|___|___/ |_| |_|_\ |_|  
+
+=====================================
+*/
 
-    _sia_malloc_node* node = arena->_malloc_backend.cur_node;
+#ifndef SIA_REGISTRY_SIZE
+#   define SIA_REGISTRY_SIZE 1024
+#endif
 
-    sia_u64 pos_aligned = SIA_ALIGN_UP_POW2(node->pos, arena->_align);
-    sia_u32 diff = pos_aligned - node->pos;
-    arena->_pos += diff + size;
+#ifdef SIA_PLATFORM_WIN32
+#   include <io.h>
+#endif
 
-    if (arena->_pos >= node->size) {
-        
-        sia_u64 unclamped_node_size = SIA_ALIGN_UP_POW2(size, arena->_block_size);
-        sia_u64 max_node_size = arena->_size - arena->_pos;
-        sia_u64 node_size = SIA_MIN(unclamped_node_size, max_node_size);
-        
-        _sia_malloc_node* new_node = (_sia_malloc_node*)malloc(sizeof(_sia_malloc_node));
-        sia_u8* data = (sia_u8*)malloc(node_size);
-
-        if (new_node == NULL || data == NULL) {
-            if (new_node != NULL) { free(new_node); }
-            if (data != NULL) { free(data); }
-            
-            last_error.code = SIA_ERR_MALLOC_FAILED;
-            last_error.msg = "Failed to malloc new node";
-            arena->_last_error = last_error;
-            arena->error_callback(last_error);
-            return NULL;
-        }
+// Each slot holds the address of an arena, or of a pool with the lowest bit set.
+// Both are aligned to at least 8 bytes, so the low bits are free
+#define _SIA_REGISTRY_POOL_BIT 1
+#define _SIA_REGISTRY_NO_SLOT UINT32_MAX
 
-        new_node->pos = size;
-        new_node->size = node_size;
-        new_node->data = data;
-        
-        new_node->prev = node;
-        arena->_malloc_backend.cur_node = new_node;
+// The two bits above it count the dumps that read the entry. Removing the entry waits for the count
+// to reach 0, so that dumps never read an arena or pool that was freed. A dump only pins one entry
+// while it formats its line, never across a write, so the wait is short. Dumps never wait themselves,
+// so one from a signal handler can read the entry that the dump it interrupted has pinned
+#define _SIA_REGISTRY_READ_ONE 2
+#define _SIA_REGISTRY_READ_MASK 6
+
+static sia_u64 _sia_registry_slots[SIA_REGISTRY_SIZE];
+// One past the highest slot that was ever used, so dumps do not scan the whole array
+static sia_u32 _sia_registry_end = 0;
+
+static sia_u32 _sia_registry_add(void* ptr, sia_b32 is_pool) {
+    sia_u64 entry = (sia_u64)ptr | (is_pool ? _SIA_REGISTRY_POOL_BIT : 0);
+
+    for (sia_u32 i = 0; i < SIA_REGISTRY_SIZE; i++) {
+        if (SIA_ATOMIC_LOAD_U64(&_sia_registry_slots[i]) == 0 &&
+            SIA_ATOMIC_CAS_U64(&_sia_registry_slots[i], 0, entry)) {
+
+            sia_u32 end = SIA_ATOMIC_LOAD_U32(&_sia_registry_end);
+            while (end < i + 1 && !SIA_ATOMIC_CAS_U32(&_sia_registry_end, end, i + 1)) {
+                end = SIA_ATOMIC_LOAD_U32(&_sia_registry_end);
+            }
 
-        return (void*)(new_node->data);
+            return i;
+        }
     }
-    
-    void* out = (void*)((sia_u8*)node->data + pos_aligned);
-    node->pos = pos_aligned + size;
 
-    return out;
+    // The registry is full, so this one does not show up in dumps
+    return _SIA_REGISTRY_NO_SLOT;
 }
 
-void sia_pop(si_arena* arena, sia_u64 size) {
-    if (size > arena->_pos) {
-        last_error.code = SIA_ERR_CANNOT_POP_MORE;
-        last_error.msg = "Attempted to pop too much memory";
-        arena->_last_error = last_error;
-        arena->error_callback(last_error);
+static void _sia_registry_remove(sia_u32 slot) {
+    if (slot == _SIA_REGISTRY_NO_SLOT) {
+        return;
     }
-    
-    sia_u64 size_left = size;
-    _sia_malloc_node* node = arena->_malloc_backend.cur_node;
 
-    while (size_left > node->pos) {
-        size_left -= node->pos;
-        
-        _sia_malloc_node* temp = node;
-        node = node->prev;
+    // Only waits for a dump that is reading this entry right now
+    sia_u32 spins = 0;
+    sia_u64 entry = SIA_ATOMIC_LOAD_U64(&_sia_registry_slots[slot]);
+    while ((entry & _SIA_REGISTRY_READ_MASK) || !SIA_ATOMIC_CAS_U64(&_sia_registry_slots[slot], entry, 0)) {
+        _sia_backoff(&spins);
+        entry = SIA_ATOMIC_LOAD_U64(&_sia_registry_slots[slot]);
+    }
+}
 
-        free(temp->data);
-        free(temp);
+static void _sia_registry_pool_cleanup(void* ptr) {
+    sia_pool* pool = (sia_pool*)ptr;
+    _sia_registry_remove(pool->_registry_slot);
+    pool->_registry_slot = _SIA_REGISTRY_NO_SLOT;
+}
+
+// Fixed size line buffer, because the dump cannot call malloc or printf
+typedef struct {
+    char data[512];
+    sia_u32 len;
+} _sia_registry_line;
+
+static void _sia_line_str(_sia_registry_line* line, const char* str) {
+    while (*str != '\0' && line->len < sizeof(line->data)) {
+        line->data[line->len++] = *str++;
     }
+}
 
-    arena->_malloc_backend.cur_node = node;
+static void _sia_line_u64(_sia_registry_line* line, sia_u64 value) {
+    char digits[20];
+    sia_u32 num_digits = 0;
+    do {
+        digits[num_digits++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
 
-    node->pos -= size_left;
-    arena->_pos -= size;
+    while (num_digits > 0 && line->len < sizeof(line->data)) {
+        line->data[line->len++] = digits[--num_digits];
+    }
 }
 
-void sia_reset(si_arena* arena) {
-    sia_pop_to(arena, 0);
+static void _sia_line_hex(_sia_registry_line* line, sia_u64 value) {
+    _sia_line_str(line, "\"0x");
+    for (sia_i32 shift = 60; shift >= 0; shift -= 4) {
+        if (line->len < sizeof(line->data)) {
+            line->data[line->len++] = "0123456789abcdef"[(value >> shift) & 0xf];
+        }
+    }
+    _sia_line_str(line, "\"");
 }
 
-#else // SIA_FORCE_MALLOC
+static void _sia_line_json_str(_sia_registry_line* line, const char* str) {
+    if (str == NULL) {
+        _sia_line_str(line, "null");
+        return;
+    }
 
-/*
-Low Level Backend
-================================================================================
-  _    _____      __  _    _____   _____ _      ___   _   ___ _  _____ _  _ ___  
- | |  / _ \ \    / / | |  | __\ \ / / __| |    | _ ) /_\ / __| |/ / __| \| |   \
- | |_| (_) \ \/\/ /  | |__| _| \ V /| _|| |__  | _ \/ _ \ (__| ' <| _|| .` | |) |
- |____\___/ \_/\_/   |____|___| \_/ |___|____| |___/_/ \_\___|_|\_\___|_|\_|___/ 
+    _sia_line_str(line, "\"");
+    // Long names are cut off, to leave room for the rest of the line
+    for (; *str != '\0' && line->len < 256; str++) {
+        unsigned char c = (unsigned char)*str;
+        if (c == '"' || c == '\\') {
+            line->data[line->len++] = '\\';
+            line->data[line->len++] = (char)c;
+        } else if (c < 0x20) {
+            _sia_line_str(line, "\\u00");
+            line->data[line->len++] = "0123456789abcdef"[c >> 4];
+            line->data[line->len++] = "0123456789abcdef"[c & 0xf];
+        } else {
+            line->data[line->len++] = (char)c;
+        }
+    }
+    _sia_line_str(line, "\"");
+}
 
-================================================================================
+static void _sia_line_field(_sia_registry_line* line, const char* key, sia_u64 value) {
+    _sia_line_str(line, ",\"");
+    _sia_line_str(line, key);
+    _sia_line_str(line, "\":");
+    _sia_line_u64(line, value);
+}
+
+static void _sia_registry_write(int fd, _sia_registry_line* line) {
+    const char* data = line->data;
+    sia_u32 left = line->len;
+
+    while (left > 0) {
+#ifdef SIA_PLATFORM_WIN32
+        int written = _write(fd, data, left);
+#else
+        ssize_t written = write(fd, data, left);
+#endif
+        if (written <= 0) {
+            return;
+        }
+        data += written;
+        left -= (sia_u32)written;
+    }
+}
+
+void sia_registry_dump(int fd) {
+    sia_u32 end = SIA_ATOMIC_LOAD_U32(&_sia_registry_end);
+    for (sia_u32 i = 0; i < end; i++) {
+        // Pins the entry, or skips it if the count is full. Never waits for another dump
+        sia_u64 entry = SIA_ATOMIC_LOAD_U64(&_sia_registry_slots[i]);
+        while (entry != 0 && (entry & _SIA_REGISTRY_READ_MASK) != _SIA_REGISTRY_READ_MASK &&
+            !SIA_ATOMIC_CAS_U64(&_sia_registry_slots[i], entry, entry + _SIA_REGISTRY_READ_ONE)) {
+            entry = SIA_ATOMIC_LOAD_U64(&_sia_registry_slots[i]);
+        }
+        if (entry == 0 || (entry & _SIA_REGISTRY_READ_MASK) == _SIA_REGISTRY_READ_MASK) {
+            continue;
+        }
+        entry &= ~(sia_u64)_SIA_REGISTRY_READ_MASK;
+
+        // Fields are read while their owners may be using them, so every number is a snapshot
+        _sia_registry_line line = { .len = 0 };
+
+        if (entry & _SIA_REGISTRY_POOL_BIT) {
+            sia_pool* pool = (sia_pool*)(uintptr_t)(entry & ~(sia_u64)_SIA_REGISTRY_POOL_BIT);
+            sia_u64 total = SIA_ATOMIC_LOAD_RELAXED_U64(&pool->total_blocks);
+            sia_u64 free_blocks = SIA_ATOMIC_LOAD_RELAXED_U64(&pool->free_blocks);
+
+            _sia_line_str(&line, "{\"type\":\"pool\",\"id\":");
+            _sia_line_hex(&line, (sia_u64)pool);
+            _sia_line_str(&line, ",\"arena\":");
+            _sia_line_hex(&line, (sia_u64)pool->arena);
+            _sia_line_str(&line, ",\"name\":");
+            _sia_line_json_str(&line, pool->name);
+            _sia_line_field(&line, "block_size", pool->block_size);
+            _sia_line_field(&line, "capacity", total);
+            _sia_line_field(&line, "used", total - SIA_MIN(free_blocks, total));
+        } else {
+            si_arena* arena = (si_arena*)(uintptr_t)entry;
+            sia_u64 pos = SIA_ATOMIC_LOAD_RELAXED_U64(&arena->_pos);
+            sia_u64 peak_pos = SIA_ATOMIC_LOAD_RELAXED_U64(&arena->_peak_pos);
+
+            sia_u64 committed = 0;
+            if (arena->_flags & _SIA_FLAG_BUFFER) {
+                committed = arena->_size;
+            } else {
+#ifdef SIA_FORCE_MALLOC
+                committed = SIA_ATOMIC_LOAD_RELAXED_U64(&arena->_malloc_backend.node_total);
+#else
+                committed = SIA_ATOMIC_LOAD_RELAXED_U64(&arena->_reserve_backend.commit_pos);
+#endif
+            }
+
+            _sia_line_str(&line, "{\"type\":\"arena\",\"id\":");
+            _sia_line_hex(&line, (sia_u64)arena);
+            _sia_line_str(&line, ",\"name\":");
+            _sia_line_json_str(&line, arena->_name);
+            _sia_line_field(&line, "pos", pos);
+            _sia_line_field(&line, "peak_pos", SIA_MAX(pos, peak_pos));
+            _sia_line_field(&line, "size", arena->_size);
+            _sia_line_field(&line, "committed", committed);
+        }
+
+        _sia_line_str(&line, "}\n");
+        SIA_ATOMIC_SUB_U64(&_sia_registry_slots[i], _SIA_REGISTRY_READ_ONE);
+
+        _sia_registry_write(fd, &line);
+    }
+}
+
+#else // SIA_ENABLE_REGISTRY
+
+#define _SIA_REGISTRY_NO_SLOT UINT32_MAX
+
+static sia_u32 _sia_registry_add(void* ptr, sia_b32 is_pool) {
+    SIA_UNUSED(ptr);
+    SIA_UNUSED(is_pool);
+    return _SIA_REGISTRY_NO_SLOT;
+}
+static void _sia_registry_remove(sia_u32 slot) { SIA_UNUSED(slot); }
+
+#endif // SIA_ENABLE_REGISTRY
+
+/*
+Governor
+=================================================
+   ___  _____   _____ ___ _  _  ___  ___ 
+  / __|/ _ \ \ / / __| _ \ \| |/ _ \| _ \
+ | (_ | (_) \ V /| _||   / .` | (_) |   /
+  \___|\___/ \_/ |___|_|_\_|\_|\___/|_|_\
+
+=================================================
 */
 
-#define SIA_MIN_POS SIA_ALIGN_UP_POW2(sizeof(si_arena), 64) 
+// State of a trim slot. func and user are only written while the slot is claimed
+#define _SIA_TRIM_FREE 0
+#define _SIA_TRIM_CLAIMED 1
+#define _SIA_TRIM_READY 2
 
-si_arena* sia_create(const sia_desc* desc) {
+typedef struct {
+    sia_u64 state;
+    sia_trim_callback* func;
+    void* user;
+} _sia_governor_trim;
+
+static sia_u64 _sia_governor_used = 0;
+static sia_u64 _sia_governor_limit = 0;
+static sia_u64 _sia_governor_watermark = 0;
+// Only one thread runs the trim callbacks at a time
+static sia_u32 _sia_governor_trimming = 0;
+static _sia_governor_trim _sia_governor_trims[SIA_GOVERNOR_MAX_TRIMS];
+
+void sia_governor_set(const sia_governor_desc* desc) {
+    SIA_ATOMIC_STORE_U64(&_sia_governor_limit, desc == NULL ? 0 : desc->limit);
+    SIA_ATOMIC_STORE_U64(&_sia_governor_watermark, desc == NULL ? 0 : desc->watermark);
+}
+sia_u64 sia_governor_get_used(void) {
+    return SIA_ATOMIC_LOAD_U64(&_sia_governor_used);
+}
+
+sia_b32 sia_governor_add_trim(sia_trim_callback* func, void* user) {
+    for (sia_u32 i = 0; i < SIA_GOVERNOR_MAX_TRIMS; i++) {
+        _sia_governor_trim* trim = &_sia_governor_trims[i];
+        if (SIA_ATOMIC_LOAD_U64(&trim->state) == _SIA_TRIM_FREE &&
+            SIA_ATOMIC_CAS_U64(&trim->state, _SIA_TRIM_FREE, _SIA_TRIM_CLAIMED)) {
+            trim->func = func;
+            trim->user = user;
+            SIA_ATOMIC_STORE_U64(&trim->state, _SIA_TRIM_READY);
+            return SIA_TRUE;
+        }
+    }
+    return SIA_FALSE;
+}
+void sia_governor_remove_trim(sia_trim_callback* func, void* user) {
+    for (sia_u32 i = 0; i < SIA_GOVERNOR_MAX_TRIMS; i++) {
+        _sia_governor_trim* trim = &_sia_governor_trims[i];
+        if (SIA_ATOMIC_LOAD_U64(&trim->state) == _SIA_TRIM_READY && trim->func == func && trim->user == user &&
+            SIA_ATOMIC_CAS_U64(&trim->state, _SIA_TRIM_READY, _SIA_TRIM_CLAIMED)) {
+            // Waits for a run that may still call it, so user can be freed once this returns
+            sia_u32 spins = 0;
+            while (SIA_ATOMIC_LOAD_U32(&_sia_governor_trimming) != 0) {
+                _sia_backoff(&spins);
+            }
+            SIA_ATOMIC_STORE_U64(&trim->state, _SIA_TRIM_FREE);
+            return;
+        }
+    }
+}
+
+static void _sia_governor_run_trims(si_arena* arena) {
+    if (!SIA_ATOMIC_CAS_U32(&_sia_governor_trimming, 0, 1)) {
+        return;
+    }
+
+    for (sia_u32 i = 0; i < SIA_GOVERNOR_MAX_TRIMS; i++) {
+        _sia_governor_trim* trim = &_sia_governor_trims[i];
+        if (SIA_ATOMIC_LOAD_U64(&trim->state) == _SIA_TRIM_READY) {
+            trim->func(arena, SIA_ATOMIC_LOAD_U64(&_sia_governor_used), trim->user);
+        }
+    }
+
+    SIA_ATOMIC_STORE_U32(&_sia_governor_trimming, 0);
+}
+
+// Takes size bytes from the governor, or returns false if that would go over the limit.
+// Trims run when the watermark is crossed, and once more before a push fails
+static sia_b32 _sia_governor_charge(si_arena* arena, sia_u64 size) {
+    sia_u64 limit = SIA_ATOMIC_LOAD_U64(&_sia_governor_limit);
+    sia_u64 watermark = SIA_ATOMIC_LOAD_U64(&_sia_governor_watermark);
+
+    for (sia_u32 attempt = 0; attempt < 2; attempt++) {
+        sia_u64 used = SIA_ATOMIC_ADD_U64(&_sia_governor_used, size) + size;
+
+        if (limit != 0 && used > limit) {
+            SIA_ATOMIC_SUB_U64(&_sia_governor_used, size);
+            if (attempt == 0 && watermark != 0) {
+                _sia_governor_run_trims(arena);
+                continue;
+            }
+            return SIA_FALSE;
+        }
+
+        // The retry does not trim again, the trims just ran
+        if (attempt == 0 && watermark != 0 && used > watermark && used - size <= watermark) {
+            _sia_governor_run_trims(arena);
+        }
+        return SIA_TRUE;
+    }
+
+    return SIA_FALSE;
+}
+static void _sia_governor_refund(sia_u64 size) {
+    SIA_ATOMIC_SUB_U64(&_sia_governor_used, size);
+}
+
+// Out-of-line mappings of governed arenas count like commits
+static sia_b32 _sia_governor_charge_mapping(si_arena* arena, sia_u64 size) {
+    if (!(arena->_flags & SIA_FLAG_GOVERNED) || _sia_governor_charge(arena, size)) {
+        return SIA_TRUE;
+    }
+
+    last_error.code = SIA_ERR_GOVERNOR_LIMIT;
+    last_error.msg = "Governor limit reached";
+    arena->_last_error = last_error;
+    arena->error_callback(last_error);
+    return SIA_FALSE;
+}
+static void _sia_governor_refund_mapping(si_arena* arena, sia_u64 size) {
+    if (arena->_flags & SIA_FLAG_GOVERNED) {
+        _sia_governor_refund(size);
+    }
+}
+
+#ifdef SIA_FORCE_MALLOC
+
+/*
+Malloc Backend
+======================================================================
+  __  __   _   _    _    ___   ___   ___   _   ___ _  _____ _  _ ___  
+ |  \/  | /_\ | |  | |  / _ \ / __| | _ ) /_\ / __| |/ / __| \| |   \
+ | |\/| |/ _ \| |__| |_| (_) | (__  | _ \/ _ \ (__| ' <| _|| .` | |) |
+ |_|  |_/_/ \_\____|____\___/ \___| |___/_/ \_\___|_|\_\___|_|\_|___/ 
+
+======================================================================
+*/
+                                                                      
+_SIA_UNTRACED si_arena* _SIA_TRACED(sia_create)(const sia_desc* desc) {
     _sia_init_data init_data = _sia_init_common(desc);
-    
-    si_arena* out = SIA_MEM_RESERVE(init_data.max_size);
+
+    si_arena* out = (si_arena*)malloc(sizeof(si_arena));
 
     if (out == NULL) {
         last_error.code = SIA_ERR_INIT_FAILED;
-        last_error.msg = "Failed to reserve initial memory for arena";
+        last_error.msg = "Failed to malloc initial memory for arena";
         init_data.error_callback(last_error);
         return NULL;
     }
 
-    if (!SIA_MEM_COMMIT(out, init_data.block_size)) {
-        last_error.code = SIA_ERR_INIT_FAILED;
-        last_error.msg = "Failed to commit initial memory for arena";
+    if ((init_data.flags & SIA_FLAG_GOVERNED) && !_sia_governor_charge(NULL, init_data.block_size)) {
+        last_error.code = SIA_ERR_GOVERNOR_LIMIT;
+        last_error.msg = "Governor limit reached";
         init_data.error_callback(last_error);
+        free(out);
         return NULL;
     }
-
-    out->_pos = SIA_MIN_POS;
+    
+    out->_pos = 0;
     out->_size = init_data.max_size;
     out->_block_size = init_data.block_size;
+    out->_min_block_size = init_data.min_block_size;
+    out->_max_block_size = init_data.max_block_size;
     out->_align = init_data.align;
-    out->_reserve_backend.commit_pos = init_data.block_size;
+    // Nodes come from malloc, so there is nothing to map without reserving
+    out->_flags = init_data.flags & ~(sia_u32)SIA_FLAG_NORESERVE;
     out->_last_error = (sia_error){ .code=SIA_ERR_NONE, .msg="" };
     out->error_callback = init_data.error_callback;
+    out->_cleanups = NULL;
+    out->_peak_pos = out->_pos;
+    out->_num_commits = 1;
+    out->_num_decommits = 0;
+    out->_faulted_pages = 0;
+    out->_name = init_data.name;
+    _sia_guard_init(out, init_data.guard_sample_rate);
+    _sia_tags_init(out, init_data.budget_callback);
+    out->_large_threshold = init_data.large_threshold;
+
+    out->_malloc_backend.cur_node = (_sia_malloc_node*)malloc(sizeof(_sia_malloc_node));
+    *out->_malloc_backend.cur_node = (_sia_malloc_node){
+        .prev = NULL,
+        .size = out->_block_size,
+        .pos = 0,
+        .data = (sia_u8*)malloc(out->_block_size)
+    };
+    out->_malloc_backend.node_total = out->_block_size;
+    SIA_ASAN_POISON(out->_malloc_backend.cur_node->data, out->_block_size);
+    _sia_update_fast(out);
+
+    out->_registry_slot = _sia_registry_add(out, SIA_FALSE);
 
     return out;
 }
-void sia_destroy(si_arena* arena) {
-    SIA_MEM_RELEASE(arena, arena->_size);
+_SIA_UNTRACED void _SIA_TRACED(sia_destroy)(si_arena* arena) {
+    _sia_registry_remove(arena->_registry_slot);
+
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        _sia_buffer_destroy(arena);
+        return;
+    }
+
+    _sia_sync(arena);
+    _sia_run_cleanups(arena, 0);
+    _sia_release_mappings(arena, 0);
+
+    if (arena->_flags & SIA_FLAG_GOVERNED) {
+        _sia_governor_refund(arena->_malloc_backend.node_total);
+    }
+
+    _sia_malloc_node* node = arena->_malloc_backend.cur_node;
+    while (node != NULL) {
+        SIA_ASAN_UNPOISON(node->data, node->size);
+        free(node->data);
+
+        _sia_malloc_node* temp = node;
+        node = node->prev;
+        free(temp);
+    }
+    
+    free(arena);
 }
 
-void* sia_push(si_arena* arena, sia_u64 size) {
+static void _sia_sync(si_arena* arena) {
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        return;
+    }
+
+    _sia_malloc_node* node = arena->_malloc_backend.cur_node;
+    node->pos = arena->_fast_base + arena->_pos - (sia_u64)node->data;
+}
+
+static void _sia_update_fast(si_arena* arena) {
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        _sia_buffer_update_fast(arena);
+        return;
+    }
+
+    _sia_malloc_node* node = arena->_malloc_backend.cur_node;
+    sia_u64 node_start = arena->_pos - node->pos;
+
+    // Positions in the current node map to node->data + (pos - node_start)
+    arena->_fast_base = (sia_u64)node->data - node_start;
+    arena->_fast_limit = SIA_MIN(node_start + node->size, arena->_size);
+    arena->_fast_floor = SIA_MAX(node_start, _sia_release_floor(arena));
+
+    // Pops back to the start take the slow path, which shrinks an adaptive step
+    if (arena->_min_block_size != arena->_max_block_size) {
+        arena->_fast_floor = SIA_MAX(arena->_fast_floor, 1);
+    }
+}
+
+static void* _sia_push_impl(si_arena* arena, sia_u64 size, sia_u32 align) {
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        return _sia_buffer_push(arena, size, align);
+    }
+
     if (arena->_pos + size > arena->_size) {
         last_error.code = SIA_ERR_OUT_OF_MEMORY;
         last_error.msg = "Arena ran out of memory";
@@ -635,601 +2134,4148 @@ void* sia_push(si_arena* arena, sia_u64 size) {
         return NULL;
     }
 
-    sia_u64 pos_aligned = SIA_ALIGN_UP_POW2(arena->_pos, arena->_align);
-    void* out = (void*)((sia_u8*)arena + pos_aligned);
-    arena->_pos = pos_aligned + size;
+    _sia_malloc_node* node = arena->_malloc_backend.cur_node;
 
-    sia_u64 commit_pos = arena->_reserve_backend.commit_pos;
-    if (arena->_pos > commit_pos) {
-        sia_u64 commit_unclamped = SIA_ALIGN_UP_POW2(arena->_pos, arena->_block_size);
-        sia_u64 new_commit_pos = SIA_MIN(commit_unclamped, arena->_size);
-        sia_u64 commit_size = new_commit_pos - commit_pos;
-        
-        if (!SIA_MEM_COMMIT((void*)((sia_u8*)arena + commit_pos), commit_size)) {
-            last_error.code = SIA_ERR_COMMIT_FAILED;
-            last_error.msg = "Failed to commit memory";
+    // Alignment is applied to the address, because malloc only guarantees
+    // alignment up to max_align_t for the node data
+    sia_u64 node_addr = (sia_u64)node->data;
+    sia_u64 pos_aligned = SIA_ALIGN_UP_POW2(node_addr + node->pos, align) - node_addr;
+
+    if (pos_aligned + size <= node->size) {
+        if (arena->_pos + (pos_aligned - node->pos) + size > arena->_size) {
+            last_error.code = SIA_ERR_OUT_OF_MEMORY;
+            last_error.msg = "Arena ran out of memory";
             arena->_last_error = last_error;
             arena->error_callback(last_error);
             return NULL;
         }
 
-        arena->_reserve_backend.commit_pos = new_commit_pos;
+        arena->_pos += (pos_aligned - node->pos) + size;
+        node->pos = pos_aligned + size;
+
+        return (void*)(node->data + pos_aligned);
     }
 
-    return out;
-}
+    // Worst case padding, since the alignment of the new node data is unknown
+    sia_u64 needed_size = size + align - 1;
+    sia_u64 unclamped_node_size = SIA_ALIGN_UP_POW2(needed_size, arena->_block_size);
+    sia_u64 max_node_size = arena->_size - arena->_pos;
+    sia_u64 node_size = SIA_MAX(needed_size, SIA_MIN(unclamped_node_size, max_node_size));
 
-void sia_pop(si_arena* arena, sia_u64 size) {
-    if (size > arena->_pos - SIA_MIN_POS) {
-        last_error.code = SIA_ERR_CANNOT_POP_MORE;
-        last_error.msg = "Attempted to pop too much memory";
+    sia_b32 governed = (arena->_flags & SIA_FLAG_GOVERNED) != 0;
+    if (governed && !_sia_governor_charge(arena, node_size)) {
+        last_error.code = SIA_ERR_GOVERNOR_LIMIT;
+        last_error.msg = "Governor limit reached";
         arena->_last_error = last_error;
         arena->error_callback(last_error);
-
-        return;
+        return NULL;
     }
+    
+    _sia_malloc_node* new_node = (_sia_malloc_node*)malloc(sizeof(_sia_malloc_node));
+    sia_u8* data = (sia_u8*)malloc(node_size);
 
-    arena->_pos = SIA_MAX(SIA_MIN_POS, arena->_pos - size);
+    if (new_node == NULL || data == NULL) {
+        if (new_node != NULL) { free(new_node); }
+        if (data != NULL) { free(data); }
+        if (governed) { _sia_governor_refund(node_size); }
+        
+        last_error.code = SIA_ERR_MALLOC_FAILED;
+        last_error.msg = "Failed to malloc new node";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return NULL;
+    }
 
-    sia_u64 new_commit = SIA_MIN(arena->_size, SIA_ALIGN_UP_POW2(arena->_pos, arena->_block_size));
-    sia_u64 commit_pos = arena->_reserve_backend.commit_pos;
+    sia_u64 data_offset = SIA_ALIGN_UP_POW2(data, align) - (sia_u64)data;
+    if (arena->_pos + data_offset + size > arena->_size) {
+        free(new_node);
+        free(data);
+        if (governed) { _sia_governor_refund(node_size); }
 
-    if (new_commit < commit_pos) {
-        sia_u64 decommit_size = commit_pos - new_commit;
-        SIA_MEM_DECOMMIT((void*)((sia_u8*)arena + new_commit), decommit_size);
-        arena->_reserve_backend.commit_pos = new_commit;
+        last_error.code = SIA_ERR_OUT_OF_MEMORY;
+        last_error.msg = "Arena ran out of memory";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return NULL;
     }
-}
 
-void sia_reset(si_arena* arena) {
-    sia_pop_to(arena, SIA_MIN_POS);
+    new_node->pos = data_offset + size;
+    new_node->size = node_size;
+    new_node->data = data;
+    SIA_ASAN_POISON(data, node_size);
+    
+    new_node->prev = node;
+    arena->_malloc_backend.cur_node = new_node;
+    arena->_pos += new_node->pos;
+    arena->_malloc_backend.node_total += node_size;
+    arena->_num_commits++;
+    arena->_block_size = SIA_MIN(arena->_block_size * 2, arena->_max_block_size);
+
+    return (void*)(new_node->data + data_offset);
 }
 
-#endif // NOT SIA_FORCE_MALLOC
+// Grows the last allocation by size bytes, if it fits in the current node
+static sia_b32 _sia_grow_last(si_arena* arena, sia_u64 size) {
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        return _sia_buffer_grow_last(arena, size);
+    }
 
-/*
-All Backends
-=========================================================
-    _   _    _      ___   _   ___ _  _____ _  _ ___  ___ 
-   /_\ | |  | |    | _ ) /_\ / __| |/ / __| \| |   \/ __|
-  / _ \| |__| |__  | _ \/ _ \ (__| ' <| _|| .` | |) \__ \
- /_/ \_\____|____| |___/_/ \_\___|_|\_\___|_|\_|___/|___/
+    _sia_malloc_node* node = arena->_malloc_backend.cur_node;
+    if (size > node->size - node->pos || arena->_pos + size > arena->_size) {
+        return SIA_FALSE;
+    }
 
-=========================================================
-*/
+    node->pos += size;
+    arena->_pos += size;
 
+    return SIA_TRUE;
+}
 
-sia_error sia_get_error(si_arena* arena) {
-    sia_error* err = arena == NULL ? &last_error : &arena->_last_error;
-    sia_error temp = *err;
+void _sia_pop_slow(si_arena* arena, sia_u64 size) {
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        _sia_buffer_pop(arena, size);
+        return;
+    }
 
-    *err = (sia_error){ SIA_ERR_NONE, "" };
+    if (size > arena->_pos) {
+        last_error.code = SIA_ERR_CANNOT_POP_MORE;
+        last_error.msg = "Attempted to pop too much memory";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+
+        return;
+    }
+
+    _sia_sync(arena);
+
+    _sia_run_cleanups(arena, arena->_pos - size);
+    _sia_release_mappings(arena, arena->_pos - size);
+    _sia_release_tags(arena, arena->_pos - size);
     
-    return temp;
-}
+    sia_u64 size_left = size;
+    _sia_malloc_node* node = arena->_malloc_backend.cur_node;
 
-sia_u64 sia_get_pos(si_arena* arena) { return arena->_pos; }
-sia_u64 sia_get_size(si_arena* arena) { return arena->_size; }
-sia_u32 sia_get_block_size(si_arena* arena) { return arena->_block_size; }
-sia_u32 sia_get_align(si_arena* arena) { return arena->_align; }
+    while (size_left > node->pos) {
+        size_left -= node->pos;
+        
+        _sia_malloc_node* temp = node;
+        node = node->prev;
 
+        arena->_faulted_pages += _sia_mem_resident(temp->data, temp->size) / SIA_MEM_PAGESIZE();
+        arena->_num_decommits++;
+        arena->_malloc_backend.node_total -= temp->size;
+        if (arena->_flags & SIA_FLAG_GOVERNED) {
+            _sia_governor_refund(temp->size);
+        }
 
-void sia_set_global_error_callback(sia_error_callback* callback) {
-    _sia_global_error_callback = callback;
-}
+        SIA_ASAN_UNPOISON(temp->data, temp->size);
+        free(temp->data);
+        free(temp);
+    }
 
-sia_error_callback* sia_get_global_error_callback(void) {
-    return _sia_global_error_callback;
+    arena->_malloc_backend.cur_node = node;
+
+    node->pos -= size_left;
+    SIA_ASAN_POISON(node->data + node->pos, size_left);
+    arena->_pos -= size;
+
+    if (arena->_pos == 0) {
+        arena->_block_size = arena->_min_block_size;
+    }
+
+    _sia_update_fast(arena);
 }
 
-void* sia_push_zero(si_arena* arena, sia_u64 size) {
-    sia_u8* out = sia_push(arena, size);
-    SIA_MEMSET(out, 0, size);
-    
-    return (void*)out;
+// Arenas ignore sia_desc.space with this backend
+sia_space* sia_space_create(const sia_space_desc* desc) {
+    SIA_UNUSED(desc);
+    last_error.code = SIA_ERR_INIT_FAILED;
+    last_error.msg = "Address spaces need the low level backend";
+    if (_sia_global_error_callback != NULL) {
+        _sia_global_error_callback(last_error);
+    }
+#ifndef SIA_NO_STDIO
+    else {
+        _sia_stderr_error_callback(last_error);
+    }
+#endif
+    return NULL;
 }
+void sia_space_destroy(sia_space* space) { SIA_UNUSED(space); }
 
-static sia_b32 _sia_is_valid_ptr(si_arena* arena, void* ptr, sia_u64 size) {
-    if (ptr == NULL) return SIA_FALSE;
-    
-#ifdef SIA_FORCE_MALLOC
-    _sia_malloc_node* node = arena->_malloc_backend.cur_node;
-    while (node != NULL) {
-        sia_u8* node_start = node->data;
-        sia_u8* node_end = node_start + node->size;
-        sia_u8* ptr_u8 = (sia_u8*)ptr;
-        if (ptr_u8 >= node_start && ptr_u8 + size <= node_end) {
-            return SIA_TRUE;
+// Freed nodes go back to malloc, which has its own caches
+void sia_cache_set_limit(sia_u64 max_bytes) { SIA_UNUSED(max_bytes); }
+void sia_cache_trim(sia_u64 keep_bytes) { SIA_UNUSED(keep_bytes); }
+sia_u64 sia_cache_get_retained(void) { return 0; }
+
+#else // SIA_FORCE_MALLOC
+
+/*
+Low Level Backend
+================================================================================
+  _    _____      __  _    _____   _____ _      ___   _   ___ _  _____ _  _ ___  
+ | |  / _ \ \    / / | |  | __\ \ / / __| |    | _ ) /_\ / __| |/ / __| \| |   \
+ | |_| (_) \ \/\/ /  | |__| _| \ V /| _|| |__  | _ \/ _ \ (__| ' <| _|| .` | |) |
+ |____\___/ \_/\_/   |____|___| \_/ |___|____| |___/_/ \_\___|_|\_\___|_|\_|___/ 
+
+================================================================================
+*/
+
+#define SIA_MIN_POS SIA_ALIGN_UP_POW2(sizeof(si_arena), 64) 
+
+// Reports errors of the address space functions, which have no arena yet
+static void _sia_space_error(sia_space* space, sia_error_code code, char* msg) {
+    last_error.code = code;
+    last_error.msg = msg;
+    if (space != NULL) {
+        space->_last_error = last_error;
+        space->error_callback(last_error);
+    } else if (_sia_global_error_callback != NULL) {
+        _sia_global_error_callback(last_error);
+    }
+#ifndef SIA_NO_STDIO
+    else {
+        _sia_stderr_error_callback(last_error);
+    }
+#endif
+}
+
+sia_space* sia_space_create(const sia_space_desc* desc) {
+    if (desc == NULL) {
+        _sia_space_error(NULL, SIA_ERR_INVALID_PTR, "Address space description is NULL");
+        return NULL;
+    }
+
+    sia_u32 page_size = SIA_MEM_PAGESIZE();
+
+    // Slots are aligned to their size, so the slot of an address is a shift away
+    sia_u64 slot_size = page_size;
+    while (slot_size < (desc->slot_size == 0 ? SIA_MiB(64) : desc->slot_size)) {
+        slot_size <<= 1;
+    }
+    sia_u64 num_slots = desc->size == 0 ? 1024 : desc->size / slot_size;
+    sia_u64 warm_size = SIA_ALIGN_UP_POW2(desc->warm_size == 0 ? SIA_KiB(64) : desc->warm_size, page_size);
+
+    if (num_slots == 0 || num_slots > UINT32_MAX - 1) {
+        _sia_space_error(NULL, SIA_ERR_INIT_FAILED, "Address space must have between 1 and 2^32 - 2 slots");
+        return NULL;
+    }
+
+    // The header and the per slot arrays go in front of the first slot
+    sia_u64 meta_size = SIA_ALIGN_UP_POW2(sizeof(sia_space) + num_slots * (sizeof(sia_u32) + sizeof(sia_u64)) + sizeof(sia_u64), page_size);
+    sia_u64 reserve_size = meta_size + slot_size + num_slots * slot_size;
+
+    sia_b32 noreserve = SIA_FALSE;
+    sia_u8* base = NULL;
+#ifdef SIA_HAS_NORESERVE
+    // One readable and writable mapping never gets split, no matter how many arenas commit in it.
+    // Strict overcommit can refuse a mapping that large, so it falls back to the regular path
+    if (desc->flags & SIA_FLAG_NORESERVE) {
+        base = (sia_u8*)_sia_noreserve_reserve(reserve_size);
+        noreserve = base != NULL;
+    }
+#endif
+    if (base == NULL) {
+        base = (sia_u8*)SIA_MEM_RESERVE(reserve_size);
+        if (base != NULL && !SIA_MEM_COMMIT(base, meta_size)) {
+            SIA_MEM_RELEASE(base, reserve_size);
+            base = NULL;
         }
-        node = node->prev;
     }
+
+    if (base == NULL) {
+        _sia_space_error(NULL, SIA_ERR_INIT_FAILED, "Failed to reserve address space");
+        return NULL;
+    }
+
+    // Fresh memory is zero, so every slot starts out never used with nothing committed
+    sia_space* space = (sia_space*)base;
+    space->_free_next = (sia_u32*)(base + sizeof(sia_space));
+    space->_slot_commit = (sia_u64*)SIA_ALIGN_UP_POW2((sia_u64)(space->_free_next + num_slots), sizeof(sia_u64));
+    space->_slots = (sia_u8*)SIA_ALIGN_UP_POW2((sia_u64)base + meta_size, slot_size);
+    space->_slot_size = slot_size;
+    space->_warm_size = SIA_MIN(warm_size, slot_size);
+    space->_reserve_size = reserve_size;
+    space->_num_slots = (sia_u32)num_slots;
+    space->_noreserve = noreserve;
+    space->_last_error = (sia_error){ .code=SIA_ERR_NONE, .msg="" };
+    space->error_callback = desc->error_callback == NULL ?
+        _sia_empty_error_callback : desc->error_callback;
+
+    return space;
+}
+
+void sia_space_destroy(sia_space* space) {
+    if (space == NULL) {
+        return;
+    }
+
+    SIA_MEM_RELEASE(space, space->_reserve_size);
+}
+
+// Returns the start of a free slot and how much of it is committed, or NULL if every slot is in use
+static si_arena* _sia_space_take(sia_space* space, sia_u64* committed) {
+    sia_u32 slot = UINT32_MAX;
+
+    // Slots that were used before are still warm, so they go first
+    sia_u64 head = SIA_ATOMIC_LOAD_U64(&space->_free_head);
+    while ((sia_u32)head != 0) {
+        sia_u32 top = (sia_u32)head - 1;
+        sia_u64 next = SIA_ATOMIC_LOAD_U32(&space->_free_next[top]);
+        if (SIA_ATOMIC_CAS_U64(&space->_free_head, head, (((head >> 32) + 1) << 32) | next)) {
+            slot = top;
+            break;
+        }
+        head = SIA_ATOMIC_LOAD_U64(&space->_free_head);
+    }
+
+    if (slot == UINT32_MAX) {
+        sia_u32 next_slot = SIA_ATOMIC_LOAD_U32(&space->_next_slot);
+        while (next_slot < space->_num_slots && !SIA_ATOMIC_CAS_U32(&space->_next_slot, next_slot, next_slot + 1)) {
+            next_slot = SIA_ATOMIC_LOAD_U32(&space->_next_slot);
+        }
+        if (next_slot >= space->_num_slots) {
+            return NULL;
+        }
+        slot = next_slot;
+    }
+
+    SIA_ATOMIC_ADD_U32(&space->_num_used, 1);
+    *committed = space->_slot_commit[slot];
+
+    return (si_arena*)(space->_slots + (sia_u64)slot * space->_slot_size);
+}
+
+// Decommits everything past the warm size, and puts the slot on the free stack
+static void _sia_space_give(sia_space* space, si_arena* arena, sia_u64 commit_pos) {
+    sia_u64 warm = SIA_MIN(commit_pos, space->_warm_size);
+    if (commit_pos > warm) {
+#ifdef SIA_HAS_NORESERVE
+        if (space->_noreserve) {
+            _sia_noreserve_decommit((sia_u8*)arena + warm, commit_pos - warm);
+        } else
+#endif
+        {
+            SIA_MEM_DECOMMIT((sia_u8*)arena + warm, commit_pos - warm);
+        }
+    }
+
+    sia_u32 slot = (sia_u32)(((sia_u8*)arena - space->_slots) / space->_slot_size);
+    space->_slot_commit[slot] = warm;
+
+    sia_u64 head;
+    do {
+        head = SIA_ATOMIC_LOAD_U64(&space->_free_head);
+        SIA_ATOMIC_STORE_U32(&space->_free_next[slot], (sia_u32)head);
+    } while (!SIA_ATOMIC_CAS_U64(&space->_free_head, head, (((head >> 32) + 1) << 32) | (slot + 1)));
+
+    SIA_ATOMIC_SUB_U32(&space->_num_used, 1);
+}
+
+// Destroyed arenas wait in the cache by the log2 of their reservation.
+// A slot holds an arena, 0 when empty, or 1 while an arena is put in it.
+// Taking and giving are one CAS on a slot, so a stale read can only ever see another cached arena
+#define _SIA_CACHE_CLASSES 64
+#define _SIA_CACHE_CLAIMED 1
+
+static sia_u64 _sia_cache_limit = 0;
+static sia_u64 _sia_cache_retained = 0;
+static sia_u64 _sia_cache_slots[_SIA_CACHE_CLASSES][SIA_CACHE_MAX_PER_CLASS];
+
+static sia_u32 _sia_cache_class(sia_u64 reserve_size) {
+    sia_u32 out = 0;
+    while (((sia_u64)1 << out) < reserve_size) {
+        out++;
+    }
+    return out;
+}
+
+// Only a power of 2 reservation fits every arena of its class
+static sia_u64 _sia_cache_reserve_size(sia_u64 max_size) {
+    if (SIA_ATOMIC_LOAD_U64(&_sia_cache_limit) == 0) {
+        return max_size;
+    }
+    return (sia_u64)1 << _sia_cache_class(max_size);
+}
+
+// Returns a cached arena and the bytes it still has committed, or NULL if the class is empty
+static si_arena* _sia_cache_take(sia_u64 reserve_size, sia_u64* committed) {
+    if ((reserve_size & (reserve_size - 1)) != 0) {
+        return NULL;
+    }
+
+    sia_u64* slots = _sia_cache_slots[_sia_cache_class(reserve_size)];
+    for (sia_u32 i = 0; i < SIA_CACHE_MAX_PER_CLASS; i++) {
+        sia_u64 entry = SIA_ATOMIC_LOAD_U64(&slots[i]);
+        if (entry > _SIA_CACHE_CLAIMED && SIA_ATOMIC_CAS_U64(&slots[i], entry, 0)) {
+            si_arena* out = (si_arena*)(uintptr_t)entry;
+            *committed = out->_reserve_backend.commit_pos;
+            SIA_ATOMIC_SUB_U64(&_sia_cache_retained, *committed);
+            return out;
+        }
+    }
+    return NULL;
+}
+
+// Keeps the first block of a destroyed arena committed and puts it in the cache,
+// or returns SIA_FALSE if the arena has to be released
+static sia_b32 _sia_cache_give(si_arena* arena) {
+    sia_u64 reserve_size = arena->_reserve_backend.reserve_size;
+    if ((reserve_size & (reserve_size - 1)) != 0 || arena->_reserve_backend.memfd >= 0 ||
+        (arena->_flags & SIA_FLAG_NORESERVE)) {
+        return SIA_FALSE;
+    }
+
+    // The retained bytes are added first, so the limit holds while many threads destroy at once
+    sia_u64 commit_pos = arena->_reserve_backend.commit_pos;
+    sia_u64 keep = SIA_MIN(commit_pos, (sia_u64)arena->_min_block_size);
+    while (SIA_TRUE) {
+        sia_u64 retained = SIA_ATOMIC_LOAD_U64(&_sia_cache_retained);
+        if (retained + keep > SIA_ATOMIC_LOAD_U64(&_sia_cache_limit)) {
+            return SIA_FALSE;
+        }
+        if (SIA_ATOMIC_CAS_U64(&_sia_cache_retained, retained, retained + keep)) {
+            break;
+        }
+    }
+
+    sia_u64* slots = _sia_cache_slots[_sia_cache_class(reserve_size)];
+    for (sia_u32 i = 0; i < SIA_CACHE_MAX_PER_CLASS; i++) {
+        if (SIA_ATOMIC_LOAD_U64(&slots[i]) != 0 || !SIA_ATOMIC_CAS_U64(&slots[i], 0, _SIA_CACHE_CLAIMED)) {
+            continue;
+        }
+
+        if (commit_pos > keep) {
+            SIA_MEM_DECOMMIT((sia_u8*)arena + keep, commit_pos - keep);
+        }
+        arena->_reserve_backend.commit_pos = keep;
+        SIA_ATOMIC_STORE_U64(&slots[i], (sia_u64)arena);
+        return SIA_TRUE;
+    }
+
+    SIA_ATOMIC_SUB_U64(&_sia_cache_retained, keep);
     return SIA_FALSE;
+}
+
+void sia_cache_set_limit(sia_u64 max_bytes) {
+    SIA_ATOMIC_STORE_U64(&_sia_cache_limit, max_bytes);
+    sia_cache_trim(max_bytes);
+}
+
+void sia_cache_trim(sia_u64 keep_bytes) {
+    // Largest reservations first, they take the most with them
+    for (sia_u32 size_class = _SIA_CACHE_CLASSES; size_class-- > 0;) {
+        for (sia_u32 i = 0; i < SIA_CACHE_MAX_PER_CLASS; i++) {
+            if (SIA_ATOMIC_LOAD_U64(&_sia_cache_retained) <= keep_bytes) {
+                return;
+            }
+
+            sia_u64 entry = SIA_ATOMIC_LOAD_U64(&_sia_cache_slots[size_class][i]);
+            if (entry > _SIA_CACHE_CLAIMED && SIA_ATOMIC_CAS_U64(&_sia_cache_slots[size_class][i], entry, 0)) {
+                si_arena* arena = (si_arena*)(uintptr_t)entry;
+                SIA_ATOMIC_SUB_U64(&_sia_cache_retained, arena->_reserve_backend.commit_pos);
+                SIA_MEM_RELEASE(arena, (sia_u64)1 << size_class);
+            }
+        }
+    }
+}
+
+sia_u64 sia_cache_get_retained(void) {
+    return SIA_ATOMIC_LOAD_U64(&_sia_cache_retained);
+}
+
+_SIA_UNTRACED si_arena* _SIA_TRACED(sia_create)(const sia_desc* desc) {
+    _sia_init_data init_data = _sia_init_common(desc);
+    
+    si_arena* out = NULL;
+    sia_i32 memfd = -1;
+    sia_u64 warm = 0;
+    sia_u64 reserve_size = init_data.max_size;
+    if (init_data.space != NULL) {
+        sia_space* space = init_data.space;
+        if (init_data.max_size > space->_slot_size) {
+            last_error.code = SIA_ERR_INIT_FAILED;
+            last_error.msg = "Arena is larger than the slots of its address space";
+            init_data.error_callback(last_error);
+            return NULL;
+        }
+
+        // The slot follows the commit rules of the space
+        init_data.flags &= ~(sia_u32)(SIA_FLAG_CHECKPOINT | SIA_FLAG_NORESERVE);
+        init_data.flags |= space->_noreserve ? SIA_FLAG_NORESERVE : 0;
+        out = _sia_space_take(space, &warm);
+        if (out == NULL) {
+            last_error.code = SIA_ERR_INIT_FAILED;
+            last_error.msg = "Address space has no free slots";
+            init_data.error_callback(last_error);
+            return NULL;
+        }
+    } else
+#ifdef SIA_HAS_CHECKPOINTS
+    if (init_data.flags & SIA_FLAG_CHECKPOINT) {
+        // Checkpoints need the memfd, so they take priority
+        init_data.flags &= ~(sia_u32)SIA_FLAG_NORESERVE;
+        out = (si_arena*)_sia_memfd_reserve(init_data.max_size, &memfd);
+    } else
+#endif
+#ifdef SIA_HAS_NORESERVE
+    if (init_data.flags & SIA_FLAG_NORESERVE) {
+        out = (si_arena*)_sia_noreserve_reserve(init_data.max_size);
+    } else
+#endif
+    {
+        // Without memfd support, sia_checkpoint reports an error instead
+        init_data.flags &= ~(sia_u32)(SIA_FLAG_CHECKPOINT | SIA_FLAG_NORESERVE);
+
+        // A cached arena of the same size class comes with its first block still committed
+        reserve_size = _sia_cache_reserve_size(init_data.max_size);
+        out = _sia_cache_take(reserve_size, &warm);
+        if (out == NULL) {
+            out = (si_arena*)SIA_MEM_RESERVE(reserve_size);
+        }
+    }
+
+    if (out == NULL) {
+        last_error.code = SIA_ERR_INIT_FAILED;
+        last_error.msg = "Failed to reserve initial memory for arena";
+        init_data.error_callback(last_error);
+        return NULL;
+    }
+
+    sia_u64 commit_pos = SIA_MAX(warm, (sia_u64)init_data.block_size);
+    sia_b32 governed = (init_data.flags & SIA_FLAG_GOVERNED) != 0;
+
+    // A recycled slot can already have the first block committed
+    sia_b32 needs_commit = !(init_data.flags & SIA_FLAG_NORESERVE) && warm < init_data.block_size;
+    sia_b32 over_limit = governed && !_sia_governor_charge(NULL, commit_pos);
+    if (over_limit || (needs_commit && !SIA_MEM_COMMIT((sia_u8*)out + warm, init_data.block_size - warm))) {
+        last_error.code = over_limit ? SIA_ERR_GOVERNOR_LIMIT : SIA_ERR_INIT_FAILED;
+        last_error.msg = over_limit ? "Governor limit reached" : "Failed to commit initial memory for arena";
+        init_data.error_callback(last_error);
+        if (governed && !over_limit) {
+            _sia_governor_refund(commit_pos);
+        }
+        if (init_data.space != NULL) {
+            _sia_space_give(init_data.space, out, warm);
+            return NULL;
+        }
+        SIA_MEM_RELEASE(out, reserve_size);
+        if (memfd >= 0) { close(memfd); }
+        return NULL;
+    }
+
+    out->_pos = SIA_MIN_POS;
+    out->_size = init_data.max_size;
+    out->_block_size = init_data.block_size;
+    out->_min_block_size = init_data.min_block_size;
+    out->_max_block_size = init_data.max_block_size;
+    out->_align = init_data.align;
+    out->_flags = init_data.flags;
+    out->_reserve_backend.commit_pos = commit_pos;
+    out->_reserve_backend.memfd = memfd;
+    out->_reserve_backend.in_checkpoint = SIA_FALSE;
+    out->_reserve_backend.checkpoint_pos = 0;
+    out->_reserve_backend.checkpoint_commit_pos = 0;
+    out->_reserve_backend.space = init_data.space;
+    out->_reserve_backend.reserve_size = reserve_size;
+    out->_last_error = (sia_error){ .code=SIA_ERR_NONE, .msg="" };
+    out->error_callback = init_data.error_callback;
+    out->_cleanups = NULL;
+    out->_peak_pos = out->_pos;
+    out->_num_commits = needs_commit ? 1 : 0;
+    out->_num_decommits = 0;
+    out->_faulted_pages = 0;
+    out->_name = init_data.name;
+    _sia_guard_init(out, init_data.guard_sample_rate);
+    _sia_tags_init(out, init_data.budget_callback);
+    out->_large_threshold = init_data.large_threshold;
+
+    SIA_ASAN_POISON((sia_u8*)out + SIA_MIN_POS, commit_pos - SIA_MIN_POS);
+    _sia_update_fast(out);
+
+    out->_registry_slot = _sia_registry_add(out, SIA_FALSE);
+
+    return out;
+}
+_SIA_UNTRACED void _SIA_TRACED(sia_destroy)(si_arena* arena) {
+    _sia_registry_remove(arena->_registry_slot);
+
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        _sia_buffer_destroy(arena);
+        return;
+    }
+
+    _sia_run_cleanups(arena, 0);
+    _sia_release_mappings(arena, 0);
+
+    sia_i32 memfd = arena->_reserve_backend.memfd;
+
+    SIA_ASAN_UNPOISON(arena, arena->_reserve_backend.commit_pos);
+    if (arena->_flags & SIA_FLAG_GOVERNED) {
+        _sia_governor_refund(arena->_reserve_backend.commit_pos);
+    }
+
+    // The slot goes back to the space, without a syscall unless the arena grew past the warm size
+    if (arena->_reserve_backend.space != NULL) {
+        _sia_space_give(arena->_reserve_backend.space, arena, arena->_reserve_backend.commit_pos);
+        return;
+    }
+    if (_sia_cache_give(arena)) {
+        return;
+    }
+
+    SIA_MEM_RELEASE(arena, arena->_reserve_backend.reserve_size);
+
+#ifdef SIA_HAS_CHECKPOINTS
+    if (memfd >= 0) {
+        close(memfd);
+    }
 #else
-    sia_u8* arena_start = (sia_u8*)arena;
-    sia_u8* ptr_u8 = (sia_u8*)ptr;
-    sia_u8* min_pos = arena_start + SIA_MIN_POS;
-    return (ptr_u8 >= min_pos && ptr_u8 + size <= arena_start + arena->_pos);
+    SIA_UNUSED(memfd);
+#endif
+}
+
+static void _sia_sync(si_arena* arena) {
+    // Nothing to sync, the arena position is the only state
+    SIA_UNUSED(arena);
+}
+
+static void _sia_update_fast(si_arena* arena) {
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        _sia_buffer_update_fast(arena);
+        return;
+    }
+
+    sia_u64 commit_pos = arena->_reserve_backend.commit_pos;
+
+    arena->_fast_base = (sia_u64)arena;
+    arena->_fast_limit = commit_pos;
+
+    // Pops that stay above the last committed block do not decommit anything
+    arena->_fast_floor = SIA_MAX(SIA_MIN_POS, SIA_ALIGN_DOWN_POW2(commit_pos - 1, arena->_block_size) + 1);
+    arena->_fast_floor = SIA_MAX(arena->_fast_floor, _sia_release_floor(arena));
+    arena->_fast_floor = SIA_MAX(arena->_fast_floor, arena->_reserve_backend.checkpoint_pos);
+
+    // Pops back to the start take the slow path, which shrinks an adaptive step
+    if (arena->_min_block_size != arena->_max_block_size) {
+        arena->_fast_floor = SIA_MAX(arena->_fast_floor, SIA_MIN_POS + 1);
+    }
+}
+
+static void _sia_decommit(si_arena* arena, sia_u64 pos, sia_u64 size) {
+    arena->_faulted_pages += _sia_mem_resident((sia_u8*)arena + pos, size) / SIA_MEM_PAGESIZE();
+    arena->_num_decommits++;
+
+#ifdef SIA_HAS_CHECKPOINTS
+    if (arena->_reserve_backend.memfd >= 0) {
+        _sia_memfd_decommit((sia_u8*)arena + pos, size);
+        return;
+    }
+#endif
+#ifdef SIA_HAS_NORESERVE
+    if (arena->_flags & SIA_FLAG_NORESERVE) {
+        _sia_noreserve_decommit((sia_u8*)arena + pos, size);
+        return;
+    }
 #endif
+
+    SIA_MEM_DECOMMIT((void*)((sia_u8*)arena + pos), size);
+}
+
+// Makes sure that everything below pos is committed
+static sia_b32 _sia_commit_to(si_arena* arena, sia_u64 pos) {
+    sia_u64 commit_pos = arena->_reserve_backend.commit_pos;
+    if (pos <= commit_pos) {
+        return SIA_TRUE;
+    }
+
+    sia_u64 commit_unclamped = SIA_ALIGN_UP_POW2(pos, arena->_block_size);
+    sia_u64 new_commit_pos = SIA_MIN(commit_unclamped, arena->_size);
+    sia_u64 commit_size = new_commit_pos - commit_pos;
+
+    if ((arena->_flags & SIA_FLAG_GOVERNED) && !_sia_governor_charge(arena, commit_size)) {
+        last_error.code = SIA_ERR_GOVERNOR_LIMIT;
+        last_error.msg = "Governor limit reached";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return SIA_FALSE;
+    }
+
+    // The whole arena is already readable and writable, only the position moves
+    if (!(arena->_flags & SIA_FLAG_NORESERVE)) {
+        if (!SIA_MEM_COMMIT((void*)((sia_u8*)arena + commit_pos), commit_size)) {
+            if (arena->_flags & SIA_FLAG_GOVERNED) {
+                _sia_governor_refund(commit_size);
+            }
+            last_error.code = SIA_ERR_COMMIT_FAILED;
+            last_error.msg = "Failed to commit memory";
+            arena->_last_error = last_error;
+            arena->error_callback(last_error);
+            return SIA_FALSE;
+        }
+        arena->_num_commits++;
+    }
+    SIA_ASAN_POISON((sia_u8*)arena + commit_pos, commit_size);
+
+    arena->_reserve_backend.commit_pos = new_commit_pos;
+    arena->_block_size = SIA_MIN(arena->_block_size * 2, arena->_max_block_size);
+
+    return SIA_TRUE;
+}
+
+static void* _sia_push_impl(si_arena* arena, sia_u64 size, sia_u32 align) {
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        return _sia_buffer_push(arena, size, align);
+    }
+
+    // Alignment is applied to the address, so alignments above the page size work too
+    sia_u64 arena_addr = (sia_u64)arena;
+    sia_u64 pos_aligned = SIA_ALIGN_UP_POW2(arena_addr + arena->_pos, align) - arena_addr;
+
+    if (pos_aligned + size > arena->_size) {
+        last_error.code = SIA_ERR_OUT_OF_MEMORY;
+        last_error.msg = "Arena ran out of memory";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return NULL;
+    }
+
+    if (!_sia_commit_to(arena, pos_aligned + size)) {
+        return NULL;
+    }
+
+    arena->_pos = pos_aligned + size;
+
+    return (void*)((sia_u8*)arena + pos_aligned);
+}
+
+// Grows the last allocation by size bytes
+static sia_b32 _sia_grow_last(si_arena* arena, sia_u64 size) {
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        return _sia_buffer_grow_last(arena, size);
+    }
+
+    if (arena->_pos + size > arena->_size || !_sia_commit_to(arena, arena->_pos + size)) {
+        return SIA_FALSE;
+    }
+
+    arena->_pos += size;
+
+    return SIA_TRUE;
+}
+
+void _sia_pop_slow(si_arena* arena, sia_u64 size) {
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        _sia_buffer_pop(arena, size);
+        return;
+    }
+
+    if (size > arena->_pos - SIA_MIN_POS) {
+        last_error.code = SIA_ERR_CANNOT_POP_MORE;
+        last_error.msg = "Attempted to pop too much memory";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+
+        return;
+    }
+
+    // Memory below the checkpoint position has to stay the same for sia_rollback
+    if (arena->_pos - size < arena->_reserve_backend.checkpoint_pos) {
+        last_error.code = SIA_ERR_CANNOT_POP_MORE;
+        last_error.msg = "Attempted to pop below an active checkpoint";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+
+        return;
+    }
+
+    sia_u64 old_pos = arena->_pos;
+    _sia_run_cleanups(arena, old_pos - size);
+    _sia_release_mappings(arena, old_pos - size);
+    _sia_release_tags(arena, old_pos - size);
+
+    arena->_pos = SIA_MAX(SIA_MIN_POS, arena->_pos - size);
+    SIA_ASAN_POISON((sia_u8*)arena + arena->_pos, old_pos - arena->_pos);
+
+    // Also decommits everything past the smallest step
+    if (arena->_pos == SIA_MIN_POS) {
+        arena->_block_size = arena->_min_block_size;
+    }
+
+    sia_u64 new_commit = SIA_MIN(arena->_size, SIA_ALIGN_UP_POW2(arena->_pos, arena->_block_size));
+    sia_u64 commit_pos = arena->_reserve_backend.commit_pos;
+
+    if (new_commit < commit_pos) {
+        sia_u64 decommit_size = commit_pos - new_commit;
+        _sia_decommit(arena, new_commit, decommit_size);
+        arena->_reserve_backend.commit_pos = new_commit;
+        if (arena->_flags & SIA_FLAG_GOVERNED) {
+            _sia_governor_refund(decommit_size);
+        }
+        // sia_destroy only unpoisons the committed range, and the memory can be mapped again later
+        SIA_ASAN_UNPOISON((sia_u8*)arena + new_commit, decommit_size);
+    }
+
+    _sia_update_fast(arena);
+}
+
+#endif // NOT SIA_FORCE_MALLOC
+
+/*
+All Backends
+=========================================================
+    _   _    _      ___   _   ___ _  _____ _  _ ___  ___ 
+   /_\ | |  | |    | _ ) /_\ / __| |/ / __| \| |   \/ __|
+  / _ \| |__| |__  | _ \/ _ \ (__| ' <| _|| .` | |) \__ \
+ /_/ \_\____|____| |___/_/ \_\___|_|\_\___|_|\_|___/|___/
+
+=========================================================
+*/
+
+
+sia_error sia_space_get_error(sia_space* space) {
+    sia_error* err = space == NULL ? &last_error : &space->_last_error;
+    sia_error temp = *err;
+
+    *err = (sia_error){ SIA_ERR_NONE, "" };
+
+    return temp;
+}
+sia_u64 sia_space_get_slot_size(sia_space* space) { return space->_slot_size; }
+sia_u32 sia_space_get_capacity(sia_space* space) { return space->_num_slots; }
+sia_u32 sia_space_get_used(sia_space* space) { return SIA_ATOMIC_LOAD_U32(&space->_num_used); }
+
+sia_error sia_get_error(si_arena* arena) {
+    sia_error* err = arena == NULL ? &last_error : &arena->_last_error;
+    sia_error temp = *err;
+
+    *err = (sia_error){ SIA_ERR_NONE, "" };
+    
+    return temp;
+}
+
+sia_u64 sia_get_pos(si_arena* arena) { return arena->_pos; }
+sia_u64 sia_get_size(si_arena* arena) { return arena->_size; }
+sia_u32 sia_get_block_size(si_arena* arena) { return arena->_block_size; }
+sia_u32 sia_get_align(si_arena* arena) { return arena->_align; }
+
+
+// Buffer arenas keep the arena header at the start of the buffer,
+// so positions are offsets from the header, the same as the low level backend
+#define _SIA_BUFFER_MIN_POS SIA_ALIGN_UP_POW2(sizeof(si_arena), 64)
+
+_SIA_UNTRACED si_arena* _SIA_TRACED(sia_create_from_buffer)(void* buf, sia_u64 size, const sia_desc* desc) {
+    sia_desc empty_desc = { 0 };
+    if (desc == NULL) {
+        desc = &empty_desc;
+    }
+
+    sia_error_callback* error_callback = desc->error_callback == NULL ?
+        _sia_empty_error_callback : desc->error_callback;
+
+    sia_u64 buf_addr = (sia_u64)buf;
+    sia_u64 header_addr = SIA_ALIGN_UP_POW2(buf_addr, 64);
+
+    if (buf == NULL || size < header_addr - buf_addr + _SIA_BUFFER_MIN_POS) {
+        last_error.code = SIA_ERR_INIT_FAILED;
+        last_error.msg = "Buffer is too small for arena";
+        error_callback(last_error);
+        return NULL;
+    }
+
+    si_arena* out = (si_arena*)(uintptr_t)header_addr;
+
+    out->_pos = _SIA_BUFFER_MIN_POS;
+    out->_size = size - (header_addr - buf_addr);
+    out->_block_size = 0;
+    out->_min_block_size = 0;
+    out->_max_block_size = 0;
+    out->_align = desc->align == 0 ? (sizeof(void*)) : desc->align;
+    out->_flags = (desc->flags & SIA_FLAG_OVERFLOW) | _SIA_FLAG_BUFFER;
+    out->_last_error = (sia_error){ .code=SIA_ERR_NONE, .msg="" };
+    out->error_callback = error_callback;
+    out->_cleanups = NULL;
+    out->_peak_pos = out->_pos;
+    out->_num_commits = 0;
+    out->_num_decommits = 0;
+    out->_faulted_pages = 0;
+    out->_name = desc->name;
+    // Sampling and large allocations need syscalls, so buffer arenas never use them
+    _sia_guard_init(out, 0);
+    _sia_tags_init(out, desc->budget_callback);
+    out->_large_threshold = UINT64_MAX;
+
+    out->_buffer_backend = (_sia_buffer_backend){ 0 };
+    out->_buffer_backend.overflow_desc = *desc;
+    out->_buffer_backend.overflow_desc.flags = 0;
+
+    SIA_ASAN_POISON((sia_u8*)out + out->_pos, out->_size - out->_pos);
+    _sia_update_fast(out);
+
+    out->_registry_slot = _sia_registry_add(out, SIA_FALSE);
+
+    return out;
+}
+
+static void _sia_buffer_destroy(si_arena* arena) {
+    _sia_run_cleanups(arena, 0);
+    _sia_release_mappings(arena, 0);
+
+    if (arena->_buffer_backend.overflow != NULL) {
+        sia_destroy(arena->_buffer_backend.overflow);
+    }
+
+    // The buffer belongs to the caller, and may be reused as regular stack memory
+    SIA_ASAN_UNPOISON(arena, arena->_size);
+}
+
+static void _sia_buffer_update_fast(si_arena* arena) {
+    if (arena->_buffer_backend.overflowing) {
+        // Everything goes through the slow path, which forwards to the overflow arena
+        arena->_fast_base = 0;
+        arena->_fast_limit = 0;
+        arena->_fast_floor = UINT64_MAX;
+        return;
+    }
+
+    arena->_fast_base = (sia_u64)arena;
+    arena->_fast_limit = arena->_size;
+    arena->_fast_floor = SIA_MAX(_SIA_BUFFER_MIN_POS, _sia_release_floor(arena));
+}
+
+static void* _sia_buffer_push(si_arena* arena, sia_u64 size, sia_u32 align) {
+    _sia_buffer_backend* backend = &arena->_buffer_backend;
+
+    if (!backend->overflowing) {
+        sia_u64 arena_addr = (sia_u64)arena;
+        sia_u64 pos_aligned = SIA_ALIGN_UP_POW2(arena_addr + arena->_pos, align) - arena_addr;
+
+        if (pos_aligned + size <= arena->_size && pos_aligned + size >= pos_aligned) {
+            arena->_pos = pos_aligned + size;
+            return (void*)((sia_u8*)arena + pos_aligned);
+        }
+
+        if (!(arena->_flags & SIA_FLAG_OVERFLOW)) {
+            last_error.code = SIA_ERR_OUT_OF_MEMORY;
+            last_error.msg = "Arena ran out of memory";
+            arena->_last_error = last_error;
+            arena->error_callback(last_error);
+            return NULL;
+        }
+
+        if (backend->overflow == NULL) {
+            backend->overflow = sia_create(&backend->overflow_desc);
+            if (backend->overflow == NULL) {
+                arena->_last_error = last_error;
+                return NULL;
+            }
+        }
+
+        backend->overflowing = SIA_TRUE;
+        backend->overflow_pos = arena->_pos;
+        backend->overflow_start = backend->overflow->_pos;
+    }
+
+    si_arena* overflow = backend->overflow;
+
+    void* out = sia_push_aligned(overflow, size, align);
+    if (out == NULL) {
+        // The overflow arena already reported the error
+        arena->_last_error = overflow->_last_error;
+        backend->overflowing = overflow->_pos != backend->overflow_start;
+        return NULL;
+    }
+
+    arena->_pos = backend->overflow_pos + (overflow->_pos - backend->overflow_start);
+
+    return out;
+}
+
+// Allocations only grow in place while they are in the buffer
+static sia_b32 _sia_buffer_grow_last(si_arena* arena, sia_u64 size) {
+    if (arena->_buffer_backend.overflowing || arena->_pos + size > arena->_size) {
+        return SIA_FALSE;
+    }
+
+    arena->_pos += size;
+
+    return SIA_TRUE;
+}
+
+static void _sia_buffer_pop(si_arena* arena, sia_u64 size) {
+    if (size > arena->_pos - _SIA_BUFFER_MIN_POS) {
+        last_error.code = SIA_ERR_CANNOT_POP_MORE;
+        last_error.msg = "Attempted to pop too much memory";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+
+        return;
+    }
+
+    sia_u64 new_pos = arena->_pos - size;
+    _sia_run_cleanups(arena, new_pos);
+    _sia_release_mappings(arena, new_pos);
+    _sia_release_tags(arena, new_pos);
+
+    _sia_buffer_backend* backend = &arena->_buffer_backend;
+    if (backend->overflowing) {
+        if (new_pos > backend->overflow_pos) {
+            sia_pop_to(backend->overflow, backend->overflow_start + (new_pos - backend->overflow_pos));
+            arena->_pos = new_pos;
+            return;
+        }
+
+        // Back in the buffer, the overflow arena stays around for the next time the buffer fills
+        sia_pop_to(backend->overflow, backend->overflow_start);
+        backend->overflowing = SIA_FALSE;
+        arena->_pos = backend->overflow_pos;
+    }
+
+    SIA_ASAN_POISON((sia_u8*)arena + new_pos, arena->_pos - new_pos);
+    arena->_pos = new_pos;
+
+    _sia_update_fast(arena);
+}
+
+// Position of an empty arena
+static sia_u64 _sia_start_pos(si_arena* arena) {
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        return _SIA_BUFFER_MIN_POS;
+    }
+
+#ifdef SIA_FORCE_MALLOC
+    return 0;
+#else
+    return SIA_MIN_POS;
+#endif
+}
+
+_SIA_UNTRACED void _SIA_TRACED(sia_reset)(si_arena* arena) {
+    sia_pop_to(arena, _sia_start_pos(arena));
+}
+
+sia_memory_stats sia_get_memory_stats(si_arena* arena) {
+    _sia_sync(arena);
+
+    sia_memory_stats out = {
+        .pos = arena->_pos,
+        .peak_pos = SIA_MAX(arena->_peak_pos, arena->_pos),
+        .size = arena->_size,
+        .num_commits = arena->_num_commits,
+        .num_decommits = arena->_num_decommits
+    };
+
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        out.committed = arena->_size;
+        out.resident = _sia_mem_resident(arena, arena->_size);
+    } else {
+#ifdef SIA_FORCE_MALLOC
+        for (_sia_malloc_node* node = arena->_malloc_backend.cur_node; node != NULL; node = node->prev) {
+            out.committed += node->size;
+            // Nodes share pages with other heap allocations, so this is approximate
+            out.resident += SIA_MIN(_sia_mem_resident(node->data, node->size), node->size);
+
+            if (node != arena->_malloc_backend.cur_node) {
+                out.slack += node->size - node->pos;
+            }
+        }
+#else
+        out.committed = arena->_reserve_backend.commit_pos;
+        out.resident = _sia_mem_resident(arena, arena->_reserve_backend.commit_pos);
+#endif
+    }
+
+    // Resident pages have all been faulted in at some point
+    out.faulted_pages = arena->_faulted_pages + out.resident / SIA_MEM_PAGESIZE();
+
+    if ((arena->_flags & _SIA_FLAG_BUFFER) && arena->_buffer_backend.overflow != NULL) {
+        sia_memory_stats overflow = sia_get_memory_stats(arena->_buffer_backend.overflow);
+
+        out.committed += overflow.committed;
+        out.resident += overflow.resident;
+        out.slack += overflow.slack;
+        out.num_commits += overflow.num_commits;
+        out.num_decommits += overflow.num_decommits;
+        out.faulted_pages += overflow.faulted_pages;
+    }
+
+    return out;
+}
+
+void sia_set_global_error_callback(sia_error_callback* callback) {
+    _sia_global_error_callback = callback;
+}
+
+sia_error_callback* sia_get_global_error_callback(void) {
+    return _sia_global_error_callback;
+}
+
+static void _sia_guard_init(si_arena* arena, sia_u32 sample_rate) {
+    // The fast path only runs while the countdown is above 1,
+    // so disabled sampling starts at the maximum
+    arena->_guard_sample_rate = sample_rate;
+    arena->_guard_countdown = sample_rate == 0 ? UINT32_MAX : sample_rate;
+    arena->_guard_rng = (sia_u64)arena | 1;
+    arena->_mappings = NULL;
+}
+
+// Picks the number of pushes until the next guarded allocation,
+// uniformly in [1, 2 * rate - 1] so the average stays at rate
+static sia_u32 _sia_guard_next_countdown(si_arena* arena) {
+    // xorshift64
+    sia_u64 x = arena->_guard_rng;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    arena->_guard_rng = x;
+
+    return 1 + (sia_u32)(x % (2 * (sia_u64)arena->_guard_sample_rate - 1));
+}
+
+// Releases every out-of-line mapping that lives past pos
+static void _sia_release_mappings(si_arena* arena, sia_u64 pos) {
+    while (arena->_mappings != NULL && arena->_mappings->end_pos > pos) {
+        _sia_mapping* mapping = arena->_mappings;
+        arena->_mappings = mapping->prev;
+        _sia_governor_refund_mapping(arena, mapping->map_size);
+
+#ifdef SIA_HAS_LARGE_OBJECTS
+        if (mapping->is_large) {
+            _sia_large_unmap(mapping->base, mapping->map_size);
+            continue;
+        }
+#endif
+#ifdef SIA_HAS_FILE_IO
+        if (mapping->is_file) {
+            _sia_file_unmap(mapping->base, mapping->map_size);
+            continue;
+        }
+#endif
+#ifdef SIA_HAS_GUARD_PAGES
+        _sia_guard_unmap(mapping->base, mapping->map_size);
+#endif
+    }
+}
+
+// Runs every cleanup registered past pos, newest first
+static void _sia_run_cleanups(si_arena* arena, sia_u64 pos) {
+    while (arena->_cleanups != NULL && arena->_cleanups->end_pos > pos) {
+        _sia_cleanup* cleanup = arena->_cleanups;
+        arena->_cleanups = cleanup->prev;
+
+        cleanup->func(cleanup->ptr);
+    }
+}
+
+// Lowest position that the arena can pop to without releasing anything it owns
+static sia_u64 _sia_release_floor(si_arena* arena) {
+    sia_u64 out = 0;
+    if (arena->_mappings != NULL) {
+        out = SIA_MAX(out, arena->_mappings->end_pos);
+    }
+    if (arena->_cleanups != NULL) {
+        out = SIA_MAX(out, arena->_cleanups->end_pos);
+    }
+    if (arena->_tag_records != NULL) {
+        out = SIA_MAX(out, arena->_tag_records->end_pos);
+    }
+    return out;
+}
+
+static _sia_mapping* _sia_find_mapping(si_arena* arena, void* ptr) {
+    for (_sia_mapping* mapping = arena->_mappings; mapping != NULL; mapping = mapping->prev) {
+        sia_u8* base = (sia_u8*)mapping->base;
+        if ((sia_u8*)ptr >= base && (sia_u8*)ptr < base + mapping->map_size) {
+            return mapping;
+        }
+    }
+    return NULL;
+}
+
+#ifdef SIA_HAS_GUARD_PAGES
+// Places the allocation in its own mapping, directly against an inaccessible page.
+// The arena still advances by size, so positions and pops behave the same as without sampling
+static void* _sia_push_guarded(si_arena* arena, sia_u64 size, sia_u32 align) {
+    void* slot = _sia_push_impl(arena, size, align);
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    sia_u32 page_size = SIA_MEM_PAGESIZE();
+    sia_u64 data_size = SIA_ALIGN_UP_POW2(sizeof(_sia_mapping) + size + align, page_size);
+
+    // Sampling is best effort, so over the governor limit or without memory
+    // it falls back to the regular allocation
+    sia_b32 governed = (arena->_flags & SIA_FLAG_GOVERNED) != 0;
+    sia_u8* base = NULL;
+    if (!governed || _sia_governor_charge(arena, data_size + page_size)) {
+        base = (sia_u8*)_sia_guard_map(data_size, page_size);
+        if (base == NULL && governed) {
+            _sia_governor_refund(data_size + page_size);
+        }
+    }
+    if (base == NULL) {
+        SIA_ASAN_UNPOISON(slot, size);
+        return slot;
+    }
+
+    _sia_mapping* mapping = (_sia_mapping*)base;
+    mapping->prev = arena->_mappings;
+    mapping->end_pos = arena->_pos;
+    mapping->base = base;
+    mapping->map_size = data_size + page_size;
+    mapping->is_large = SIA_FALSE;
+    mapping->is_file = SIA_FALSE;
+    arena->_mappings = mapping;
+
+    return (void*)SIA_ALIGN_DOWN_POW2(base + data_size - size, align);
+}
+#endif
+
+#ifdef SIA_HAS_LARGE_OBJECTS
+// Gives the allocation its own page aligned mapping.
+// Only the record is pushed on the arena, so popping it unmaps the allocation
+static void* _sia_push_large(si_arena* arena, sia_u64 size) {
+    sia_u64 map_size = SIA_ALIGN_UP_POW2(size, SIA_MEM_PAGESIZE());
+    if (map_size < size) {
+        last_error.code = SIA_ERR_OUT_OF_MEMORY;
+        last_error.msg = "Large allocation is too big";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return NULL;
+    }
+
+    if (!_sia_governor_charge_mapping(arena, map_size)) {
+        return NULL;
+    }
+
+    void* base = _sia_large_map(map_size);
+    if (base == NULL) {
+        _sia_governor_refund_mapping(arena, map_size);
+        last_error.code = SIA_ERR_COMMIT_FAILED;
+        last_error.msg = "Failed to map large allocation";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return NULL;
+    }
+
+    _sia_mapping* mapping = (_sia_mapping*)_sia_push_impl(arena, sizeof(_sia_mapping), (sia_u32)sizeof(void*));
+    if (mapping == NULL) {
+        _sia_large_unmap(base, map_size);
+        _sia_governor_refund_mapping(arena, map_size);
+        return NULL;
+    }
+    SIA_ASAN_UNPOISON(mapping, sizeof(_sia_mapping));
+
+    mapping->prev = arena->_mappings;
+    mapping->end_pos = arena->_pos;
+    mapping->base = base;
+    mapping->map_size = map_size;
+    mapping->is_large = SIA_TRUE;
+    mapping->is_file = SIA_FALSE;
+    arena->_mappings = mapping;
+
+    return base;
+}
+#endif
+
+void* _sia_push_slow(si_arena* arena, sia_u64 size, sia_u32 align) {
+    if (align == 0 || (align & (align - 1)) != 0) {
+        last_error.code = SIA_ERR_INVALID_ALIGN;
+        last_error.msg = "Alignment must be a power of 2";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return NULL;
+    }
+
+    _sia_sync(arena);
+
+    void* out = NULL;
+
+#ifdef SIA_HAS_LARGE_OBJECTS
+    if (size >= arena->_large_threshold && align <= SIA_MEM_PAGESIZE()) {
+        out = _sia_push_large(arena, size);
+
+        _sia_update_fast(arena);
+        return out;
+    }
+#endif
+
+#ifdef SIA_HAS_GUARD_PAGES
+    if (arena->_guard_sample_rate == 0) {
+        arena->_guard_countdown = UINT32_MAX;
+    } else if (--arena->_guard_countdown == 0) {
+        arena->_guard_countdown = _sia_guard_next_countdown(arena);
+        out = _sia_push_guarded(arena, size, align);
+
+        _sia_update_fast(arena);
+        return out;
+    }
+#else
+    arena->_guard_countdown = UINT32_MAX;
+#endif
+
+    out = _sia_push_impl(arena, size, align);
+    if (out != NULL) {
+        SIA_ASAN_UNPOISON(out, size);
+    }
+
+    _sia_update_fast(arena);
+    return out;
+}
+
+void* sia_push(si_arena* arena, sia_u64 size) {
+    return sia_push_fast(arena, size);
+}
+
+void* sia_push_zero(si_arena* arena, sia_u64 size) {
+    return sia_push_zero_fast(arena, size);
+}
+
+void* sia_push_aligned(si_arena* arena, sia_u64 size, sia_u32 align) {
+    return sia_push_aligned_fast(arena, size, align);
+}
+
+void* sia_push_zero_aligned(si_arena* arena, sia_u64 size, sia_u32 align) {
+    return sia_push_zero_aligned_fast(arena, size, align);
+}
+
+void sia_pop(si_arena* arena, sia_u64 size) {
+    sia_pop_fast(arena, size);
+}
+
+sia_b32 sia_add_cleanup(si_arena* arena, void* ptr, sia_cleanup_func* func) {
+    // The record goes after the object, so the object is always popped first
+    _sia_cleanup* cleanup = SIA_PUSH_STRUCT(arena, _sia_cleanup);
+    if (cleanup == NULL) {
+        return SIA_FALSE;
+    }
+
+    cleanup->prev = arena->_cleanups;
+    cleanup->end_pos = arena->_pos;
+    cleanup->func = func;
+    cleanup->ptr = ptr;
+    arena->_cleanups = cleanup;
+
+    // Raises the fast path floor, so pops below the record take the slow path
+    _sia_sync(arena);
+    _sia_update_fast(arena);
+
+    return SIA_TRUE;
+}
+
+void* sia_push_aligned_with_cleanup(si_arena* arena, sia_u64 size, sia_u32 align, sia_cleanup_func* func) {
+    sia_u64 start_pos = arena->_pos;
+
+    void* out = sia_push_aligned(arena, size, align);
+    if (out == NULL) {
+        return NULL;
+    }
+
+    if (!sia_add_cleanup(arena, out, func)) {
+        sia_pop_to(arena, start_pos);
+        return NULL;
+    }
+
+    return out;
+}
+
+void* sia_push_with_cleanup(si_arena* arena, sia_u64 size, sia_cleanup_func* func) {
+    return sia_push_aligned_with_cleanup(arena, size, arena->_align, func);
+}
+
+static sia_b32 _sia_is_valid_ptr(si_arena* arena, void* ptr, sia_u64 size) {
+    if (ptr == NULL) return SIA_FALSE;
+
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        _sia_buffer_backend* backend = &arena->_buffer_backend;
+        sia_u8* arena_start = (sia_u8*)arena;
+        sia_u8* ptr_u8 = (sia_u8*)ptr;
+        sia_u64 buffer_pos = backend->overflowing ? backend->overflow_pos : arena->_pos;
+
+        if (ptr_u8 >= arena_start + _SIA_BUFFER_MIN_POS && ptr_u8 + size <= arena_start + buffer_pos) {
+            return SIA_TRUE;
+        }
+        return backend->overflowing && _sia_is_valid_ptr(backend->overflow, ptr, size);
+    }
+    
+#ifdef SIA_FORCE_MALLOC
+    _sia_malloc_node* node = arena->_malloc_backend.cur_node;
+    while (node != NULL) {
+        sia_u8* node_start = node->data;
+        sia_u8* node_end = node_start + node->size;
+        sia_u8* ptr_u8 = (sia_u8*)ptr;
+        if (ptr_u8 >= node_start && ptr_u8 + size <= node_end) {
+            return SIA_TRUE;
+        }
+        node = node->prev;
+    }
+    return SIA_FALSE;
+#else
+    sia_u8* arena_start = (sia_u8*)arena;
+    sia_u8* ptr_u8 = (sia_u8*)ptr;
+    sia_u8* min_pos = arena_start + SIA_MIN_POS;
+    return (ptr_u8 >= min_pos && ptr_u8 + size <= arena_start + arena->_pos);
+#endif
+}
+
+static sia_b32 _sia_is_last_allocation(si_arena* arena, void* ptr, sia_u64 size) {
+    if (arena->_flags & _SIA_FLAG_BUFFER) {
+        // Allocations in the overflow arena never grow in place
+        return !arena->_buffer_backend.overflowing &&
+            (sia_u8*)ptr >= (sia_u8*)arena + _SIA_BUFFER_MIN_POS &&
+            (sia_u8*)ptr + size == (sia_u8*)arena + arena->_pos;
+    }
+
+#ifdef SIA_FORCE_MALLOC
+    _sia_malloc_node* node = arena->_malloc_backend.cur_node;
+    sia_u8* node_start = node->data;
+    sia_u8* ptr_u8 = (sia_u8*)ptr;
+    
+    if (ptr_u8 < node_start || ptr_u8 >= node_start + node->size) {
+        return SIA_FALSE;
+    }
+    
+    // ptr is already aligned, with whatever alignment it was pushed with
+    sia_u64 ptr_offset = ptr_u8 - node_start;
+    sia_u64 allocation_end = ptr_offset + size;
+    
+    return (allocation_end == node->pos);
+#else
+    sia_u8* arena_start = (sia_u8*)arena;
+    sia_u8* ptr_u8 = (sia_u8*)ptr;
+    
+    if (ptr_u8 < arena_start + SIA_MIN_POS || ptr_u8 >= arena_start + arena->_pos) {
+        return SIA_FALSE;
+    }
+    
+    // ptr is already aligned, with whatever alignment it was pushed with
+    sia_u64 ptr_offset = ptr_u8 - arena_start;
+    sia_u64 allocation_end = ptr_offset + size;
+    
+    return (allocation_end == arena->_pos);
+#endif
+}
+
+// Pushes a copy of everything in src onto merged
+static sia_b32 _sia_merge_copy(si_arena* merged, si_arena* src) {
+    _sia_sync(src);
+
+    // The copies include alignment padding, which is poisoned in ASan builds
+    if (src->_flags & _SIA_FLAG_BUFFER) {
+        _sia_buffer_backend* backend = &src->_buffer_backend;
+        sia_u64 buffer_pos = backend->overflowing ? backend->overflow_pos : src->_pos;
+        sia_u64 copy_size = buffer_pos - _SIA_BUFFER_MIN_POS;
+
+        if (copy_size > 0) {
+            void* src_data = (void*)((sia_u8*)src + _SIA_BUFFER_MIN_POS);
+            SIA_ASAN_UNPOISON(src_data, copy_size);
+            void* dst = sia_push(merged, copy_size);
+            if (dst == NULL) {
+                return SIA_FALSE;
+            }
+            SIA_MEMCPY(dst, src_data, copy_size);
+        }
+
+        return !backend->overflowing || _sia_merge_copy(merged, backend->overflow);
+    }
+
+#ifdef SIA_FORCE_MALLOC
+    _sia_malloc_node* node = src->_malloc_backend.cur_node;
+    while (node != NULL) {
+        sia_u64 copy_size = node->pos;
+        if (copy_size > 0){
+            SIA_ASAN_UNPOISON(node->data, copy_size);
+            void* dst = sia_push(merged, copy_size);
+            if (dst == NULL){
+                return SIA_FALSE;
+            }
+            SIA_MEMCPY(dst, node->data, copy_size);
+        }
+        node = node->prev;
+    }
+#else
+    // Copy from low-level backend: single contiguous copy
+    if (src->_pos > SIA_MIN_POS) {
+        sia_u64 copy_size = src->_pos - SIA_MIN_POS;
+        void* src_data = (void*)((sia_u8*)src + SIA_MIN_POS);
+        SIA_ASAN_UNPOISON(src_data, copy_size);
+        void* dst = sia_push(merged, copy_size);
+        if (dst == NULL) {
+            return SIA_FALSE;
+        }
+        SIA_MEMCPY(dst, src_data, copy_size);
+    }
+#endif
+
+    return SIA_TRUE;
+}
+
+si_arena* sia_merge(si_arena** arenas, sia_u32 num_arenas){
+    if (arenas == NULL || num_arenas == 0) {
+        last_error.code = SIA_ERR_INVALID_PTR;
+        last_error.msg = "Arenas are NULL or empty";
+        if (_sia_global_error_callback != NULL) {
+            _sia_global_error_callback(last_error);
+        }
+#ifndef SIA_NO_STDIO
+        else {
+            _sia_stderr_error_callback(last_error);
+        }
+#endif
+        return NULL;
+    }
+
+    sia_u64 total_size = 0;
+    for (sia_u32 i = 0; i < num_arenas; i++) {
+        if (arenas[i] == NULL) {
+            last_error.code = SIA_ERR_INVALID_PTR;
+            last_error.msg = "Arena is NULL";
+            if (_sia_global_error_callback != NULL) {
+                _sia_global_error_callback(last_error);
+            }
+#ifndef SIA_NO_STDIO
+            else {
+                _sia_stderr_error_callback(last_error);
+            }
+#endif
+            return NULL;
+        }
+        total_size += arenas[i]->_pos - _sia_start_pos(arenas[i]);
+    }
+
+    sia_u32 max_block_size = 0;
+    sia_u32 max_align = 0;
+    sia_error_callback* error_cb = NULL;
+    
+    for (sia_u32 i = 0; i < num_arenas; i++) {
+        if (arenas[i]->_block_size > max_block_size) {
+            max_block_size = arenas[i]->_block_size;
+        }
+        if (arenas[i]->_align > max_align) {
+            max_align = arenas[i]->_align;
+        }
+        // Use first arena's error callback, or global if available
+        if (i == 0) {
+            error_cb = arenas[i]->error_callback;
+        }
+    }
+    
+    // Use global callback if available, otherwise use first arena's
+    if (_sia_global_error_callback != NULL) {
+        error_cb = _sia_global_error_callback;
+    }
+
+#ifndef SIA_NO_STDIO
+    // Default to stderr if no callback set
+    if (error_cb == NULL || error_cb == _sia_empty_error_callback) {
+        error_cb = _sia_stderr_error_callback;
+    }
+#endif
+    sia_desc merged_desc = {
+        .desired_max_size = total_size,
+        .desired_block_size = max_block_size,
+        .align = max_align, 
+        .error_callback = error_cb  
+    };
+
+     si_arena* merged = sia_create(&merged_desc);
+     if (merged == NULL) {
+         return NULL;
+     }
+     
+    for (sia_u32 i = 0; i < num_arenas; i++) {
+        if (!_sia_merge_copy(merged, arenas[i])) {
+            last_error.code = SIA_ERR_MERGE_FAILED;
+            last_error.msg = "Failed to allocate memory for merge";
+            merged->_last_error = last_error;
+            merged->error_callback(last_error);
+            sia_destroy(merged);
+            return NULL;
+        }
+    }
+    
+    // Validate merge was successful
+    sia_u64 merged_used = sia_get_pos(merged) - _sia_start_pos(merged);
+    if (merged_used != total_size) {
+        last_error.code = SIA_ERR_MERGE_FAILED;
+        last_error.msg = "Merge validation failed: size mismatch";
+        merged->_last_error = last_error;
+        merged->error_callback(last_error);
+        sia_destroy(merged);
+        return NULL;
+    }
+     
+    return merged;
+}
+
+#ifdef SIA_HAS_CHECKPOINTS
+
+sia_snapshot sia_checkpoint(si_arena* arena) {
+    _sia_reserve_backend* backend = &arena->_reserve_backend;
+
+    if ((arena->_flags & _SIA_FLAG_BUFFER) || !(arena->_flags & SIA_FLAG_CHECKPOINT)) {
+        last_error.code = SIA_ERR_CHECKPOINT_FAILED;
+        last_error.msg = "Arena was not created with SIA_FLAG_CHECKPOINT";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return (sia_snapshot){ 0 };
+    }
+    if (backend->in_checkpoint) {
+        last_error.code = SIA_ERR_CHECKPOINT_FAILED;
+        last_error.msg = "Arena already has an active checkpoint";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return (sia_snapshot){ 0 };
+    }
+
+    // Set before the remap, so that the memfd keeps them for sia_rollback
+    backend->in_checkpoint = SIA_TRUE;
+    backend->checkpoint_pos = arena->_pos;
+    backend->checkpoint_commit_pos = backend->commit_pos;
+    _sia_update_fast(arena);
+
+    // From here on, writes to the committed range go to private copies of the pages
+    if (!_sia_memfd_remap(arena, 0, backend->commit_pos, backend->memfd, SIA_TRUE, SIA_TRUE)) {
+        backend->in_checkpoint = SIA_FALSE;
+        backend->checkpoint_pos = 0;
+        backend->checkpoint_commit_pos = 0;
+        _sia_update_fast(arena);
+
+        last_error.code = SIA_ERR_CHECKPOINT_FAILED;
+        last_error.msg = "Failed to remap arena for checkpoint";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return (sia_snapshot){ 0 };
+    }
+
+    return (sia_snapshot){
+        .arena = arena,
+        ._pos = arena->_pos
+    };
+}
+
+void sia_rollback(sia_snapshot snapshot) {
+    si_arena* arena = snapshot.arena;
+    if (arena == NULL) {
+        return;
+    }
+
+    _sia_reserve_backend* backend = &arena->_reserve_backend;
+    if (!backend->in_checkpoint) {
+        last_error.code = SIA_ERR_CHECKPOINT_FAILED;
+        last_error.msg = "Arena does not have an active checkpoint";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return;
+    }
+
+    // Everything pushed since the checkpoint is thrown away
+    _sia_run_cleanups(arena, backend->checkpoint_pos);
+    _sia_release_mappings(arena, backend->checkpoint_pos);
+    _sia_release_tags(arena, backend->checkpoint_pos);
+
+    sia_i32 memfd = backend->memfd;
+    sia_u64 commit_pos = backend->commit_pos;
+    sia_u64 checkpoint_commit = backend->checkpoint_commit_pos;
+
+    // Memory committed after the checkpoint is not part of the copy-on-write view
+    if (commit_pos > checkpoint_commit) {
+        _sia_decommit(arena, checkpoint_commit, commit_pos - checkpoint_commit);
+    }
+
+    // The header goes back to the committed size of the checkpoint, which cannot fail on the limit
+    if (arena->_flags & SIA_FLAG_GOVERNED) {
+        if (commit_pos > checkpoint_commit) {
+            _sia_governor_refund(commit_pos - checkpoint_commit);
+        } else {
+            SIA_ATOMIC_ADD_U64(&_sia_governor_used, checkpoint_commit - commit_pos);
+        }
+    }
+
+    // Dropping the private pages restores the arena to the checkpoint, including this header
+    if (!_sia_memfd_remap(arena, 0, checkpoint_commit, memfd, SIA_FALSE, SIA_TRUE)) {
+        last_error.code = SIA_ERR_CHECKPOINT_FAILED;
+        last_error.msg = "Failed to remap arena for rollback";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return;
+    }
+
+    backend->in_checkpoint = SIA_FALSE;
+    backend->checkpoint_pos = 0;
+    backend->checkpoint_commit_pos = 0;
+
+    SIA_ASAN_POISON((sia_u8*)arena + arena->_pos, checkpoint_commit - arena->_pos);
+    _sia_update_fast(arena);
+}
+
+void sia_accept(sia_snapshot snapshot) {
+    si_arena* arena = snapshot.arena;
+    if (arena == NULL) {
+        return;
+    }
+
+    _sia_reserve_backend* backend = &arena->_reserve_backend;
+    if (!backend->in_checkpoint) {
+        last_error.code = SIA_ERR_CHECKPOINT_FAILED;
+        last_error.msg = "Arena does not have an active checkpoint";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return;
+    }
+
+    sia_i32 memfd = backend->memfd;
+    sia_u64 checkpoint_pos = backend->checkpoint_pos;
+    sia_u64 checkpoint_commit = backend->checkpoint_commit_pos;
+    sia_u64 write_size = SIA_MIN(backend->commit_pos, checkpoint_commit);
+
+    // Cleared before the write back, so the memfd gets a header without the checkpoint
+    backend->in_checkpoint = SIA_FALSE;
+    backend->checkpoint_pos = 0;
+    backend->checkpoint_commit_pos = 0;
+    _sia_update_fast(arena);
+
+    if (!_sia_memfd_write_back(arena, write_size, memfd, SIA_MEM_PAGESIZE())) {
+        // Some pages may have been written already, so a rollback is not exact anymore
+        backend->in_checkpoint = SIA_TRUE;
+        backend->checkpoint_pos = checkpoint_pos;
+        backend->checkpoint_commit_pos = checkpoint_commit;
+        _sia_update_fast(arena);
+
+        last_error.code = SIA_ERR_CHECKPOINT_FAILED;
+        last_error.msg = "Failed to write checkpoint changes back to memfd";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return;
+    }
+
+    // The memfd now matches the private view, so the shared mapping can replace it
+    if (!_sia_memfd_remap(arena, 0, checkpoint_commit, memfd, SIA_FALSE, SIA_TRUE)) {
+        last_error.code = SIA_ERR_CHECKPOINT_FAILED;
+        last_error.msg = "Failed to remap arena after accepting checkpoint";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return;
+    }
+
+    // Blocks decommitted during the checkpoint still have old pages in the memfd
+    if (write_size < checkpoint_commit) {
+        _sia_decommit(arena, write_size, checkpoint_commit - write_size);
+    }
+}
+
+#else // SIA_HAS_CHECKPOINTS
+
+sia_snapshot sia_checkpoint(si_arena* arena) {
+    last_error.code = SIA_ERR_CHECKPOINT_FAILED;
+    last_error.msg = "Checkpoints are only supported by the low level backend on Linux";
+    arena->_last_error = last_error;
+    arena->error_callback(last_error);
+
+    return (sia_snapshot){ 0 };
+}
+void sia_rollback(sia_snapshot snapshot) { SIA_UNUSED(snapshot); }
+void sia_accept(sia_snapshot snapshot) { SIA_UNUSED(snapshot); }
+
+#endif // SIA_HAS_CHECKPOINTS
+
+_SIA_UNTRACED void* _SIA_TRACED(sia_realloc_aligned)(si_arena* arena, void* ptr, sia_u64 old_size, sia_u64 new_size, sia_u32 align) {
+    if (arena == NULL) {
+        last_error.code = SIA_ERR_INVALID_PTR;
+        last_error.msg = "Arena is NULL";
+       // Call global callback if available
+        if (_sia_global_error_callback != NULL) {
+            _sia_global_error_callback(last_error);
+        }
+        #ifndef SIA_NO_STDIO
+        else {
+            _sia_stderr_error_callback(last_error);
+        }
+        #endif
+        return NULL;
+    }
+    
+    if (ptr == NULL) {
+        // If ptr is NULL, treat as new allocation
+        return sia_push_aligned(arena, new_size, align);
+    }
+    
+    if (new_size == 0) {
+        // If new_size is 0, treat as free (but we can't actually free in arena)
+        last_error.code = SIA_ERR_INVALID_PTR;
+        last_error.msg = "New size is 0";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return NULL;
+    }
+    
+    _sia_mapping* mapping = _sia_find_mapping(arena, ptr);
+#ifdef SIA_HAS_LARGE_OBJECTS
+    // A record from before the active checkpoint is in a copy-on-write page that sia_rollback restores,
+    // so changing it would leave the restored record pointing at a moved mapping.
+    // Those grow like the other out-of-line allocations below, with a new record
+    sia_b32 frozen = SIA_FALSE;
+#ifdef SIA_HAS_CHECKPOINTS
+    frozen = mapping != NULL && !(arena->_flags & _SIA_FLAG_BUFFER) && arena->_reserve_backend.in_checkpoint &&
+        mapping->end_pos <= arena->_reserve_backend.checkpoint_pos;
+#endif
+    if (mapping != NULL && mapping->is_large && ptr == mapping->base && !frozen) {
+        sia_u64 map_size = SIA_ALIGN_UP_POW2(new_size, SIA_MEM_PAGESIZE());
+        if (map_size <= mapping->map_size) {
+            return ptr;
+        }
+
+        if (!_sia_governor_charge_mapping(arena, map_size - mapping->map_size)) {
+            return NULL;
+        }
+
+        // Moves the pages instead of copying them where the platform can
+        void* new_ptr = _sia_large_remap(ptr, mapping->map_size, map_size);
+        if (new_ptr == NULL) {
+            new_ptr = _sia_large_map(map_size);
+            if (new_ptr == NULL) {
+                _sia_governor_refund_mapping(arena, map_size - mapping->map_size);
+                last_error.code = SIA_ERR_REALLOC_FAILED;
+                last_error.msg = "Failed to map new memory for realloc";
+                arena->_last_error = last_error;
+                arena->error_callback(last_error);
+                return NULL;
+            }
+            SIA_MEMCPY(new_ptr, ptr, SIA_MIN(old_size, mapping->map_size));
+            _sia_large_unmap(ptr, mapping->map_size);
+        }
+
+        mapping->base = new_ptr;
+        mapping->map_size = map_size;
+        return new_ptr;
+    }
+#endif
+
+    if (mapping != NULL) {
+        // Out-of-line allocations never grow in place
+        if (new_size <= old_size) {
+            return ptr;
+        }
+
+        void* new_ptr = sia_push_aligned(arena, new_size, align);
+        if (new_ptr == NULL) {
+            last_error.code = SIA_ERR_REALLOC_FAILED;
+            last_error.msg = "Failed to allocate new memory for realloc";
+            arena->_last_error = last_error;
+            arena->error_callback(last_error);
+            return NULL;
+        }
+        SIA_MEMCPY(new_ptr, ptr, old_size);
+        return new_ptr;
+    }
+    
+    if (new_size <= old_size) {
+        // Shrinking - in arena, we can't actually shrink, just return same pointer
+        // TODO: Validate the pointer is still valid before returning
+        if (!_sia_is_valid_ptr(arena, ptr, old_size)) {
+            last_error.code = SIA_ERR_INVALID_PTR;
+            last_error.msg = "Invalid pointer for realloc";
+            arena->_last_error = last_error;
+            arena->error_callback(last_error);
+            return NULL;
+        }
+        return ptr;
+    }
+    
+    // Growing allocation
+    // TODO: Validate that ptr is a valid pointer from this arena
+    if (!_sia_is_valid_ptr(arena, ptr, old_size)) {
+        last_error.code = SIA_ERR_INVALID_PTR;
+        last_error.msg = "Invalid pointer for realloc";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return NULL;
+    }
+    
+    _sia_sync(arena);
+    if (_sia_is_last_allocation(arena, ptr, old_size)) {
+        // Try to grow in-place
+        sia_u64 additional_size = new_size - old_size;
+        if (_sia_grow_last(arena, additional_size)) {
+            SIA_ASAN_UNPOISON((sia_u8*)ptr + old_size, additional_size);
+            _sia_update_fast(arena);
+            return ptr;
+        }
+    }
+    
+    // Can't grow in-place, allocate new and copy
+    void* new_ptr = sia_push_aligned(arena, new_size, align);
+    if (new_ptr == NULL) {
+        last_error.code = SIA_ERR_REALLOC_FAILED;
+        last_error.msg = "Failed to allocate new memory for realloc";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
+        return NULL;
+    }
+    
+    // Copy old_size bytes from ptr to new_ptr
+    SIA_MEMCPY(new_ptr, ptr, old_size);
+    
+    return new_ptr;
+}
+
+// sia_realloc does not know the alignment that ptr was pushed with,
+// so moved allocations keep the alignment of ptr, up to this many bytes
+#define _SIA_REALLOC_MAX_INFERRED_ALIGN 64
+
+void* sia_realloc(si_arena* arena, void* ptr, sia_u64 old_size, sia_u64 new_size) {
+    sia_u32 align = arena == NULL ? sizeof(void*) : arena->_align;
+    if (ptr != NULL) {
+        sia_u64 ptr_align = (sia_u64)ptr & (~(sia_u64)ptr + 1);
+        ptr_align = SIA_MIN(ptr_align, _SIA_REALLOC_MAX_INFERRED_ALIGN);
+        align = SIA_MAX(align, (sia_u32)ptr_align);
+    }
+
+    return sia_realloc_aligned(arena, ptr, old_size, new_size, align);
+}
+
+static void _sia_tags_init(si_arena* arena, sia_budget_callback* callback) {
+    arena->_tag_records = NULL;
+    for (sia_u32 i = 0; i < SIA_MAX_TAGS; i++) {
+        arena->_tag_bytes[i] = 0;
+        arena->_tag_budgets[i] = 0;
+    }
+    arena->_budget_callback = callback;
+}
+
+// Gives back the bytes of every tagged push past pos, newest first
+static void _sia_release_tags(si_arena* arena, sia_u64 pos) {
+    while (arena->_tag_records != NULL && arena->_tag_records->end_pos > pos) {
+        _sia_tag_record* record = arena->_tag_records;
+        arena->_tag_records = record->prev;
+
+        arena->_tag_bytes[record->tag] -= record->size;
+    }
+}
+
+static void _sia_tag_add(si_arena* arena, sia_u32 tag, sia_u64 size) {
+    sia_u64 before = arena->_tag_bytes[tag];
+    arena->_tag_bytes[tag] += size;
+
+    // Only the push that crosses the budget calls back
+    sia_u64 budget = arena->_tag_budgets[tag];
+    if (budget != 0 && before <= budget && arena->_tag_bytes[tag] > budget && arena->_budget_callback != NULL) {
+        arena->_budget_callback(arena, tag, arena->_tag_bytes[tag]);
+    }
+}
+
+static sia_b32 _sia_check_tag(si_arena* arena, sia_u32 tag) {
+    if (tag < SIA_MAX_TAGS) {
+        return SIA_TRUE;
+    }
+
+    last_error.code = SIA_ERR_INVALID_TAG;
+    last_error.msg = "Tag must be below SIA_MAX_TAGS";
+    arena->_last_error = last_error;
+    arena->error_callback(last_error);
+
+    return SIA_FALSE;
+}
+
+void* sia_push_aligned_tagged(si_arena* arena, sia_u64 size, sia_u32 align, sia_u32 tag) {
+    if (tag == SIA_TAG_NONE) {
+        return sia_push_aligned(arena, size, align);
+    }
+    if (!_sia_check_tag(arena, tag)) {
+        return NULL;
+    }
+
+    sia_u64 start_pos = arena->_pos;
+
+    // The record goes in front, so the allocation can still grow in place with sia_realloc_tagged
+    _sia_tag_record* record = SIA_PUSH_STRUCT(arena, _sia_tag_record);
+    if (record == NULL) {
+        return NULL;
+    }
+    void* out = sia_push_aligned(arena, size, align);
+    if (out == NULL) {
+        sia_pop_to(arena, start_pos);
+        return NULL;
+    }
+
+    record->prev = arena->_tag_records;
+    record->end_pos = arena->_pos;
+    record->size = size;
+    record->tag = tag;
+    arena->_tag_records = record;
+    _sia_tag_add(arena, tag, size);
+
+    // Raises the fast path floor, so pops below the allocation take the slow path
+    _sia_sync(arena);
+    _sia_update_fast(arena);
+
+    return out;
+}
+void* sia_push_tagged(si_arena* arena, sia_u64 size, sia_u32 tag) {
+    return sia_push_aligned_tagged(arena, size, arena->_align, tag);
+}
+void* sia_push_zero_tagged(si_arena* arena, sia_u64 size, sia_u32 tag) {
+    void* out = sia_push_aligned_tagged(arena, size, arena->_align, tag);
+    if (out != NULL) {
+        SIA_MEMSET(out, 0, size);
+    }
+    return out;
+}
+
+void* sia_realloc_tagged(si_arena* arena, void* ptr, sia_u64 old_size, sia_u64 new_size, sia_u32 tag) {
+    if (tag == SIA_TAG_NONE || ptr == NULL || new_size <= old_size) {
+        return ptr == NULL ? sia_push_tagged(arena, new_size, tag) : sia_realloc(arena, ptr, old_size, new_size);
+    }
+    if (!_sia_check_tag(arena, tag)) {
+        return NULL;
+    }
+
+    // Grows in place when ptr is the last tagged push of the same tag, and nothing came after it
+    _sia_sync(arena);
+    _sia_tag_record* record = arena->_tag_records;
+    sia_u64 additional_size = new_size - old_size;
+    if (record != NULL && record->tag == tag && record->end_pos == arena->_pos &&
+        _sia_is_last_allocation(arena, ptr, old_size) && _sia_grow_last(arena, additional_size)) {
+        SIA_ASAN_UNPOISON((sia_u8*)ptr + old_size, additional_size);
+        record->end_pos = arena->_pos;
+        record->size += additional_size;
+        _sia_tag_add(arena, tag, additional_size);
+        _sia_update_fast(arena);
+        return ptr;
+    }
+
+    // Same alignment rule as sia_realloc
+    sia_u64 ptr_align = (sia_u64)ptr & (~(sia_u64)ptr + 1);
+    ptr_align = SIA_MIN(ptr_align, _SIA_REALLOC_MAX_INFERRED_ALIGN);
+    sia_u32 align = SIA_MAX(arena->_align, (sia_u32)ptr_align);
+
+    void* out = sia_push_aligned_tagged(arena, new_size, align, tag);
+    if (out == NULL) {
+        return NULL;
+    }
+    SIA_MEMCPY(out, ptr, old_size);
+
+    return out;
+}
+
+sia_u64 sia_get_tag_bytes(si_arena* arena, sia_u32 tag) {
+    return tag < SIA_MAX_TAGS ? arena->_tag_bytes[tag] : 0;
+}
+void sia_set_tag_budget(si_arena* arena, sia_u32 tag, sia_u64 budget) {
+    if (_sia_check_tag(arena, tag)) {
+        arena->_tag_budgets[tag] = budget;
+    }
+}
+
+// Chunks of the bitmap layout are aligned to their size,
+// so the chunk of a block is found by aligning the block down
+typedef struct _sia_pool_chunk {
+    struct _sia_pool_chunk* next;
+    sia_u32 index;
+    sia_u32 num_free;
+    // A set bit is a free block
+    sia_u64 bits[];
+} _sia_pool_chunk;
+
+static void _sia_pool_chunk_init(sia_pool* pool) {
+    sia_u64 stride = SIA_ALIGN_UP_POW2(pool->block_size, pool->align);
+    sia_u64 chunk_size = SIA_MEM_PAGESIZE();
+
+    // Chunks hold at least 8 blocks, so large blocks get larger chunks
+    for (;;) {
+        sia_u64 max_blocks = chunk_size / stride;
+        sia_u64 header = SIA_ALIGN_UP_POW2(sizeof(_sia_pool_chunk) + SIA_ALIGN_UP_POW2(max_blocks, 64) / 8, pool->align);
+        sia_u64 num_blocks = chunk_size > header ? (chunk_size - header) / stride : 0;
+
+        if (num_blocks >= 8) {
+            pool->_chunk_size = (sia_u32)chunk_size;
+            pool->_chunk_header = (sia_u32)header;
+            pool->_chunk_blocks = (sia_u32)num_blocks;
+            return;
+        }
+
+        chunk_size *= 2;
+    }
+}
+
+// Index of the first non-zero word
+static sia_u32 _sia_bitmap_find(const sia_u64* bits, sia_u32 num_words) {
+    sia_u32 i = 0;
+
+#ifdef SIA_SSE2
+    __m128i zero = _mm_setzero_si128();
+    for (; i + 2 <= num_words; i += 2) {
+        __m128i words = _mm_loadu_si128((const __m128i*)(bits + i));
+        int zero_bytes = _mm_movemask_epi8(_mm_cmpeq_epi8(words, zero));
+        if (zero_bytes != 0xFFFF) {
+            return i + ((zero_bytes & 0xFF) == 0xFF ? 1 : 0);
+        }
+    }
+#endif
+
+    for (; i < num_words; i++) {
+        if (bits[i] != 0) {
+            break;
+        }
+    }
+
+    return i;
+}
+
+static sia_b32 _sia_pool_bitmap_grow(sia_pool* pool, sia_u64 num_blocks) {
+    sia_u64 num_chunks = (num_blocks + pool->_chunk_blocks - 1) / pool->_chunk_blocks;
+    sia_u8* memory = (sia_u8*)sia_push_aligned_tagged(pool->arena, (sia_u64)pool->_chunk_size * num_chunks, pool->_chunk_size, pool->tag);
+    if (memory == NULL) {
+        return SIA_FALSE;
+    }
+
+    sia_u32 num_words = (pool->_chunk_blocks + 63) / 64;
+    for (sia_u64 i = 0; i < num_chunks; i++) {
+        _sia_pool_chunk* chunk = (_sia_pool_chunk*)(memory + i * pool->_chunk_size);
+        chunk->next = NULL;
+        chunk->index = pool->_last_chunk == NULL ? 0 : pool->_last_chunk->index + 1;
+        chunk->num_free = pool->_chunk_blocks;
+
+        for (sia_u32 j = 0; j < num_words; j++) {
+            sia_u32 bits_left = pool->_chunk_blocks - j * 64;
+            chunk->bits[j] = bits_left >= 64 ? UINT64_MAX : (((sia_u64)1 << bits_left) - 1);
+        }
+
+        if (pool->_last_chunk == NULL) {
+            pool->_chunks = chunk;
+        } else {
+            pool->_last_chunk->next = chunk;
+        }
+        pool->_last_chunk = chunk;
+
+        if (pool->_hint == NULL) {
+            pool->_hint = chunk;
+        }
+    }
+
+    pool->block_memory = memory;
+    pool->total_blocks += num_chunks * pool->_chunk_blocks;
+    pool->free_blocks += num_chunks * pool->_chunk_blocks;
+
+    return SIA_TRUE;
+}
+
+// Takes up to num of the lowest free blocks, starting at the hint
+static sia_u64 _sia_pool_bitmap_take(sia_pool* pool, void** ptrs, sia_u64 num) {
+    sia_u64 stride = SIA_ALIGN_UP_POW2(pool->block_size, pool->align);
+    sia_u32 num_words = (pool->_chunk_blocks + 63) / 64;
+    sia_u64 taken = 0;
+
+    _sia_pool_chunk* chunk = pool->_hint;
+    while (chunk != NULL && taken < num) {
+        if (chunk->num_free == 0) {
+            chunk = chunk->next;
+            continue;
+        }
+
+        sia_u8* blocks = (sia_u8*)chunk + pool->_chunk_header;
+        sia_u32 word = _sia_bitmap_find(chunk->bits, num_words);
+
+        for (; word < num_words && taken < num; word++) {
+            sia_u64 bits = chunk->bits[word];
+            while (bits != 0 && taken < num) {
+                ptrs[taken++] = blocks + ((sia_u64)word * 64 + _sia_ctz64(bits)) * stride;
+                chunk->num_free--;
+                bits &= bits - 1;
+            }
+            chunk->bits[word] = bits;
+        }
+
+        if (taken < num) {
+            chunk = chunk->next;
+        }
+    }
+
+    pool->_hint = chunk;
+    pool->free_blocks -= taken;
+
+    return taken;
+}
+
+static sia_b32 _sia_pool_bitmap_free(sia_pool* pool, void* ptr) {
+    _sia_pool_chunk* chunk = (_sia_pool_chunk*)SIA_ALIGN_DOWN_POW2(ptr, pool->_chunk_size);
+    sia_u64 stride = SIA_ALIGN_UP_POW2(pool->block_size, pool->align);
+    sia_u64 offset = (sia_u64)ptr - (sia_u64)chunk;
+
+    if (offset < pool->_chunk_header || (offset - pool->_chunk_header) % stride != 0) {
+        return SIA_FALSE;
+    }
+
+    sia_u64 index = (offset - pool->_chunk_header) / stride;
+    sia_u64 bit = (sia_u64)1 << (index % 64);
+    if (index >= pool->_chunk_blocks || (chunk->bits[index / 64] & bit) != 0) {
+        return SIA_FALSE;
+    }
+
+    chunk->bits[index / 64] |= bit;
+    chunk->num_free++;
+    pool->free_blocks++;
+
+    if (pool->_hint == NULL || chunk->index < pool->_hint->index) {
+        pool->_hint = chunk;
+    }
+
+    return SIA_TRUE;
+}
+
+// Moves the slot map to a new allocation of the arena that fits capacity items.
+// Capacity doubles, so the old allocations never add up to more than the current one
+static sia_b32 _sia_slot_map_grow(sia_slot_map* map, sia_u32 capacity) {
+    sia_u64 items_size = SIA_ALIGN_UP_POW2(map->item_size * capacity, sizeof(_sia_slot));
+    sia_u64 size = items_size + (sizeof(_sia_slot) + sizeof(sia_u32)) * (sia_u64)capacity;
+
+    sia_u8* memory = (sia_u8*)sia_push_aligned(map->arena, size, map->align);
+    if (memory == NULL) {
+        return SIA_FALSE;
+    }
+
+    _sia_slot* slots = (_sia_slot*)(memory + items_size);
+    sia_u32* item_slots = (sia_u32*)(slots + capacity);
+
+    if (map->items != NULL) {
+        SIA_MEMCPY(memory, map->items, map->item_size * map->count);
+        SIA_MEMCPY(slots, map->_slots, sizeof(_sia_slot) * map->_num_slots);
+        SIA_MEMCPY(item_slots, map->_item_slots, sizeof(sia_u32) * map->count);
+    } else {
+        map->_free_slot = UINT32_MAX;
+    }
+
+    map->items = memory;
+    map->_slots = slots;
+    map->_item_slots = item_slots;
+    map->capacity = capacity;
+
+    return SIA_TRUE;
+}
+
+// A block starts 8 bytes before its size. prev_phys is only valid when the previous block is free,
+// so it lives at the end of that block, and used blocks only cost the size
+typedef struct _sia_tlsf_block {
+    struct _sia_tlsf_block* prev_phys;
+    sia_u64 size;
+
+    // Only valid while the block is free
+    struct _sia_tlsf_block* next_free;
+    struct _sia_tlsf_block* prev_free;
+} _sia_tlsf_block;
+
+#define _SIA_TLSF_FREE ((sia_u64)1)
+#define _SIA_TLSF_PREV_FREE ((sia_u64)2)
+#define _SIA_TLSF_FLAGS (_SIA_TLSF_FREE | _SIA_TLSF_PREV_FREE)
+#define _SIA_TLSF_OVERHEAD sizeof(sia_u64)
+#define _SIA_TLSF_MIN_SIZE (sizeof(_sia_tlsf_block) - sizeof(_sia_tlsf_block*))
+
+#define _SIA_TLSF_SIZE(block) ((block)->size & ~_SIA_TLSF_FLAGS)
+#define _SIA_TLSF_PTR(block) ((void*)((sia_u8*)(block) + 2 * sizeof(sia_u64)))
+#define _SIA_TLSF_BLOCK(ptr) ((_sia_tlsf_block*)((sia_u8*)(ptr) - 2 * sizeof(sia_u64)))
+
+static _sia_tlsf_block* _sia_tlsf_next(_sia_tlsf_block* block) {
+    return (_sia_tlsf_block*)((sia_u8*)block + _SIA_TLSF_OVERHEAD + _SIA_TLSF_SIZE(block));
+}
+
+// Returns 0 for sizes that are too large
+static sia_u64 _sia_tlsf_adjust_size(sia_u64 size) {
+    sia_u64 out = SIA_MAX(SIA_ALIGN_UP_POW2(size, _SIA_TLSF_OVERHEAD), _SIA_TLSF_MIN_SIZE);
+    return out < ((sia_u64)1 << _SIA_TLSF_FL_MAX) ? out : 0;
+}
+
+static sia_u64 _sia_tlsf_round_size(sia_u64 size) {
+    if (size >= ((sia_u64)1 << _SIA_TLSF_FL_SHIFT)) {
+        size += ((sia_u64)1 << (_sia_fls64(size) - _SIA_TLSF_SL_LOG2)) - 1;
+    }
+    return size;
+}
+
+static void _sia_tlsf_mapping(sia_u64 size, sia_u32* fl, sia_u32* sl) {
+    if (size < ((sia_u64)1 << _SIA_TLSF_FL_SHIFT)) {
+        *fl = 0;
+        *sl = (sia_u32)(size / (((sia_u64)1 << _SIA_TLSF_FL_SHIFT) / _SIA_TLSF_SL_COUNT));
+    } else {
+        sia_u32 top = _sia_fls64(size);
+        *sl = (sia_u32)(size >> (top - _SIA_TLSF_SL_LOG2)) ^ _SIA_TLSF_SL_COUNT;
+        *fl = top - (_SIA_TLSF_FL_SHIFT - 1);
+    }
+}
+
+// Finds a free list at or above fl and sl that is not empty, with one bit scan per level
+static _sia_tlsf_block* _sia_tlsf_find(sia_tlsf* tlsf, sia_u32* fl, sia_u32* sl) {
+    if (*fl >= _SIA_TLSF_FL_COUNT) {
+        return NULL;
+    }
+
+    sia_u32 sl_map = tlsf->_sl_bitmaps[*fl] & (~(sia_u32)0 << *sl);
+    if (sl_map == 0) {
+        sia_u32 fl_map = *fl + 1 < 32 ? tlsf->_fl_bitmap & (~(sia_u32)0 << (*fl + 1)) : 0;
+        if (fl_map == 0) {
+            return NULL;
+        }
+
+        *fl = _sia_ctz64(fl_map);
+        sl_map = tlsf->_sl_bitmaps[*fl];
+    }
+
+    *sl = _sia_ctz64(sl_map);
+    return tlsf->_free_lists[*fl][*sl];
+}
+
+static void _sia_tlsf_remove(sia_tlsf* tlsf, _sia_tlsf_block* block, sia_u32 fl, sia_u32 sl) {
+    if (block->prev_free != NULL) {
+        block->prev_free->next_free = block->next_free;
+    } else {
+        tlsf->_free_lists[fl][sl] = block->next_free;
+        if (block->next_free == NULL) {
+            tlsf->_sl_bitmaps[fl] &= ~((sia_u32)1 << sl);
+            if (tlsf->_sl_bitmaps[fl] == 0) {
+                tlsf->_fl_bitmap &= ~((sia_u32)1 << fl);
+            }
+        }
+    }
+    if (block->next_free != NULL) {
+        block->next_free->prev_free = block->prev_free;
+    }
+}
+
+static void _sia_tlsf_remove_block(sia_tlsf* tlsf, _sia_tlsf_block* block) {
+    sia_u32 fl, sl;
+    _sia_tlsf_mapping(_SIA_TLSF_SIZE(block), &fl, &sl);
+    _sia_tlsf_remove(tlsf, block, fl, sl);
+}
+
+// Block has to be marked free already
+static void _sia_tlsf_insert(sia_tlsf* tlsf, _sia_tlsf_block* block) {
+    sia_u32 fl, sl;
+    _sia_tlsf_mapping(_SIA_TLSF_SIZE(block), &fl, &sl);
+
+    _sia_tlsf_block* head = tlsf->_free_lists[fl][sl];
+    block->next_free = head;
+    block->prev_free = NULL;
+    if (head != NULL) {
+        head->prev_free = block;
+    }
+
+    tlsf->_free_lists[fl][sl] = block;
+    tlsf->_fl_bitmap |= (sia_u32)1 << fl;
+    tlsf->_sl_bitmaps[fl] |= (sia_u32)1 << sl;
+}
+
+// Merges a free block that is not in the free lists with its free neighbours
+static _sia_tlsf_block* _sia_tlsf_merge(sia_tlsf* tlsf, _sia_tlsf_block* block) {
+    if (block->size & _SIA_TLSF_PREV_FREE) {
+        _sia_tlsf_block* prev = block->prev_phys;
+        _sia_tlsf_remove_block(tlsf, prev);
+        prev->size += _SIA_TLSF_SIZE(block) + _SIA_TLSF_OVERHEAD;
+        block = prev;
+    }
+
+    // The last block of every region is a used block of size 0, so this never runs off the end
+    _sia_tlsf_block* next = _sia_tlsf_next(block);
+    if (next->size & _SIA_TLSF_FREE) {
+        _sia_tlsf_remove_block(tlsf, next);
+        block->size += _SIA_TLSF_SIZE(next) + _SIA_TLSF_OVERHEAD;
+        next = _sia_tlsf_next(block);
+    }
+
+    next->prev_phys = block;
+    next->size |= _SIA_TLSF_PREV_FREE;
+
+    return block;
+}
+
+// Pushes at least size bytes of blocks on the arena.
+// If the push lands right after the last one, the old end block becomes the new free block
+static sia_b32 _sia_tlsf_grow(sia_tlsf* tlsf, sia_u64 size) {
+    sia_u64 push_size = SIA_ALIGN_UP_POW2(SIA_MAX(size + 2 * _SIA_TLSF_OVERHEAD, tlsf->grow_size), _SIA_TLSF_OVERHEAD);
+    sia_u8* memory = (sia_u8*)sia_push_aligned(tlsf->arena, push_size, _SIA_TLSF_OVERHEAD);
+    if (memory == NULL) {
+        return SIA_FALSE;
+    }
+
+    _sia_tlsf_block* block;
+    if (memory == tlsf->_region_end) {
+        block = (_sia_tlsf_block*)(memory - 2 * _SIA_TLSF_OVERHEAD);
+        block->size = (push_size - _SIA_TLSF_OVERHEAD) | (block->size & _SIA_TLSF_PREV_FREE) | _SIA_TLSF_FREE;
+    } else {
+        block = (_sia_tlsf_block*)(memory - _SIA_TLSF_OVERHEAD);
+        block->size = (push_size - 2 * _SIA_TLSF_OVERHEAD) | _SIA_TLSF_FREE;
+    }
+
+    _sia_tlsf_block* end = _sia_tlsf_next(block);
+    end->size = 0;
+    tlsf->_region_end = memory + push_size;
+
+    block = _sia_tlsf_merge(tlsf, block);
+    _sia_tlsf_insert(tlsf, block);
+
+    return SIA_TRUE;
+}
+
+_SIA_UNTRACED sia_pool* _SIA_TRACED(sia_pool_create)(const sia_pool_desc* desc) {
+    if (desc == NULL) {
+        last_error.code = SIA_ERR_INVALID_PTR;
+        last_error.msg = "Pool description is NULL";
+        if (_sia_global_error_callback != NULL) {
+            _sia_global_error_callback(last_error);
+        }
+#ifndef SIA_NO_STDIO
+        else {
+            _sia_stderr_error_callback(last_error);
+        }
+#endif
+        return NULL;
+    }
+    if (desc->arena == NULL){
+        last_error.code= SIA_ERR_INVALID_PTR;
+        last_error.msg = "Arena is NULL";
+        if (_sia_global_error_callback != NULL) {
+            _sia_global_error_callback(last_error);
+        }
+#ifndef SIA_NO_STDIO
+        else {
+            _sia_stderr_error_callback(last_error);
+        }
+#endif
+        return NULL;
+    }
+    
+    sia_u64 block_size = desc->block_size;
+    if (block_size <sizeof(void*)){
+        block_size = sizeof(void*);
+    }
+    // Calculate alignment (default to block_size or pointer size)
+    sia_u32 align = desc->align;
+    if (align == 0) {
+        align = _sia_round_pow2((sia_u32)block_size);
+    }
+    if (align < sizeof(void*)) {
+        align = sizeof(void*);
+    }
+
+    // Aligned even in arenas with a smaller alignment, for the atomic counters and the registry bits
+    sia_u64 start_pos = sia_get_pos(desc->arena);
+    sia_pool* pool = (sia_pool*)sia_push_aligned_tagged(desc->arena, sizeof(sia_pool), sizeof(sia_u64), desc->tag);
+    if (pool == NULL){
+        return NULL;
+    }
+    SIA_MEMSET(pool, 0, sizeof(sia_pool));
+    pool->arena = desc->arena;
+    pool->tag = desc->tag;
+    pool->block_size = block_size;
+    pool->align = align;
+    pool->free_list = NULL;
+    pool->total_blocks = 0;
+    pool->free_blocks = 0;
+    pool->block_memory = NULL;
+    pool->name = desc->name;
+    pool->flags = desc->flags & SIA_FLAG_BITMAP;
+
+    if (pool->flags & SIA_FLAG_BITMAP) {
+        _sia_pool_chunk_init(pool);
+    }
+
+    pool->_registry_slot = _sia_registry_add(pool, SIA_TRUE);
+
+#ifdef SIA_ENABLE_REGISTRY
+    // The pool leaves the registry when the arena pops it
+    if (pool->_registry_slot != _SIA_REGISTRY_NO_SLOT &&
+        !sia_add_cleanup(desc->arena, pool, _sia_registry_pool_cleanup)) {
+        _sia_registry_remove(pool->_registry_slot);
+        sia_pop_to(desc->arena, start_pos);
+        return NULL;
+    }
+#endif
+
+    if (desc->initial_capacity>0){
+        sia_b32 grow_success = sia_pool_grow(pool, desc->initial_capacity);
+        if (!grow_success){
+            // Popping runs the cleanup that takes the pool out of the registry
+            sia_pop_to(desc->arena, start_pos);
+            last_error.code = SIA_ERR_POOL_FULL;
+            last_error.msg = "Failed to allocate initial capacity for pool";
+            if (_sia_global_error_callback != NULL) {
+                _sia_global_error_callback(last_error);
+            }
+#ifndef SIA_NO_STDIO
+            else {
+                _sia_stderr_error_callback(last_error);
+            }
+#endif
+            return NULL;
+        }
+    }
+
+    return pool;
+}
+
+_SIA_UNTRACED void _SIA_TRACED(sia_pool_destroy)(sia_pool* pool) {
+    _sia_registry_remove(pool->_registry_slot);
+    pool->_registry_slot = _SIA_REGISTRY_NO_SLOT;
+
+    // The pool memory belongs to the arena, it gets freed when the arena pops it
+    pool->free_list = NULL;
+    pool->total_blocks = 0;
+    pool->free_blocks = 0;
+    pool->block_memory = NULL;
+    pool->_chunks = NULL;
+    pool->_last_chunk = NULL;
+    pool->_hint = NULL;
+}
+
+_SIA_UNTRACED sia_b32 _SIA_TRACED(sia_pool_grow)(sia_pool* pool, sia_u64 num_blocks) {
+    if (num_blocks == 0) {
+        return SIA_TRUE;
+    }
+    if (pool->flags & SIA_FLAG_BITMAP) {
+        return _sia_pool_bitmap_grow(pool, num_blocks);
+    }
+
+    sia_u64 stride = SIA_ALIGN_UP_POW2(pool->block_size, pool->align);
+    sia_u8* memory = (sia_u8*)sia_push_aligned_tagged(pool->arena, stride * num_blocks, pool->align, pool->tag);
+    if (memory == NULL) {
+        return SIA_FALSE;
+    }
+
+    // Thread the new blocks onto the free list so that they get used in address order
+    for (sia_u64 i = num_blocks; i > 0; i--) {
+        _sia_pool_block* block = (_sia_pool_block*)(memory + (i - 1) * stride);
+        block->next = pool->free_list;
+        pool->free_list = block;
+    }
+
+    pool->block_memory = memory;
+    pool->total_blocks += num_blocks;
+    pool->free_blocks += num_blocks;
+
+    return SIA_TRUE;
+}
+
+_SIA_UNTRACED void* _SIA_TRACED(sia_pool_alloc)(sia_pool* pool) {
+    if (pool->free_blocks == 0) {
+        sia_u64 num_blocks = SIA_MAX(pool->total_blocks, 8);
+        if (!sia_pool_grow(pool, num_blocks)) {
+            last_error.code = SIA_ERR_POOL_FULL;
+            last_error.msg = "Pool has no free blocks and failed to grow";
+            pool->arena->_last_error = last_error;
+            pool->arena->error_callback(last_error);
+            return NULL;
+        }
+    }
+
+    if (pool->flags & SIA_FLAG_BITMAP) {
+        void* out = NULL;
+        _sia_pool_bitmap_take(pool, &out, 1);
+        return out;
+    }
+
+    _sia_pool_block* block = pool->free_list;
+    pool->free_list = block->next;
+    pool->free_blocks--;
+
+    return (void*)block;
+}
+
+void* sia_pool_alloc_zero(sia_pool* pool) {
+    void* out = sia_pool_alloc(pool);
+    if (out != NULL) {
+        SIA_MEMSET(out, 0, pool->block_size);
+    }
+
+    return out;
+}
+
+_SIA_UNTRACED void _SIA_TRACED(sia_pool_free)(sia_pool* pool, void* ptr) {
+    if (ptr == NULL || ((sia_u64)ptr & (pool->align - 1)) != 0 ||
+        ((pool->flags & SIA_FLAG_BITMAP) && !_sia_pool_bitmap_free(pool, ptr))) {
+        last_error.code = SIA_ERR_INVALID_POOL_PTR;
+        last_error.msg = "Attempted to free invalid pointer to pool";
+        pool->arena->_last_error = last_error;
+        pool->arena->error_callback(last_error);
+        return;
+    }
+    if (pool->flags & SIA_FLAG_BITMAP) {
+        return;
+    }
+
+    _sia_pool_block* block = (_sia_pool_block*)ptr;
+    block->next = pool->free_list;
+    pool->free_list = block;
+    pool->free_blocks++;
+}
+
+_SIA_UNTRACED sia_b32 _SIA_TRACED(sia_pool_alloc_n)(sia_pool* pool, void** ptrs, sia_u64 num) {
+    // Grows once for the whole batch, so that it either gets every block or none
+    if (pool->free_blocks < num) {
+        sia_u64 num_blocks = SIA_MAX(SIA_MAX(pool->total_blocks, 8), num - pool->free_blocks);
+        if (!sia_pool_grow(pool, num_blocks)) {
+            last_error.code = SIA_ERR_POOL_FULL;
+            last_error.msg = "Pool has no free blocks and failed to grow";
+            pool->arena->_last_error = last_error;
+            pool->arena->error_callback(last_error);
+            return SIA_FALSE;
+        }
+    }
+
+    if (pool->flags & SIA_FLAG_BITMAP) {
+        _sia_pool_bitmap_take(pool, ptrs, num);
+        return SIA_TRUE;
+    }
+
+    for (sia_u64 i = 0; i < num; i++) {
+        _sia_pool_block* block = pool->free_list;
+        pool->free_list = block->next;
+        ptrs[i] = (void*)block;
+    }
+    pool->free_blocks -= num;
+
+    return SIA_TRUE;
+}
+
+_SIA_UNTRACED void _SIA_TRACED(sia_pool_free_n)(sia_pool* pool, void** ptrs, sia_u64 num) {
+    for (sia_u64 i = 0; i < num; i++) {
+        sia_pool_free(pool, ptrs[i]);
+    }
+}
+
+sia_slot_map* sia_slot_map_create(const sia_slot_map_desc* desc) {
+    if (desc == NULL || desc->arena == NULL) {
+        last_error.code = SIA_ERR_INVALID_PTR;
+        last_error.msg = desc == NULL ? "Slot map description is NULL" : "Arena is NULL";
+        if (_sia_global_error_callback != NULL) {
+            _sia_global_error_callback(last_error);
+        }
+#ifndef SIA_NO_STDIO
+        else {
+            _sia_stderr_error_callback(last_error);
+        }
+#endif
+        return NULL;
+    }
+
+    sia_u64 start_pos = sia_get_pos(desc->arena);
+    sia_slot_map* map = SIA_PUSH_ZERO_STRUCT(desc->arena, sia_slot_map);
+    if (map == NULL) {
+        return NULL;
+    }
+
+    map->arena = desc->arena;
+    map->item_size = SIA_MAX(desc->item_size, 1);
+    map->align = desc->align == 0 ? desc->arena->_align : desc->align;
+
+    if (desc->initial_capacity > 0 && !_sia_slot_map_grow(map, desc->initial_capacity)) {
+        sia_pop_to(desc->arena, start_pos);
+        return NULL;
+    }
+
+    return map;
+}
+
+void* sia_slot_map_alloc(sia_slot_map* map, sia_handle* handle) {
+    if (map->count == map->capacity && !_sia_slot_map_grow(map, SIA_MAX(map->capacity * 2, 16))) {
+        last_error.code = SIA_ERR_POOL_FULL;
+        last_error.msg = "Slot map is full and failed to grow";
+        map->arena->_last_error = last_error;
+        map->arena->error_callback(last_error);
+        return NULL;
+    }
+
+    // There are never more slots than items, so a full slot map has no free slots
+    sia_u32 slot_index = map->_free_slot;
+    if (slot_index == UINT32_MAX) {
+        slot_index = map->_num_slots++;
+        map->_slots[slot_index].gen = 0;
+    } else {
+        map->_free_slot = map->_slots[slot_index].target;
+    }
+
+    _sia_slot* slot = &map->_slots[slot_index];
+    slot->gen++;
+    slot->target = map->count;
+    map->_item_slots[map->count] = slot_index;
+
+    handle->index = slot_index;
+    handle->gen = slot->gen;
+
+    return (sia_u8*)map->items + map->item_size * map->count++;
+}
+
+void* sia_slot_map_get(sia_slot_map* map, sia_handle handle) {
+    if (handle.index >= map->_num_slots || map->_slots[handle.index].gen != handle.gen || (handle.gen & 1) == 0) {
+        return NULL;
+    }
+
+    return (sia_u8*)map->items + map->item_size * map->_slots[handle.index].target;
+}
+
+sia_b32 sia_slot_map_free(sia_slot_map* map, sia_handle handle) {
+    if (sia_slot_map_get(map, handle) == NULL) {
+        last_error.code = SIA_ERR_INVALID_HANDLE;
+        last_error.msg = "Attempted to free a stale or invalid handle";
+        map->arena->_last_error = last_error;
+        map->arena->error_callback(last_error);
+        return SIA_FALSE;
+    }
+
+    _sia_slot* slot = &map->_slots[handle.index];
+    sia_u32 removed = slot->target;
+    sia_u32 last = --map->count;
+
+    // The last item moves into the hole, so the items stay packed
+    if (removed != last) {
+        sia_u8* items = (sia_u8*)map->items;
+        SIA_MEMCPY(items + map->item_size * removed, items + map->item_size * last, map->item_size);
+
+        sia_u32 moved_slot = map->_item_slots[last];
+        map->_item_slots[removed] = moved_slot;
+        map->_slots[moved_slot].target = removed;
+    }
+
+    // The generation becomes even, so every handle to the slot is stale
+    slot->gen++;
+    slot->target = map->_free_slot;
+    map->_free_slot = handle.index;
+
+    return SIA_TRUE;
+}
+
+sia_handle sia_slot_map_get_handle(sia_slot_map* map, sia_u32 item_index) {
+    sia_handle out = { 0 };
+    if (item_index < map->count) {
+        out.index = map->_item_slots[item_index];
+        out.gen = map->_slots[out.index].gen;
+    }
+
+    return out;
+}
+
+sia_tlsf* sia_tlsf_create(const sia_tlsf_desc* desc) {
+    if (desc == NULL) {
+        last_error.code = SIA_ERR_INVALID_PTR;
+        last_error.msg = "TLSF description is NULL";
+        if (_sia_global_error_callback != NULL) {
+            _sia_global_error_callback(last_error);
+        }
+#ifndef SIA_NO_STDIO
+        else {
+            _sia_stderr_error_callback(last_error);
+        }
+#endif
+        return NULL;
+    }
+
+    si_arena* arena = sia_create(&desc->arena_desc);
+    if (arena == NULL) {
+        return NULL;
+    }
+
+    sia_tlsf* tlsf = SIA_PUSH_ZERO_STRUCT(arena, sia_tlsf);
+    if (tlsf == NULL) {
+        sia_destroy(arena);
+        return NULL;
+    }
+
+    tlsf->arena = arena;
+    tlsf->grow_size = desc->grow_size == 0 ? arena->_block_size : desc->grow_size;
+
+    if (desc->initial_size > 0 && !_sia_tlsf_grow(tlsf, desc->initial_size)) {
+        sia_destroy(arena);
+        return NULL;
+    }
+
+    return tlsf;
+}
+
+void sia_tlsf_destroy(sia_tlsf* tlsf) {
+    if (tlsf != NULL) {
+        sia_destroy(tlsf->arena);
+    }
+}
+
+void* sia_tlsf_alloc(sia_tlsf* tlsf, sia_u64 size) {
+    sia_u64 adjusted = _sia_tlsf_adjust_size(size);
+    if (adjusted == 0) {
+        last_error.code = SIA_ERR_OUT_OF_MEMORY;
+        last_error.msg = "TLSF allocation is too large";
+        tlsf->arena->_last_error = last_error;
+        tlsf->arena->error_callback(last_error);
+        return NULL;
+    }
+
+    // Searching with the size rounded up to the next range means that
+    // any block in the range found is large enough, so there is no list to walk
+    sia_u64 rounded = _sia_tlsf_round_size(adjusted);
+    sia_u32 fl, sl;
+    _sia_tlsf_mapping(rounded, &fl, &sl);
+
+    _sia_tlsf_block* block = _sia_tlsf_find(tlsf, &fl, &sl);
+    if (block == NULL) {
+        if (!_sia_tlsf_grow(tlsf, rounded)) {
+            return NULL;
+        }
+
+        _sia_tlsf_mapping(rounded, &fl, &sl);
+        block = _sia_tlsf_find(tlsf, &fl, &sl);
+    }
+
+    _sia_tlsf_remove(tlsf, block, fl, sl);
+
+    // Anything that is large enough to be a block goes back in the free lists
+    if (_SIA_TLSF_SIZE(block) >= adjusted + sizeof(_sia_tlsf_block)) {
+        _sia_tlsf_block* rest = (_sia_tlsf_block*)((sia_u8*)block + _SIA_TLSF_OVERHEAD + adjusted);
+        rest->size = (_SIA_TLSF_SIZE(block) - adjusted - _SIA_TLSF_OVERHEAD) | _SIA_TLSF_FREE;
+        block->size = adjusted | (block->size & _SIA_TLSF_FLAGS);
+
+        _sia_tlsf_next(rest)->prev_phys = rest;
+        _sia_tlsf_insert(tlsf, rest);
+    } else {
+        _sia_tlsf_next(block)->size &= ~(sia_u64)_SIA_TLSF_PREV_FREE;
+    }
+
+    block->size &= ~(sia_u64)_SIA_TLSF_FREE;
+
+    return _SIA_TLSF_PTR(block);
+}
+
+void sia_tlsf_free(sia_tlsf* tlsf, void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+
+    _sia_tlsf_block* block = _SIA_TLSF_BLOCK(ptr);
+    if (((sia_u64)ptr & (_SIA_TLSF_OVERHEAD - 1)) != 0 || (block->size & _SIA_TLSF_FREE)) {
+        last_error.code = SIA_ERR_INVALID_PTR;
+        last_error.msg = "Attempted to free invalid pointer to TLSF";
+        tlsf->arena->_last_error = last_error;
+        tlsf->arena->error_callback(last_error);
+        return;
+    }
+
+    block->size |= _SIA_TLSF_FREE;
+    block = _sia_tlsf_merge(tlsf, block);
+    _sia_tlsf_insert(tlsf, block);
+}
+
+sia_u64 sia_tlsf_get_size(void* ptr) {
+    return _SIA_TLSF_SIZE(_SIA_TLSF_BLOCK(ptr));
+}
+
+sia_u64 sia_pool_get_block_size(sia_pool* pool) { return pool->block_size; }
+sia_u64 sia_pool_get_capacity(sia_pool* pool) { return pool->total_blocks; }
+sia_u64 sia_pool_get_used(sia_pool* pool) { return pool->total_blocks - pool->free_blocks; }
+sia_u64 sia_pool_get_free(sia_pool* pool) { return pool->free_blocks; }
+
+#ifdef SIA_HAS_RINGS
+
+sia_ring* sia_ring_create(const sia_ring_desc* desc) {
+    sia_u32 page_size = SIA_MEM_PAGESIZE();
+    sia_u64 size = desc == NULL ? 0 : SIA_MAX(desc->size, page_size);
+    sia_u32 align = desc == NULL || desc->align == 0 ? 1 : desc->align;
+
+    if (desc == NULL || (align & (align - 1)) != 0 || align > page_size) {
+        last_error.code = desc == NULL ? SIA_ERR_INVALID_PTR : SIA_ERR_INVALID_ALIGN;
+        last_error.msg = desc == NULL ? "Ring description is NULL" : "Ring align must be a power of 2 no larger than the page size";
+        if (_sia_global_error_callback != NULL) {
+            _sia_global_error_callback(last_error);
+        }
+#ifndef SIA_NO_STDIO
+        else {
+            _sia_stderr_error_callback(last_error);
+        }
+#endif
+        return NULL;
+    }
+
+    // Positions wrap with a mask instead of a division
+    sia_u64 rounded = page_size;
+    while (rounded < size) {
+        rounded <<= 1;
+    }
+    size = rounded;
+
+    sia_u64 header_size = SIA_ALIGN_UP_POW2(sizeof(sia_ring), page_size);
+    sia_i32 fd = -1;
+    sia_ring* ring = (sia_ring*)_sia_ring_map(header_size, size, &fd);
+    if (ring == NULL) {
+        last_error.code = SIA_ERR_INIT_FAILED;
+        last_error.msg = "Failed to map ring memory";
+        if (_sia_global_error_callback != NULL) {
+            _sia_global_error_callback(last_error);
+        }
+#ifndef SIA_NO_STDIO
+        else {
+            _sia_stderr_error_callback(last_error);
+        }
+#endif
+        return NULL;
+    }
+
+    // The header page is fresh anonymous memory, so every cursor starts at 0
+    ring->_data = (sia_u8*)ring + header_size;
+    ring->_size = size;
+    ring->_map_size = header_size + size * 2;
+    ring->_align = align;
+    ring->_memfd = fd;
+    ring->error_callback = desc->error_callback == NULL ?
+        _sia_empty_error_callback : desc->error_callback;
+
+    return ring;
+}
+
+void sia_ring_destroy(sia_ring* ring) {
+    if (ring == NULL) {
+        return;
+    }
+
+    _sia_ring_unmap(ring, ring->_map_size, ring->_memfd);
+}
+
+void* sia_ring_push(sia_ring* ring, sia_u64 size) {
+    sia_u64 start = SIA_ALIGN_UP_POW2(ring->_write, ring->_align);
+    sia_u64 end = start + size;
+
+    if (end - ring->_tail_cache > ring->_size) {
+        ring->_tail_cache = SIA_ATOMIC_LOAD_U64(&ring->_tail);
+
+        if (end - ring->_tail_cache > ring->_size) {
+            last_error.code = SIA_ERR_OUT_OF_MEMORY;
+            last_error.msg = "Ring does not have enough free space";
+            ring->_last_error = last_error;
+            ring->error_callback(last_error);
+            return NULL;
+        }
+    }
+
+    ring->_write = end;
+
+    // The second view covers everything that runs past the end of the first one
+    return ring->_data + (start & (ring->_size - 1));
+}
+
+void sia_ring_publish(sia_ring* ring) {
+    SIA_ATOMIC_STORE_U64(&ring->_head, ring->_write);
+}
+
+void* sia_ring_peek(sia_ring* ring, sia_u64* size) {
+    sia_u64 tail = SIA_ATOMIC_LOAD_RELAXED_U64(&ring->_tail);
+    ring->_head_cache = SIA_ATOMIC_LOAD_U64(&ring->_head);
+
+    *size = ring->_head_cache - tail;
+    return ring->_data + (tail & (ring->_size - 1));
+}
+
+void sia_ring_consume(sia_ring* ring, sia_u64 size) {
+    sia_u64 tail = SIA_ATOMIC_LOAD_RELAXED_U64(&ring->_tail);
+    if (size > ring->_head_cache - tail) {
+        ring->_head_cache = SIA_ATOMIC_LOAD_U64(&ring->_head);
+    }
+
+    if (size > ring->_head_cache - tail) {
+        last_error.code = SIA_ERR_CANNOT_POP_MORE;
+        last_error.msg = "Attempted to consume more than the ring has published";
+        ring->_last_error = last_error;
+        ring->error_callback(last_error);
+        size = ring->_head_cache - tail;
+    }
+
+    SIA_ATOMIC_STORE_U64(&ring->_tail, tail + size);
+}
+
+#else
+
+sia_ring* sia_ring_create(const sia_ring_desc* desc) {
+    SIA_UNUSED(desc);
+    last_error.code = SIA_ERR_INIT_FAILED;
+    last_error.msg = "Rings are not supported on this platform";
+    if (_sia_global_error_callback != NULL) {
+        _sia_global_error_callback(last_error);
+    }
+#ifndef SIA_NO_STDIO
+    else {
+        _sia_stderr_error_callback(last_error);
+    }
+#endif
+    return NULL;
+}
+void sia_ring_destroy(sia_ring* ring) { SIA_UNUSED(ring); }
+void* sia_ring_push(sia_ring* ring, sia_u64 size) { SIA_UNUSED(ring); SIA_UNUSED(size); return NULL; }
+void sia_ring_publish(sia_ring* ring) { SIA_UNUSED(ring); }
+void* sia_ring_peek(sia_ring* ring, sia_u64* size) { SIA_UNUSED(ring); *size = 0; return NULL; }
+void sia_ring_consume(sia_ring* ring, sia_u64 size) { SIA_UNUSED(ring); SIA_UNUSED(size); }
+
+#endif // SIA_HAS_RINGS
+
+sia_error sia_ring_get_error(sia_ring* ring) {
+    sia_error* err = ring == NULL ? &last_error : &ring->_last_error;
+    sia_error temp = *err;
+
+    *err = (sia_error){ SIA_ERR_NONE, "" };
+
+    return temp;
+}
+sia_u64 sia_ring_get_size(sia_ring* ring) { return ring->_size; }
+
+static void _sia_frame_ring_cleanup(void* ptr) {
+    sia_frame_ring_destroy((sia_frame_ring*)ptr);
+}
+
+sia_frame_ring* sia_frame_ring_create(const sia_frame_ring_desc* desc) {
+    if (desc == NULL || desc->arena == NULL) {
+        last_error.code = SIA_ERR_INVALID_PTR;
+        last_error.msg = desc == NULL ? "Frame ring description is NULL" : "Arena is NULL";
+        if (_sia_global_error_callback != NULL) {
+            _sia_global_error_callback(last_error);
+        }
+#ifndef SIA_NO_STDIO
+        else {
+            _sia_stderr_error_callback(last_error);
+        }
+#endif
+        return NULL;
+    }
+
+    si_arena* arena = desc->arena;
+    sia_u32 num_frames = desc->num_frames == 0 ? 3 : desc->num_frames;
+    sia_u64 start_pos = sia_get_pos(arena);
+
+    // The cursors are on their own cache lines, so the struct has to be too
+    sia_frame_ring* ring = (sia_frame_ring*)sia_push_zero_aligned(arena, sizeof(sia_frame_ring), 64);
+    si_arena** frames = SIA_PUSH_ZERO_ARRAY(arena, si_arena*, num_frames);
+    void** data = SIA_PUSH_ZERO_ARRAY(arena, void*, num_frames);
+    if (ring == NULL || frames == NULL || data == NULL) {
+        sia_pop_to(arena, start_pos);
+        return NULL;
+    }
+
+    ring->arena = arena;
+    ring->_frames = frames;
+    ring->_data = data;
+    ring->_num_frames = num_frames;
+    for (sia_u32 i = 0; i < SIA_FRAME_MAX_READERS; i++) {
+        ring->_readers[i].released = UINT64_MAX;
+    }
+
+    for (sia_u32 i = 0; i < num_frames; i++) {
+        frames[i] = sia_create(&desc->frame_desc);
+        if (frames[i] == NULL) {
+            sia_frame_ring_destroy(ring);
+            sia_pop_to(arena, start_pos);
+            return NULL;
+        }
+    }
+
+    // The frame arenas are destroyed when the arena pops the ring
+    if (!sia_add_cleanup(arena, ring, _sia_frame_ring_cleanup)) {
+        sia_frame_ring_destroy(ring);
+        sia_pop_to(arena, start_pos);
+        return NULL;
+    }
+
+    return ring;
+}
+
+void sia_frame_ring_destroy(sia_frame_ring* ring) {
+    for (sia_u32 i = 0; i < ring->_num_frames; i++) {
+        if (ring->_frames[i] != NULL) {
+            sia_destroy(ring->_frames[i]);
+            ring->_frames[i] = NULL;
+        }
+    }
+}
+
+sia_u32 sia_frame_reader_register(sia_frame_ring* ring) {
+    for (sia_u32 i = 0; i < SIA_FRAME_MAX_READERS; i++) {
+        // Holding 0 stops the producer from reusing any frame,
+        // until the reader knows which frame it starts at
+        if (SIA_ATOMIC_LOAD_U64(&ring->_readers[i].released) == UINT64_MAX &&
+            SIA_ATOMIC_CAS_U64(&ring->_readers[i].released, UINT64_MAX, 0)) {
+
+            // Frames published before this point may already be reset,
+            // so the reader starts with the next one
+            SIA_ATOMIC_STORE_U64(&ring->_readers[i].released, SIA_ATOMIC_LOAD_U64(&ring->_published));
+            return i;
+        }
+    }
+
+    last_error.code = SIA_ERR_INIT_FAILED;
+    last_error.msg = "Frame ring has no free reader slots";
+    ring->arena->_last_error = last_error;
+    ring->arena->error_callback(last_error);
+    return SIA_FRAME_NO_READER;
+}
+
+void sia_frame_reader_unregister(sia_frame_ring* ring, sia_u32 reader) {
+    if (reader < SIA_FRAME_MAX_READERS) {
+        SIA_ATOMIC_STORE_U64(&ring->_readers[reader].released, UINT64_MAX);
+    }
+}
+
+si_arena* sia_frame_begin(sia_frame_ring* ring) {
+    sia_u64 next = SIA_ATOMIC_LOAD_RELAXED_U64(&ring->_published);
+
+    // The arena last held frame next - num_frames,
+    // which has to be released by every reader before it is reset
+    if (next >= ring->_num_frames) {
+        sia_u64 reused = next - ring->_num_frames;
+        for (sia_u32 i = 0; i < SIA_FRAME_MAX_READERS; i++) {
+            if (SIA_ATOMIC_LOAD_U64(&ring->_readers[i].released) <= reused) {
+                return NULL;
+            }
+        }
+    }
+
+    si_arena* arena = ring->_frames[next % ring->_num_frames];
+    sia_reset(arena);
+
+    return arena;
+}
+
+void sia_frame_publish(sia_frame_ring* ring, void* data) {
+    sia_u64 next = SIA_ATOMIC_LOAD_RELAXED_U64(&ring->_published);
+
+    ring->_data[next % ring->_num_frames] = data;
+    SIA_ATOMIC_STORE_U64(&ring->_published, next + 1);
+}
+
+sia_frame sia_frame_acquire(sia_frame_ring* ring, sia_u32 reader) {
+    sia_frame out = { .ring = ring, ._reader = reader };
+    if (reader >= SIA_FRAME_MAX_READERS) {
+        return out;
+    }
+
+    // Readers go through every frame in order, so the next frame is the number released so far
+    sia_u64 index = SIA_ATOMIC_LOAD_RELAXED_U64(&ring->_readers[reader].released);
+    if (index < SIA_ATOMIC_LOAD_U64(&ring->_published)) {
+        out.arena = ring->_frames[index % ring->_num_frames];
+        out.data = ring->_data[index % ring->_num_frames];
+        out.index = index;
+    }
+
+    return out;
+}
+
+void sia_frame_release(sia_frame frame) {
+    if (frame.arena != NULL) {
+        SIA_ATOMIC_STORE_U64(&frame.ring->_readers[frame._reader].released, frame.index + 1);
+    }
+}
+
+_SIA_UNTRACED void _SIA_TRACED(sia_pop_to)(si_arena* arena, sia_u64 pos) {
+    sia_pop(arena, arena->_pos - pos);
+}
+
+_SIA_UNTRACED sia_temp _SIA_TRACED(sia_temp_begin)(si_arena* arena) {
+    return (sia_temp){
+        .arena = arena,
+        ._pos = arena->_pos
+    };
+}
+_SIA_UNTRACED void _SIA_TRACED(sia_temp_end)(sia_temp temp) {
+    sia_pop_to(temp.arena, temp._pos);
+}
+
+#ifndef SIA_SCRATCH_COUNT
+#   define SIA_SCRATCH_COUNT 2
+#endif
+
+#ifndef SIA_NO_STDIO
+static void _sia_scratch_on_error(sia_error err) {
+    fprintf(stderr, "SIA Scratch Error %u: %s\n", err.code, err.msg);
+}
+#endif
+
+static SIA_THREAD_VAR sia_desc _sia_scratch_desc = {
+    .desired_max_size = SIA_MiB(64),
+    .desired_block_size = SIA_KiB(256),
+    .name = "scratch",
+#ifndef SIA_NO_STDIO
+    .error_callback = _sia_scratch_on_error,
+#endif
+};
+static SIA_THREAD_VAR si_arena* _sia_scratch_arenas[SIA_SCRATCH_COUNT] = { 0 };
+
+void sia_scratch_set_desc(const sia_desc* desc) {
+    if (_sia_scratch_arenas[0] == NULL) {
+        _sia_scratch_desc = (sia_desc){
+            .desired_max_size = desc->desired_max_size,
+            .desired_block_size = desc->desired_block_size,
+            .align = desc->align,
+            .error_callback = desc->error_callback,
+            .name = desc->name == NULL ? "scratch" : desc->name,
+            .space = desc->space
+        };
+    }
+}
+sia_temp sia_scratch_get(si_arena** conflicts, sia_u32 num_conflicts) {
+    if (_sia_scratch_arenas[0] == NULL) {
+        for (sia_u32 i = 0; i < SIA_SCRATCH_COUNT; i++) {
+            _sia_scratch_arenas[i] = sia_create(&_sia_scratch_desc);
+        }
+    }
+
+    sia_temp out = { 0 };
+
+    for (sia_u32 i = 0; i < SIA_SCRATCH_COUNT; i++) {
+        si_arena* arena = _sia_scratch_arenas[i];
+
+        sia_b32 in_conflict = SIA_FALSE;
+        for (sia_u32 j = 0; j < num_conflicts; j++) {
+            if (arena == conflicts[j]) {
+                in_conflict = SIA_TRUE;
+                break;
+            }
+        }
+        // Creating it fails when the address space of the scratch desc is full
+        if (in_conflict || arena == NULL) { continue; }
+
+        out = sia_temp_begin(arena);
+    }
+
+    return out;
+}
+void sia_scratch_release(sia_temp scratch) {
+    sia_temp_end(scratch);
+}
+
+#ifndef SIA_SCOPE_MAX_DEPTH
+#   define SIA_SCOPE_MAX_DEPTH 16
+#endif
+
+static SIA_THREAD_VAR sia_temp _sia_scopes[SIA_SCOPE_MAX_DEPTH];
+// Scopes nested deeper than SIA_SCOPE_MAX_DEPTH are counted, but do not get an arena
+static SIA_THREAD_VAR sia_u32 _sia_scope_depth = 0;
+
+void sia_scope_begin(void) {
+    if (_sia_scope_depth < SIA_SCOPE_MAX_DEPTH) {
+        _sia_scopes[_sia_scope_depth] = sia_scratch_get(NULL, 0);
+    }
+    _sia_scope_depth++;
+}
+void sia_scope_end(void) {
+    if (_sia_scope_depth == 0) {
+        return;
+    }
+
+    _sia_scope_depth--;
+    if (_sia_scope_depth < SIA_SCOPE_MAX_DEPTH && _sia_scopes[_sia_scope_depth].arena != NULL) {
+        sia_scratch_release(_sia_scopes[_sia_scope_depth]);
+    }
+}
+si_arena* sia_scope_get(void) {
+    if (_sia_scope_depth == 0 || _sia_scope_depth > SIA_SCOPE_MAX_DEPTH) {
+        return NULL;
+    }
+    return _sia_scopes[_sia_scope_depth - 1].arena;
+}
+
+// Every empty view that a function returns points here, so it is always a valid C string
+static const char _sia_str_empty[1] = { 0 };
+
+sia_str_builder sia_str_begin(si_arena* arena) {
+    sia_str_builder out = { 0 };
+    out.arena = arena;
+    out.failed = arena == NULL;
+    return out;
+}
+
+#define _SIA_STR_MIN_CAP 64
+
+// Makes room for size more bytes plus the null terminator
+static sia_b32 _sia_str_reserve(sia_str_builder* builder, sia_u64 size) {
+    if (builder->failed) {
+        return SIA_FALSE;
+    }
+
+    sia_u64 needed = builder->len + size + 1;
+    if (needed <= builder->cap) {
+        return SIA_TRUE;
+    }
+
+    // Doubling only matters when the builder has to move, since growing in place is free
+    sia_u64 new_cap = SIA_MAX(needed, SIA_MAX(builder->cap * 2, _SIA_STR_MIN_CAP));
+    char* data = builder->data == NULL ?
+        (char*)sia_push_aligned(builder->arena, new_cap, 1) :
+        (char*)sia_realloc_aligned(builder->arena, builder->data, builder->cap, new_cap, 1);
+
+    if (data == NULL) {
+        builder->failed = SIA_TRUE;
+        return SIA_FALSE;
+    }
+
+    builder->data = data;
+    builder->cap = new_cap;
+
+    return SIA_TRUE;
+}
+
+static void _sia_str_copy_bytes(char* dst, const char* src, sia_u64 len) {
+    if (len != 0) {
+        SIA_MEMCPY(dst, src, len);
+    }
 }
 
-static sia_b32 _sia_is_last_allocation(si_arena* arena, void* ptr, sia_u64 size) {
-#ifdef SIA_FORCE_MALLOC
-    _sia_malloc_node* node = arena->_malloc_backend.cur_node;
-    sia_u8* node_start = node->data;
-    sia_u8* ptr_u8 = (sia_u8*)ptr;
-    
-    if (ptr_u8 < node_start || ptr_u8 >= node_start + node->size) {
+sia_b32 sia_str_append(sia_str_builder* builder, sia_str str) {
+    if (!_sia_str_reserve(builder, str.len)) {
         return SIA_FALSE;
     }
-    
-    sia_u64 ptr_offset = ptr_u8 - node_start;
-    sia_u64 aligned_offset = SIA_ALIGN_UP_POW2(ptr_offset, arena->_align);
-    sia_u64 allocation_end = aligned_offset + size;
-    
-    return (allocation_end == node->pos);
-#else
-    sia_u8* arena_start = (sia_u8*)arena;
-    sia_u8* ptr_u8 = (sia_u8*)ptr;
-    
-    if (ptr_u8 < arena_start + SIA_MIN_POS || ptr_u8 >= arena_start + arena->_pos) {
+
+    _sia_str_copy_bytes(builder->data + builder->len, str.data, str.len);
+    builder->len += str.len;
+
+    return SIA_TRUE;
+}
+sia_b32 sia_str_append_cstr(sia_str_builder* builder, const char* cstr) {
+    return sia_str_append(builder, sia_str_from_cstr(cstr));
+}
+sia_b32 sia_str_append_char(sia_str_builder* builder, char c) {
+    if (!_sia_str_reserve(builder, 1)) {
         return SIA_FALSE;
     }
-    
-    sia_u64 ptr_offset = ptr_u8 - arena_start;
-    sia_u64 aligned_offset = SIA_ALIGN_UP_POW2(ptr_offset, arena->_align);
-    sia_u64 allocation_end = aligned_offset + size;
-    
-    return (allocation_end == arena->_pos);
-#endif
+
+    builder->data[builder->len++] = c;
+
+    return SIA_TRUE;
 }
 
-si_arena* sia_merge(si_arena** arenas, sia_u32 num_arenas){
-    if (arenas == NULL || num_arenas == 0) {
-        last_error.code = SIA_ERR_INVALID_PTR;
-        last_error.msg = "Arenas are NULL or empty";
-        if (_sia_global_error_callback != NULL) {
-            _sia_global_error_callback(last_error);
-        }
-#ifndef SIA_NO_STDIO
-        else {
-            _sia_stderr_error_callback(last_error);
-        }
-#endif
-        return NULL;
+sia_b32 sia_str_append_join(sia_str_builder* builder, const sia_str* parts, sia_u64 count, sia_str sep) {
+    // One reserve for the whole join
+    sia_u64 total = count == 0 ? 0 : sep.len * (count - 1);
+    for (sia_u64 i = 0; i < count; i++) {
+        total += parts[i].len;
+    }
+    if (!_sia_str_reserve(builder, total)) {
+        return SIA_FALSE;
     }
 
-    sia_u64 total_size = 0;
-    for (sia_u32 i = 0; i < num_arenas; i++) {
-        if (arenas[i] == NULL) {
-            last_error.code = SIA_ERR_INVALID_PTR;
-            last_error.msg = "Arena is NULL";
-            if (_sia_global_error_callback != NULL) {
-                _sia_global_error_callback(last_error);
-            }
-#ifndef SIA_NO_STDIO
-            else {
-                _sia_stderr_error_callback(last_error);
-            }
-#endif
-            return NULL;
+    char* dst = builder->data + builder->len;
+    for (sia_u64 i = 0; i < count; i++) {
+        if (i != 0) {
+            _sia_str_copy_bytes(dst, sep.data, sep.len);
+            dst += sep.len;
         }
-#ifdef SIA_FORCE_MALLOC
-        total_size += arenas[i]->_pos;
-#else
-        total_size += arenas[i]->_pos - SIA_MIN_POS;
-#endif
+        _sia_str_copy_bytes(dst, parts[i].data, parts[i].len);
+        dst += parts[i].len;
     }
+    builder->len += total;
 
-    sia_u32 max_block_size = 0;
-    sia_u32 max_align = 0;
-    sia_error_callback* error_cb = NULL;
-    
-    for (sia_u32 i = 0; i < num_arenas; i++) {
-        if (arenas[i]->_block_size > max_block_size) {
-            max_block_size = arenas[i]->_block_size;
-        }
-        if (arenas[i]->_align > max_align) {
-            max_align = arenas[i]->_align;
+    return SIA_TRUE;
+}
+
+sia_str sia_str_end(sia_str_builder* builder) {
+    if (builder->failed || builder->data == NULL) {
+        return (sia_str){ 0, _sia_str_empty };
+    }
+
+    builder->data[builder->len] = 0;
+
+    // Gives back the capacity that was never used, if nothing was pushed after the builder
+    sia_u64 unused = builder->cap - (builder->len + 1);
+    _sia_sync(builder->arena);
+    if (unused != 0 && _sia_is_last_allocation(builder->arena, builder->data, builder->cap)) {
+        sia_pop(builder->arena, unused);
+    }
+
+    sia_str out = { builder->len, builder->data };
+    *builder = sia_str_begin(builder->arena);
+
+    return out;
+}
+
+sia_str sia_str_from_cstr(const char* cstr) {
+    if (cstr == NULL) {
+        return (sia_str){ 0, _sia_str_empty };
+    }
+
+    sia_u64 len = 0;
+    while (cstr[len] != 0) {
+        len++;
+    }
+
+    return (sia_str){ len, cstr };
+}
+
+sia_str sia_str_copy(si_arena* arena, sia_str str) {
+    sia_str_builder builder = sia_str_begin(arena);
+    sia_str_append(&builder, str);
+    return sia_str_end(&builder);
+}
+
+sia_str sia_str_join(si_arena* arena, const sia_str* parts, sia_u64 count, sia_str sep) {
+    sia_str_builder builder = sia_str_begin(arena);
+    sia_str_append_join(&builder, parts, count, sep);
+    return sia_str_end(&builder);
+}
+
+sia_str sia_str_slice(sia_str str, sia_u64 start, sia_u64 end) {
+    end = SIA_MIN(end, str.len);
+    start = SIA_MIN(start, end);
+    return (sia_str){ end - start, str.data + start };
+}
+
+sia_b32 sia_str_split(sia_str* rest, sia_str sep, sia_str* part) {
+    // A NULL data pointer marks that the last part was already returned
+    if (rest->data == NULL) {
+        *part = (sia_str){ 0, _sia_str_empty };
+        return SIA_FALSE;
+    }
+
+    sia_u64 index = sep.len == 0 ? SIA_STR_NPOS : sia_str_find(*rest, sep);
+    if (index == SIA_STR_NPOS) {
+        *part = *rest;
+        *rest = (sia_str){ 0, NULL };
+        return SIA_TRUE;
+    }
+
+    *part = sia_str_slice(*rest, 0, index);
+    *rest = sia_str_slice(*rest, index + sep.len, rest->len);
+
+    return SIA_TRUE;
+}
+
+sia_u64 sia_str_find(sia_str str, sia_str needle) {
+    if (needle.len == 0) {
+        return 0;
+    }
+    if (needle.len > str.len) {
+        return SIA_STR_NPOS;
+    }
+
+    for (sia_u64 i = 0; i <= str.len - needle.len; i++) {
+        if (str.data[i] != needle.data[0]) {
+            continue;
         }
-        // Use first arena's error callback, or global if available
-        if (i == 0) {
-            error_cb = arenas[i]->error_callback;
+        if (sia_str_eq(sia_str_slice(str, i, i + needle.len), needle)) {
+            return i;
         }
     }
-    
-    // Use global callback if available, otherwise use first arena's
-    if (_sia_global_error_callback != NULL) {
-        error_cb = _sia_global_error_callback;
+
+    return SIA_STR_NPOS;
+}
+
+sia_b32 sia_str_eq(sia_str a, sia_str b) {
+    if (a.len != b.len) {
+        return SIA_FALSE;
     }
 
+    for (sia_u64 i = 0; i < a.len; i++) {
+        if (a.data[i] != b.data[i]) {
+            return SIA_FALSE;
+        }
+    }
+
+    return SIA_TRUE;
+}
+
 #ifndef SIA_NO_STDIO
-    // Default to stderr if no callback set
-    if (error_cb == NULL || error_cb == _sia_empty_error_callback) {
-        error_cb = _sia_stderr_error_callback;
+
+sia_b32 sia_str_appendfv(sia_str_builder* builder, const char* fmt, va_list args) {
+    if (builder->failed) {
+        return SIA_FALSE;
     }
-#endif
-    sia_desc merged_desc = {
-        .desired_max_size = total_size,
-        .desired_block_size = max_block_size,
-        .align = max_align, 
-        .error_callback = error_cb  
-    };
 
-     si_arena* merged = sia_create(&merged_desc);
-     if (merged == NULL) {
-         return NULL;
-     }
-     
-     for (sia_u32 i = 0; i < num_arenas; i++) {
-        sia_u64 merged_pos_before = sia_get_pos(merged);
-        si_arena* src = arenas[i];
-        sia_u64 src_used = src->_pos;
-#ifdef SIA_FORCE_MALLOC
-        _sia_malloc_node* node = src->_malloc_backend.cur_node;
-        while (node != NULL) {
-            sia_u64 copy_size = node->pos;
-            if (copy_size > 0){
-                void* dst = sia_push(merged, copy_size);
-                if (dst == NULL){
-                    last_error.code = SIA_ERR_MERGE_FAILED;
-                    last_error.msg = "Failed to allocate memory for merge";
-                    merged->_last_error = last_error;
-                    merged->error_callback(last_error);
-                    sia_destroy(merged);
-                    return NULL;
-                }
-                SIA_MEMCPY(dst, node->data, copy_size);
-            }
-            node = node->prev;
-        }
-#else
-        // Copy from low-level backend: single contiguous copy
-        if (src_used > SIA_MIN_POS) {
-            sia_u64 copy_size = src_used - SIA_MIN_POS;
-            void* src_data = (void*)((sia_u8*)src + SIA_MIN_POS);
-            void* dst = sia_push(merged, copy_size);
-            if (dst == NULL) {
-                last_error.code = SIA_ERR_MERGE_FAILED;
-                last_error.msg = "Failed to allocate space in merged arena";
-                merged->_last_error = last_error;
-                merged->error_callback(last_error);
-                sia_destroy(merged);
-                return NULL;
-            }
-            SIA_MEMCPY(dst, src_data, copy_size);
+    // Formats straight into the free capacity, and only formats again if it did not fit
+    sia_u64 avail = builder->data == NULL ? 0 : builder->cap - builder->len;
+    va_list copy;
+    va_copy(copy, args);
+    int needed = vsnprintf(builder->data == NULL ? NULL : builder->data + builder->len, (size_t)avail, fmt, copy);
+    va_end(copy);
+
+    if (needed < 0) {
+        builder->failed = SIA_TRUE;
+        return SIA_FALSE;
+    }
+
+    if ((sia_u64)needed >= avail) {
+        if (!_sia_str_reserve(builder, (sia_u64)needed)) {
+            return SIA_FALSE;
         }
-#endif
+        vsnprintf(builder->data + builder->len, (size_t)needed + 1, fmt, args);
     }
-    
-    // Validate merge was successful
-    sia_u64 merged_used = sia_get_pos(merged);
-#ifdef SIA_FORCE_MALLOC
-    if (merged_used != total_size) {
-        last_error.code = SIA_ERR_MERGE_FAILED;
-        last_error.msg = "Merge validation failed: size mismatch";
-        merged->_last_error = last_error;
-        merged->error_callback(last_error);
-        sia_destroy(merged);
+    builder->len += (sia_u64)needed;
+
+    return SIA_TRUE;
+}
+
+sia_b32 sia_str_appendf(sia_str_builder* builder, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    sia_b32 out = sia_str_appendfv(builder, fmt, args);
+    va_end(args);
+    return out;
+}
+
+sia_str sia_str_fmt(si_arena* arena, const char* fmt, ...) {
+    sia_str_builder builder = sia_str_begin(arena);
+
+    va_list args;
+    va_start(args, fmt);
+    sia_str_appendfv(&builder, fmt, args);
+    va_end(args);
+
+    return sia_str_end(&builder);
+}
+
+#endif // SIA_NO_STDIO
+
+#ifdef SIA_HAS_FILE_IO
+
+void* sia_push_read(si_arena* arena, sia_i32 fd, sia_u64 max, sia_u64* size_out) {
+    *size_out = 0;
+    if (max == 0) {
         return NULL;
     }
-#else
-    if (merged_used - SIA_MIN_POS != total_size) {
-        last_error.code = SIA_ERR_MERGE_FAILED;
-        last_error.msg = "Merge validation failed: size mismatch";
-        merged->_last_error = last_error;
-        merged->error_callback(last_error);
-        sia_destroy(merged);
+
+    sia_u8* out = (sia_u8*)sia_push_aligned(arena, max, 1);
+    if (out == NULL) {
         return NULL;
     }
-#endif
-     
-    return merged;
-}
 
-void* sia_realloc(si_arena* arena, void* ptr, sia_u64 old_size, sia_u64 new_size) {
-    if (arena == NULL) {
-        last_error.code = SIA_ERR_INVALID_PTR;
-        last_error.msg = "Arena is NULL";
-       // Call global callback if available
-        if (_sia_global_error_callback != NULL) {
-            _sia_global_error_callback(last_error);
-        }
-        #ifndef SIA_NO_STDIO
-        else {
-            _sia_stderr_error_callback(last_error);
-        }
-        #endif
-        return NULL;
+    ssize_t got;
+    do {
+        got = read(fd, out, (size_t)SIA_MIN(max, SIA_GiB(1)));
+    } while (got < 0 && errno == EINTR);
+    int read_errno = errno;
+
+    // Gives back what was not filled, all of it if nothing was
+    sia_u64 size = got < 0 ? 0 : (sia_u64)got;
+    _sia_sync(arena);
+    if (size != max && _sia_is_last_allocation(arena, out, max)) {
+        sia_pop(arena, max - size);
     }
-    
-    if (ptr == NULL) {
-        // If ptr is NULL, treat as new allocation
-        return sia_push(arena, new_size);
+
+    if (got < 0 && read_errno != EAGAIN && read_errno != EWOULDBLOCK) {
+        last_error.code = SIA_ERR_IO_FAILED;
+        last_error.msg = "Failed to read from fd";
+        arena->_last_error = last_error;
+        arena->error_callback(last_error);
     }
-    
-    if (new_size == 0) {
-        // If new_size is 0, treat as free (but we can't actually free in arena)
-        last_error.code = SIA_ERR_INVALID_PTR;
-        last_error.msg = "New size is 0";
+    errno = read_errno;
+
+    if (size == 0) {
+        return NULL;
+    }
+
+    *size_out = size;
+    return out;
+}
+
+void* sia_push_file(si_arena* arena, const char* path, sia_u32 flags, sia_u64* size_out) {
+    *size_out = 0;
+
+    sia_b32 direct = (flags & SIA_FILE_DIRECT) != 0;
+    int fd = _sia_file_open(path, direct);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        if (fd >= 0) { close(fd); }
+        last_error.code = SIA_ERR_IO_FAILED;
+        last_error.msg = "Failed to open file";
         arena->_last_error = last_error;
         arena->error_callback(last_error);
         return NULL;
     }
-    
-    if (new_size <= old_size) {
-        // Shrinking - in arena, we can't actually shrink, just return same pointer
-        // TODO: Validate the pointer is still valid before returning
-        if (!_sia_is_valid_ptr(arena, ptr, old_size)) {
-            last_error.code = SIA_ERR_INVALID_PTR;
-            last_error.msg = "Invalid pointer for realloc";
+
+    // Direct reads need the buffer, its size, and the file offset aligned to the block size.
+    // Files without a size (pipes, /proc) start small and grow as they are read
+    sia_b32 has_size = S_ISREG(st.st_mode);
+    sia_u64 align = 1;
+    if (direct && has_size) {
+        sia_u64 block_size = (sia_u64)st.st_blksize;
+        sia_u32 page_size = SIA_MEM_PAGESIZE();
+        align = block_size != 0 && (block_size & (block_size - 1)) == 0 && block_size <= page_size ? block_size : page_size;
+        align = SIA_MAX(align, 512);
+    }
+    sia_u64 cap = has_size ? SIA_ALIGN_UP_POW2((sia_u64)st.st_size + 1, align) : SIA_KiB(4);
+
+    // Everything pushed from here on is given back if the read fails
+    sia_u64 start_pos = sia_get_pos(arena);
+    sia_u8* out = (sia_u8*)sia_push_aligned(arena, cap, (sia_u32)align);
+    sia_u64 size = 0;
+    sia_b32 failed = out == NULL;
+    while (!failed) {
+        sia_u64 got = 0;
+        if (!_sia_file_read(fd, out + size, cap - size, &got)) {
+            failed = SIA_TRUE;
+
+            last_error.code = SIA_ERR_IO_FAILED;
+            last_error.msg = "Failed to read file";
             arena->_last_error = last_error;
             arena->error_callback(last_error);
-            return NULL;
+            break;
         }
-        return ptr;
+
+        // A short read is the end of the file, and leaves room for the 0
+        size += got;
+        if (size < cap) {
+            break;
+        }
+
+        // Grows in place when nothing was pushed in between, the size stays aligned.
+        // On failure, out is still the old buffer and the error is already reported
+        sia_u8* grown = (sia_u8*)sia_realloc_aligned(arena, out, cap, cap * 2, (sia_u32)align);
+        if (grown == NULL) {
+            failed = SIA_TRUE;
+            break;
+        }
+        out = grown;
+        cap *= 2;
     }
-    
-    // Growing allocation
-    // TODO: Validate that ptr is a valid pointer from this arena
-    if (!_sia_is_valid_ptr(arena, ptr, old_size)) {
-        last_error.code = SIA_ERR_INVALID_PTR;
-        last_error.msg = "Invalid pointer for realloc";
-        arena->_last_error = last_error;
-        arena->error_callback(last_error);
+    close(fd);
+
+    if (failed) {
+        sia_pop_to(arena, start_pos);
         return NULL;
     }
-    
-    if (_sia_is_last_allocation(arena, ptr, old_size)) {
-        // Try to grow in-place
-        sia_u64 additional_size = new_size - old_size;
-        void* new_ptr = sia_push(arena, additional_size);
-        
-        if (new_ptr != NULL && new_ptr == (void*)((sia_u8*)ptr + old_size)) {
-            return ptr;
-        }
-        
-        // Failed to grow in-place, need to allocate new and copy
-        sia_pop(arena, additional_size);
-    }
-    
-#ifdef SIA_FORCE_MALLOC
-    // Malloc backend implementation
-    // TODO: For malloc backend, check if we can grow within current node
-    _sia_malloc_node* node = arena->_malloc_backend.cur_node;
 
-    sia_u8* node_start = node->data;
-    sia_u8* node_end = node_start + node->size;
-    sia_u8* ptr_u8 = (sia_u8*) ptr;
-
-    // Check if ptr is in current node and there's space after, we can grow in-place
-    if (ptr_u8 >= node_start && ptr_u8 < node_end){
-        sia_u64 ptr_offset = ptr_u8 - node_start;
-        sia_u64 aligned_offset = SIA_ALIGN_UP_POW2(ptr_offset, arena->_align);
-        sia_u64 allocation_end = aligned_offset + old_size;
-
-        if (allocation_end == node->pos){
-            sia_u64 additional_size = new_size - old_size;
-            sia_u64 space_available = node->size - node->pos;
-            if (additional_size <= space_available){
-                arena->_pos += additional_size;
-                node->pos += additional_size;
-                return ptr;
-            }
-        }
+    out[size] = 0;
+
+    _sia_sync(arena);
+    if (cap > size + 1 && _sia_is_last_allocation(arena, out, cap)) {
+        sia_pop(arena, cap - (size + 1));
     }
-    
-    // Can't grow in-place, allocate new and copy
-    void *new_ptr = sia_push(arena, new_size);
-    if (new_ptr == NULL){
-        last_error.code = SIA_ERR_REALLOC_FAILED;
-        last_error.msg = "Failed to allocate new memory for realloc";
+
+    *size_out = size;
+    return out;
+}
+
+const void* sia_map_file(si_arena* arena, const char* path, sia_u64* size_out) {
+    *size_out = 0;
+
+    int fd = _sia_file_open(path, SIA_FALSE);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        if (fd >= 0) { close(fd); }
+        last_error.code = SIA_ERR_IO_FAILED;
+        last_error.msg = "Failed to open file, or it is not a regular file";
         arena->_last_error = last_error;
         arena->error_callback(last_error);
         return NULL;
     }
-    SIA_MEMCPY(new_ptr, ptr, old_size);
-    return new_ptr;
-#else
-    // Low-level backend implementation
-    sia_u8* arena_start = (sia_u8*)arena;
-    sia_u8* ptr_u8 = (sia_u8*)ptr;
 
-    // Check if ptr is within valid arena range
-    if (ptr_u8 >= arena_start + SIA_MIN_POS && ptr_u8 < arena_start + arena->_pos) {
-        sia_u64 ptr_offset = ptr_u8 - arena_start;
-        sia_u64 aligned_offset = SIA_ALIGN_UP_POW2(ptr_offset, arena->_align);
-        sia_u64 allocation_end = aligned_offset + old_size;
-
-        if (allocation_end == arena->_pos){
-            sia_u64 additional_size = new_size - old_size;
-            sia_u64 space_available = arena->_size - arena->_pos;
-            if (additional_size <= space_available){
-                arena->_pos += additional_size;
-                sia_u64 commit_pos = arena->_reserve_backend.commit_pos;
-                if (arena->_pos > commit_pos){
-                    sia_u64 commit_unclamped = SIA_ALIGN_UP_POW2(arena->_pos, arena->_block_size);
-                    sia_u64 new_commit_pos = SIA_MIN(commit_unclamped, arena->_size);
-                    sia_u64 commit_size = new_commit_pos - commit_pos;
-                    if (!SIA_MEM_COMMIT((void*)(arena_start + commit_pos), commit_size)){
-                        // Rollback arena->_pos on commit failure
-                        arena->_pos -= additional_size;
-                        last_error.code = SIA_ERR_COMMIT_FAILED;
-                        last_error.msg = "Failed to commit memory for realloc";
-                        arena->_last_error = last_error;
-                        arena->error_callback(last_error);
-                        return NULL;
-                    }
-                    arena->_reserve_backend.commit_pos = new_commit_pos;
+    // Nothing to map, the empty string is as good as any pointer
+    sia_u64 size = (sia_u64)st.st_size;
+    if (size == 0) {
+        close(fd);
+        return _sia_str_empty;
+    }
 
-                }
-                return ptr;
-            }
-        }
+    if (!_sia_governor_charge_mapping(arena, size)) {
+        close(fd);
+        return NULL;
     }
-    
-    // Can't grow in-place, allocate new and copy
-    void* new_ptr = sia_push(arena, new_size);
-    if (new_ptr == NULL) {
-        last_error.code = SIA_ERR_REALLOC_FAILED;
-        last_error.msg = "Failed to allocate new memory for realloc";
+
+    // The mapping stays valid after the fd is closed
+    void* base = _sia_file_map(fd, size);
+    close(fd);
+    if (base == NULL) {
+        _sia_governor_refund_mapping(arena, size);
+        last_error.code = SIA_ERR_IO_FAILED;
+        last_error.msg = "Failed to map file";
         arena->_last_error = last_error;
         arena->error_callback(last_error);
         return NULL;
     }
-    
-    // Copy old_size bytes from ptr to new_ptr
-    SIA_MEMCPY(new_ptr, ptr, old_size);
-    
-    return new_ptr;
-#endif
-}
 
-sia_pool* sia_pool_create(const sia_pool_desc* desc) {
-    if (desc == NULL) {
-        last_error.code = SIA_ERR_INVALID_PTR;
-        last_error.msg = "Pool description is NULL";
-        if (_sia_global_error_callback != NULL) {
-            _sia_global_error_callback(last_error);
-        }
-#ifndef SIA_NO_STDIO
-        else {
-            _sia_stderr_error_callback(last_error);
-        }
-#endif
+    // Same as a large allocation, only the record is in the arena
+    _sia_sync(arena);
+    _sia_mapping* mapping = (_sia_mapping*)_sia_push_impl(arena, sizeof(_sia_mapping), (sia_u32)sizeof(void*));
+    if (mapping == NULL) {
+        _sia_file_unmap(base, size);
+        _sia_governor_refund_mapping(arena, size);
+        _sia_update_fast(arena);
         return NULL;
     }
-    if (desc->arena == NULL){
-        last_error.code= SIA_ERR_INVALID_PTR;
-        last_error.msg = "Arena is NULL";
-        if (_sia_global_error_callback != NULL) {
-            _sia_global_error_callback(last_error);
+    SIA_ASAN_UNPOISON(mapping, sizeof(_sia_mapping));
+
+    mapping->prev = arena->_mappings;
+    mapping->end_pos = arena->_pos;
+    mapping->base = base;
+    mapping->map_size = size;
+    mapping->is_large = SIA_FALSE;
+    mapping->is_file = SIA_TRUE;
+    arena->_mappings = mapping;
+    _sia_update_fast(arena);
+
+    *size_out = size;
+    return base;
+}
+
+#else
+
+static void _sia_file_unsupported(si_arena* arena, sia_u64* size_out) {
+    *size_out = 0;
+    last_error.code = SIA_ERR_IO_FAILED;
+    last_error.msg = "File I/O is not supported on this platform";
+    arena->_last_error = last_error;
+    arena->error_callback(last_error);
+}
+void* sia_push_read(si_arena* arena, sia_i32 fd, sia_u64 max, sia_u64* size_out) {
+    SIA_UNUSED(fd); SIA_UNUSED(max);
+    _sia_file_unsupported(arena, size_out);
+    return NULL;
+}
+void* sia_push_file(si_arena* arena, const char* path, sia_u32 flags, sia_u64* size_out) {
+    SIA_UNUSED(path); SIA_UNUSED(flags);
+    _sia_file_unsupported(arena, size_out);
+    return NULL;
+}
+const void* sia_map_file(si_arena* arena, const char* path, sia_u64* size_out) {
+    SIA_UNUSED(path);
+    _sia_file_unsupported(arena, size_out);
+    return NULL;
+}
+
+#endif // SIA_HAS_FILE_IO
+
+#ifdef SIA_ENABLE_TRACE
+
+/*
+Trace
+============================
+  _____ ___    _   ___ ___ 
+ |_   _| _ \  /_\ / __| __|
+   | | |   / / _ \ (__| _| 
+   |_| |_|_\/_/ \_\___|___|
+
+============================
+*/
+
+#ifndef SIA_TRACE_BUFFER_SIZE
+#   define SIA_TRACE_BUFFER_SIZE 1024
+#endif
+
+#ifdef SIA_PLATFORM_WIN32
+#   include <io.h>
+#endif
+
+// The lock is only held while records are added, full buffers are written after it is released
+#if defined(SIA_PLATFORM_WIN32)
+static SRWLOCK _sia_trace_lock = SRWLOCK_INIT;
+#   define _SIA_TRACE_LOCK() AcquireSRWLockExclusive(&_sia_trace_lock)
+#   define _SIA_TRACE_UNLOCK() ReleaseSRWLockExclusive(&_sia_trace_lock)
+#elif defined(SIA_PLATFORM_LINUX) || defined(SIA_PLATFORM_APPLE) || defined(SIA_PLATFORM_EMSCRIPTEN)
+#   include <pthread.h>
+static pthread_mutex_t _sia_trace_lock = PTHREAD_MUTEX_INITIALIZER;
+#   define _SIA_TRACE_LOCK() pthread_mutex_lock(&_sia_trace_lock)
+#   define _SIA_TRACE_UNLOCK() pthread_mutex_unlock(&_sia_trace_lock)
+#else
+static sia_u32 _sia_trace_lock = 0;
+#   define _SIA_TRACE_LOCK() do { \
+        sia_u32 spins = 0; \
+        while (!SIA_ATOMIC_CAS_U32(&_sia_trace_lock, 0, 1)) { _sia_backoff(&spins); } \
+    } while (0)
+#   define _SIA_TRACE_UNLOCK() SIA_ATOMIC_STORE_U32(&_sia_trace_lock, 0)
+#endif
+
+// Records from every thread go through one buffer, in the order the operations finished.
+// A full buffer is swapped with the other one, and written by the thread that filled it once it released the lock
+static sia_u32 _sia_trace_active = 0;
+static int _sia_trace_fd = -1;
+static sia_u32 _sia_trace_count = 0;
+static sia_u32 _sia_trace_current = 0;
+static sia_u32 _sia_trace_busy[2];
+static sia_trace_record _sia_trace_buffers[2][SIA_TRACE_BUFFER_SIZE];
+
+// Writes take a ticket under the lock, and go out in ticket order
+static sia_u64 _sia_trace_tickets = 0;
+static sia_u64 _sia_trace_written = 0;
+
+typedef struct {
+    int fd;
+    sia_u64 ticket;
+    const void* data;
+    sia_u64 size;
+    // Cleared once the data was written, NULL if it is not a buffer
+    sia_u32* busy;
+} _sia_trace_flush;
+
+// Operations made inside of a traced operation are part of it, so they are not recorded
+static SIA_THREAD_VAR sia_u32 _sia_trace_depth = 0;
+// The buffer this thread filled, written in _sia_trace_end
+static SIA_THREAD_VAR _sia_trace_flush _sia_trace_pending;
+
+static void _sia_trace_write(int fd, const void* data, sia_u64 size) {
+    const sia_u8* bytes = (const sia_u8*)data;
+
+    while (size > 0) {
+#ifdef SIA_PLATFORM_WIN32
+        int written = _write(fd, bytes, (unsigned int)size);
+#else
+        ssize_t written = write(fd, bytes, size);
+#endif
+        if (written <= 0) {
+            return;
         }
-#ifndef SIA_NO_STDIO
-        else {
-            _sia_stderr_error_callback(last_error);
+        bytes += written;
+        size -= (sia_u64)written;
+    }
+}
+
+// Has to be called with the lock held
+static _sia_trace_flush _sia_trace_take(const void* data, sia_u64 size, sia_u32* busy) {
+    if (busy != NULL) {
+        SIA_ATOMIC_STORE_U32(busy, 1);
+    }
+    return (_sia_trace_flush){
+        .fd = _sia_trace_fd,
+        .ticket = _sia_trace_tickets++,
+        .data = data,
+        .size = size,
+        .busy = busy
+    };
+}
+
+static void _sia_trace_flush_write(const _sia_trace_flush* flush) {
+    sia_u32 spins = 0;
+    while (SIA_ATOMIC_LOAD_U64(&_sia_trace_written) != flush->ticket) {
+        _sia_backoff(&spins);
+    }
+
+    _sia_trace_write(flush->fd, flush->data, flush->size);
+
+    if (flush->busy != NULL) {
+        SIA_ATOMIC_STORE_U32(flush->busy, 0);
+    }
+    SIA_ATOMIC_STORE_U64(&_sia_trace_written, flush->ticket + 1);
+}
+
+// Waits until the buffer that records are added to is no longer being written
+static void _sia_trace_wait_current(void) {
+    sia_u32 spins = 0;
+    while (SIA_ATOMIC_LOAD_U32(&_sia_trace_busy[_sia_trace_current])) {
+        _sia_backoff(&spins);
+    }
+}
+
+// Takes the lock if the record should be written.
+// Creating and destroying arenas is always recorded, because replaying the outer operation does not repeat it
+static sia_b32 _sia_trace_begin(sia_b32 nested) {
+    if (!SIA_ATOMIC_LOAD_U32(&_sia_trace_active) || (_sia_trace_depth != 0 && !nested)) {
+        return SIA_FALSE;
+    }
+
+    _SIA_TRACE_LOCK();
+
+    // The trace may have stopped while waiting
+    if (_sia_trace_fd < 0) {
+        _SIA_TRACE_UNLOCK();
+        return SIA_FALSE;
+    }
+
+    return SIA_TRUE;
+}
+
+static void _sia_trace_add(sia_trace_record record) {
+    _sia_trace_buffers[_sia_trace_current][_sia_trace_count++] = record;
+
+    if (_sia_trace_count == SIA_TRACE_BUFFER_SIZE) {
+        // Only an operation with more records than a buffer fills two, the first is written right away
+        if (_sia_trace_pending.data != NULL) {
+            _sia_trace_flush_write(&_sia_trace_pending);
         }
-#endif
-        return NULL;
+
+        _sia_trace_pending = _sia_trace_take(_sia_trace_buffers[_sia_trace_current],
+            sizeof(sia_trace_record) * _sia_trace_count, &_sia_trace_busy[_sia_trace_current]);
+        _sia_trace_current ^= 1;
+        _sia_trace_count = 0;
+        _sia_trace_wait_current();
     }
-    
-    sia_u64 block_size = desc->block_size;
-    if (block_size <sizeof(void*)){
-        block_size = sizeof(void*);
+}
+
+static void _sia_trace_end(void) {
+    _SIA_TRACE_UNLOCK();
+
+    if (_sia_trace_pending.data != NULL) {
+        _sia_trace_flush_write(&_sia_trace_pending);
+        _sia_trace_pending.data = NULL;
     }
-    // Calculate alignment (default to block_size or pointer size)
-    sia_u32 align = desc->align;
-    if (align == 0) {
-        align = (sia_u32)block_size;
+}
+
+static void _sia_trace_one(sia_trace_record record, sia_b32 nested) {
+    if (_sia_trace_begin(nested)) {
+        _sia_trace_add(record);
+        _sia_trace_end();
     }
-    if (align < sizeof(void*)) {
-        align = sizeof(void*);
+}
+
+sia_b32 sia_trace_start(int fd) {
+    sia_trace_header header = {
+        .version = SIA_TRACE_VERSION,
+        .record_size = sizeof(sia_trace_record)
+    };
+    SIA_MEMCPY(header.magic, SIA_TRACE_MAGIC, sizeof(header.magic));
+    _sia_trace_flush flush = { 0 };
+
+    _SIA_TRACE_LOCK();
+
+    sia_b32 out = _sia_trace_fd < 0;
+    if (out) {
+        _sia_trace_fd = fd;
+        _sia_trace_count = 0;
+        _sia_trace_wait_current();
+
+        // Records can only be written after the header, because they take later tickets
+        flush = _sia_trace_take(&header, sizeof(header), NULL);
+        SIA_ATOMIC_ADD_U32(&_sia_trace_active, 1);
     }
 
-    sia_pool* pool = (sia_pool*) SIA_PUSH_ZERO_STRUCT(desc->arena, sia_pool);
-    if (pool == NULL){
-        return NULL;
+    _SIA_TRACE_UNLOCK();
+
+    if (out) {
+        _sia_trace_flush_write(&flush);
     }
-    pool->arena = desc->arena;
-    pool->block_size = block_size;
-    pool->align = align;
-    pool->free_list = NULL;
-    pool->total_blocks = 0;
-    pool->free_blocks = 0;
-    pool->block_memory = NULL;
+    return out;
+}
 
-    if (desc->initial_capacity>0){
-        sia_b32 grow_success = sia_pool_grow(pool, desc->initial_capacity);
-        if (!grow_success){
-            last_error.code = SIA_ERR_POOL_FULL;
-            last_error.msg = "Failed to allocate initial capacity for pool";
-            if (_sia_global_error_callback != NULL) {
-                _sia_global_error_callback(last_error);
-            }
-#ifndef SIA_NO_STDIO
-            else {
-                _sia_stderr_error_callback(last_error);
-            }
+void sia_trace_stop(void) {
+    _sia_trace_flush flush = { 0 };
+
+    _SIA_TRACE_LOCK();
+
+    sia_b32 stopped = _sia_trace_fd >= 0;
+    if (stopped) {
+        SIA_ATOMIC_SUB_U32(&_sia_trace_active, 1);
+
+        flush = _sia_trace_take(_sia_trace_buffers[_sia_trace_current],
+            sizeof(sia_trace_record) * _sia_trace_count, &_sia_trace_busy[_sia_trace_current]);
+        _sia_trace_count = 0;
+        _sia_trace_fd = -1;
     }
-#endif
-        return NULL;
+
+    _SIA_TRACE_UNLOCK();
+
+    // Also waits for the buffers that other threads are still writing, so the fd can be closed once this returns
+    if (stopped) {
+        _sia_trace_flush_write(&flush);
+    }
+}
+
+static void _sia_trace_create(si_arena* arena) {
+    if (arena == NULL) {
+        return;
     }
 
-    return pool;
+    _sia_trace_one((sia_trace_record){
+        .op = SIA_TRACE_CREATE,
+        .align = arena->_align,
+        .target = (sia_u64)arena,
+        .size = arena->_size,
+        .arg = arena->_block_size,
+        .pos = arena->_pos
+    }, SIA_TRUE);
+}
+
+si_arena* sia_create(const sia_desc* desc) {
+    si_arena* out = _sia_create_untraced(desc);
+    _sia_trace_create(out);
+    return out;
+}
+si_arena* sia_create_from_buffer(void* buf, sia_u64 size, const sia_desc* desc) {
+    si_arena* out = _sia_create_from_buffer_untraced(buf, size, desc);
+    _sia_trace_create(out);
+    return out;
+}
+void sia_destroy(si_arena* arena) {
+    _sia_trace_one((sia_trace_record){ .op = SIA_TRACE_DESTROY, .target = (sia_u64)arena }, SIA_TRUE);
+
+    _sia_trace_depth++;
+    _sia_destroy_untraced(arena);
+    _sia_trace_depth--;
 }
 
+void* _sia_push_traced(si_arena* arena, sia_u64 size, sia_u32 align) {
+    _sia_trace_depth++;
+    void* out = _sia_push_aligned_fast_untraced(arena, size, align);
+    _sia_trace_depth--;
+
+    _sia_trace_one((sia_trace_record){
+        .op = SIA_TRACE_PUSH,
+        .align = align,
+        .target = (sia_u64)arena,
+        .size = size,
+        .pos = arena->_pos,
+        .result = (sia_u64)out
+    }, SIA_FALSE);
+
+    return out;
+}
+void _sia_pop_traced(si_arena* arena, sia_u64 size) {
+    _sia_trace_depth++;
+    _sia_pop_fast_untraced(arena, size);
+    _sia_trace_depth--;
+
+    _sia_trace_one((sia_trace_record){
+        .op = SIA_TRACE_POP,
+        .target = (sia_u64)arena,
+        .size = size,
+        .pos = arena->_pos
+    }, SIA_FALSE);
+}
 void sia_pop_to(si_arena* arena, sia_u64 pos) {
-    sia_pop(arena, arena->_pos - pos);
+    _sia_trace_depth++;
+    _sia_pop_to_untraced(arena, pos);
+    _sia_trace_depth--;
+
+    _sia_trace_one((sia_trace_record){
+        .op = SIA_TRACE_POP_TO,
+        .target = (sia_u64)arena,
+        .size = pos,
+        .pos = arena->_pos
+    }, SIA_FALSE);
+}
+void sia_reset(si_arena* arena) {
+    _sia_trace_depth++;
+    _sia_reset_untraced(arena);
+    _sia_trace_depth--;
+
+    _sia_trace_one((sia_trace_record){ .op = SIA_TRACE_RESET, .target = (sia_u64)arena, .pos = arena->_pos }, SIA_FALSE);
+}
+
+void* sia_realloc_aligned(si_arena* arena, void* ptr, sia_u64 old_size, sia_u64 new_size, sia_u32 align) {
+    _sia_trace_depth++;
+    void* out = _sia_realloc_aligned_untraced(arena, ptr, old_size, new_size, align);
+    _sia_trace_depth--;
+
+    if (arena != NULL) {
+        _sia_trace_one((sia_trace_record){
+            .op = SIA_TRACE_REALLOC,
+            .align = align,
+            .target = (sia_u64)arena,
+            .size = new_size,
+            .arg = old_size,
+            .pos = arena->_pos,
+            .ptr = (sia_u64)ptr,
+            .result = (sia_u64)out
+        }, SIA_FALSE);
+    }
+
+    return out;
 }
 
 sia_temp sia_temp_begin(si_arena* arena) {
-    return (sia_temp){
-        .arena = arena,
-        ._pos = arena->_pos
-    };
+    sia_temp out = _sia_temp_begin_untraced(arena);
+    _sia_trace_one((sia_trace_record){ .op = SIA_TRACE_TEMP_BEGIN, .target = (sia_u64)arena, .pos = arena->_pos }, SIA_FALSE);
+    return out;
 }
 void sia_temp_end(sia_temp temp) {
-    sia_pop_to(temp.arena, temp._pos);
+    _sia_trace_depth++;
+    _sia_temp_end_untraced(temp);
+    _sia_trace_depth--;
+
+    _sia_trace_one((sia_trace_record){
+        .op = SIA_TRACE_TEMP_END,
+        .target = (sia_u64)temp.arena,
+        .size = temp._pos,
+        .pos = temp.arena->_pos
+    }, SIA_FALSE);
 }
 
-#ifndef SIA_SCRATCH_COUNT
-#   define SIA_SCRATCH_COUNT 2
-#endif
+sia_pool* sia_pool_create(const sia_pool_desc* desc) {
+    _sia_trace_depth++;
+    sia_pool* out = _sia_pool_create_untraced(desc);
+    _sia_trace_depth--;
+
+    if (out != NULL) {
+        _sia_trace_one((sia_trace_record){
+            .op = SIA_TRACE_POOL_CREATE,
+            .align = out->align,
+            .target = (sia_u64)out,
+            .size = out->block_size,
+            .arg = desc->initial_capacity,
+            .pos = out->arena->_pos,
+            .ptr = (sia_u64)out->arena,
+            .result = out->flags
+        }, SIA_FALSE);
+    }
 
-#ifndef SIA_NO_STDIO
-static void _sia_scratch_on_error(sia_error err) {
-    fprintf(stderr, "SIA Scratch Error %u: %s\n", err.code, err.msg);
+    return out;
 }
-#endif
+void sia_pool_destroy(sia_pool* pool) {
+    _sia_trace_depth++;
+    _sia_pool_destroy_untraced(pool);
+    _sia_trace_depth--;
 
-static SIA_THREAD_VAR sia_desc _sia_scratch_desc = {
-    .desired_max_size = SIA_MiB(64),
-    .desired_block_size = SIA_KiB(256),
-#ifndef SIA_NO_STDIO
-    .error_callback = _sia_scratch_on_error,
-#endif
-};
-static SIA_THREAD_VAR si_arena* _sia_scratch_arenas[SIA_SCRATCH_COUNT] = { 0 };
+    _sia_trace_one((sia_trace_record){ .op = SIA_TRACE_POOL_DESTROY, .target = (sia_u64)pool }, SIA_FALSE);
+}
+sia_b32 sia_pool_grow(sia_pool* pool, sia_u64 num_blocks) {
+    _sia_trace_depth++;
+    sia_b32 out = _sia_pool_grow_untraced(pool, num_blocks);
+    _sia_trace_depth--;
+
+    _sia_trace_one((sia_trace_record){
+        .op = SIA_TRACE_POOL_GROW,
+        .target = (sia_u64)pool,
+        .size = num_blocks,
+        .pos = pool->arena->_pos,
+        .result = out
+    }, SIA_FALSE);
 
-void sia_scratch_set_desc(const sia_desc* desc) {
-    if (_sia_scratch_arenas[0] == NULL) {
-        _sia_scratch_desc = (sia_desc){
-            .desired_max_size = desc->desired_max_size,
-            .desired_block_size = desc->desired_block_size,
-            .align = desc->align,
-            .error_callback = desc->error_callback
-        };
-    }
+    return out;
 }
-sia_temp sia_scratch_get(si_arena** conflicts, sia_u32 num_conflicts) {
-    if (_sia_scratch_arenas[0] == NULL) {
-        for (sia_u32 i = 0; i < SIA_SCRATCH_COUNT; i++) {
-            _sia_scratch_arenas[i] = sia_create(&_sia_scratch_desc);
-        }
-    }
+void* sia_pool_alloc(sia_pool* pool) {
+    _sia_trace_depth++;
+    void* out = _sia_pool_alloc_untraced(pool);
+    _sia_trace_depth--;
+
+    _sia_trace_one((sia_trace_record){
+        .op = SIA_TRACE_POOL_ALLOC,
+        .target = (sia_u64)pool,
+        .pos = pool->arena->_pos,
+        .result = (sia_u64)out
+    }, SIA_FALSE);
 
-    sia_temp out = { 0 };
+    return out;
+}
+void sia_pool_free(sia_pool* pool, void* ptr) {
+    _sia_trace_depth++;
+    _sia_pool_free_untraced(pool, ptr);
+    _sia_trace_depth--;
 
-    for (sia_u32 i = 0; i < SIA_SCRATCH_COUNT; i++) {
-        si_arena* arena = _sia_scratch_arenas[i];
+    _sia_trace_one((sia_trace_record){ .op = SIA_TRACE_POOL_FREE, .target = (sia_u64)pool, .ptr = (sia_u64)ptr }, SIA_FALSE);
+}
 
-        sia_b32 in_conflict = SIA_FALSE;
-        for (sia_u32 j = 0; j < num_conflicts; j++) {
-            if (arena == conflicts[j]) {
-                in_conflict = SIA_TRUE;
-                break;
-            }
+// Batches are one record followed by a SIA_TRACE_PTR record for every pointer,
+// all written under the same lock so other threads can not split them
+sia_b32 sia_pool_alloc_n(sia_pool* pool, void** ptrs, sia_u64 num) {
+    _sia_trace_depth++;
+    sia_b32 out = _sia_pool_alloc_n_untraced(pool, ptrs, num);
+    _sia_trace_depth--;
+
+    if (_sia_trace_begin(SIA_FALSE)) {
+        _sia_trace_add((sia_trace_record){
+            .op = SIA_TRACE_POOL_ALLOC_N,
+            .target = (sia_u64)pool,
+            .size = num,
+            .pos = pool->arena->_pos,
+            .result = out
+        });
+        for (sia_u64 i = 0; out && i < num; i++) {
+            _sia_trace_add((sia_trace_record){ .op = SIA_TRACE_PTR, .target = (sia_u64)pool, .result = (sia_u64)ptrs[i] });
         }
-        if (in_conflict) { continue; }
-
-        out = sia_temp_begin(arena);
+        _sia_trace_end();
     }
 
     return out;
 }
-void sia_scratch_release(sia_temp scratch) {
-    sia_temp_end(scratch);
+void sia_pool_free_n(sia_pool* pool, void** ptrs, sia_u64 num) {
+    // The pointers are recorded first, since freeing can not change them
+    if (_sia_trace_begin(SIA_FALSE)) {
+        _sia_trace_add((sia_trace_record){ .op = SIA_TRACE_POOL_FREE_N, .target = (sia_u64)pool, .size = num });
+        for (sia_u64 i = 0; i < num; i++) {
+            _sia_trace_add((sia_trace_record){ .op = SIA_TRACE_PTR, .target = (sia_u64)pool, .ptr = (sia_u64)ptrs[i] });
+        }
+        _sia_trace_end();
+    }
+
+    _sia_trace_depth++;
+    _sia_pool_free_n_untraced(pool, ptrs, num);
+    _sia_trace_depth--;
 }
 
+#endif // SIA_ENABLE_TRACE
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,299 @@
+#ifndef SI_ARENA_HPP
+#define SI_ARENA_HPP
+
+/*
+C++ helpers for si_arena.h
+
+The implementation still has to be compiled somewhere, see si_arena.h
+*/
+
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#   if __has_include(<coroutine>)
+#       define SIA_HAS_COROUTINES
+#   endif
+#endif
+
+#ifdef SIA_HAS_COROUTINES
+#include <coroutine>
+#include <exception>
+#include <optional>
+#endif
+
+#include "si_arena.h"
+
+namespace sia {
+
+template <typename T>
+void _destroy(void* ptr) {
+    static_cast<T*>(ptr)->~T();
+}
+
+// Constructs a T in the arena, forwarding args to the constructor.
+// If T is not trivially destructible, the destructor is registered as a cleanup,
+// so it runs when the arena pops the object, resets, or is destroyed.
+// Returns nullptr if the arena is out of memory.
+template <typename T, typename... Args>
+T* emplace(si_arena* arena, Args&&... args) {
+    sia_u64 start_pos = sia_get_pos(arena);
+
+    void* mem = sia_push_aligned(arena, sizeof(T), alignof(T));
+    if (mem == nullptr) {
+        return nullptr;
+    }
+
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+    T* obj = nullptr;
+    try {
+        obj = ::new (mem) T(std::forward<Args>(args)...);
+    } catch (...) {
+        sia_pop_to(arena, start_pos);
+        throw;
+    }
+#else
+    T* obj = ::new (mem) T(std::forward<Args>(args)...);
+#endif
+
+    if (!std::is_trivially_destructible<T>::value) {
+        if (!sia_add_cleanup(arena, obj, &_destroy<T>)) {
+            obj->~T();
+            sia_pop_to(arena, start_pos);
+            return nullptr;
+        }
+    }
+
+    return obj;
+}
+
+#ifdef SIA_HAS_COROUTINES
+
+// Coroutine argument that puts the frame in pool when it fits in a block, and in arena otherwise.
+// arena defaults to the arena of the pool
+struct frame_allocator {
+    si_arena* arena = nullptr;
+    sia_pool* pool = nullptr;
+};
+
+// In front of every frame, so that operator delete knows where the frame came from
+struct _frame_header {
+    sia_pool* pool;
+    // 0 for the heap, 1 for an arena, 2 for a pool
+    sia_u32 kind;
+};
+
+// Frames get the alignment that operator new would give them
+constexpr std::size_t _frame_align = __STDCPP_DEFAULT_NEW_ALIGNMENT__ > sizeof(_frame_header) ?
+    __STDCPP_DEFAULT_NEW_ALIGNMENT__ : sizeof(_frame_header);
+
+// The first argument that names an allocator wins
+inline bool _frame_found(const frame_allocator& out) {
+    return out.arena != nullptr || out.pool != nullptr;
+}
+inline void _frame_source(frame_allocator& out, const frame_allocator& alloc) {
+    if (!_frame_found(out)) { out = alloc; }
+}
+inline void _frame_source(frame_allocator& out, si_arena* arena) {
+    if (!_frame_found(out)) { out.arena = arena; }
+}
+inline void _frame_source(frame_allocator& out, sia_pool* pool) {
+    if (!_frame_found(out)) { out.pool = pool; }
+}
+inline void _frame_source(frame_allocator& out, const sia_temp& temp) {
+    if (!_frame_found(out)) { out.arena = temp.arena; }
+}
+template <typename T>
+void _frame_source(frame_allocator&, const T&) {}
+
+inline void* _frame_alloc(std::size_t size, frame_allocator source) {
+    std::size_t total = size + _frame_align;
+    _frame_header* header = nullptr;
+    sia_u32 kind = 0;
+
+    if (source.pool != nullptr && source.pool->align >= _frame_align && total <= sia_pool_get_block_size(source.pool)) {
+        header = static_cast<_frame_header*>(sia_pool_alloc(source.pool));
+        kind = 2;
+    }
+
+    si_arena* arena = source.arena;
+    if (arena == nullptr && source.pool != nullptr) {
+        arena = source.pool->arena;
+    }
+    if (header == nullptr && arena != nullptr) {
+        header = static_cast<_frame_header*>(sia_push_aligned(arena, total, _frame_align));
+        kind = 1;
+    }
+
+    // No allocator, or it is out of memory. The frame still has to go somewhere
+    if (header == nullptr) {
+        header = static_cast<_frame_header*>(::operator new(total));
+        kind = 0;
+    }
+
+    header->pool = source.pool;
+    header->kind = kind;
+    return reinterpret_cast<sia_u8*>(header) + _frame_align;
+}
+
+inline void _frame_free(void* ptr) {
+    _frame_header* header = reinterpret_cast<_frame_header*>(static_cast<sia_u8*>(ptr) - _frame_align);
+    if (header->kind == 2) {
+        sia_pool_free(header->pool, header);
+    } else if (header->kind == 0) {
+        ::operator delete(header);
+    }
+    // Arena frames go away when the arena pops them
+}
+
+// Base for promise types that puts the coroutine frame in the first si_arena*, sia_pool*,
+// sia_temp, or frame_allocator argument of the coroutine, and on the heap without one.
+// An arena frame is gone once the arena pops it, so the coroutine has to be destroyed first.
+// The arena of the current scope is never used implicitly, pass sia_scope_get() to use it
+struct frame_promise {
+    template <typename... Args>
+    static void* operator new(std::size_t size, const Args&... args) {
+        frame_allocator source;
+        (_frame_source(source, args), ...);
+        return _frame_alloc(size, source);
+    }
+    static void* operator new(std::size_t size) {
+        return _frame_alloc(size, frame_allocator{});
+    }
+    static void operator delete(void* ptr, std::size_t size) {
+        (void)size;
+        _frame_free(ptr);
+    }
+};
+
+template <typename T = void>
+class task;
+
+struct _task_promise_base : frame_promise {
+    std::coroutine_handle<> continuation;
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+    std::exception_ptr exception;
+#endif
+
+    // Tasks are lazy, they start when they are awaited or started
+    std::suspend_always initial_suspend() noexcept { return {}; }
+
+    struct final_awaiter {
+        bool await_ready() noexcept { return false; }
+        template <typename P>
+        std::coroutine_handle<> await_suspend(std::coroutine_handle<P> handle) noexcept {
+            std::coroutine_handle<> next = handle.promise().continuation;
+            return next ? next : std::noop_coroutine();
+        }
+        void await_resume() noexcept {}
+    };
+    final_awaiter final_suspend() noexcept { return {}; }
+
+    void unhandled_exception() {
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+        exception = std::current_exception();
+#else
+        std::terminate();
+#endif
+    }
+
+    void _rethrow() {
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+#endif
+    }
+};
+
+template <typename T>
+struct _task_promise : _task_promise_base {
+    std::optional<T> value;
+
+    task<T> get_return_object() noexcept;
+    template <typename U = T>
+    void return_value(U&& result) {
+        value.emplace(std::forward<U>(result));
+    }
+    T _take() {
+        _rethrow();
+        return std::move(*value);
+    }
+};
+
+template <>
+struct _task_promise<void> : _task_promise_base {
+    task<void> get_return_object() noexcept;
+    void return_void() noexcept {}
+    void _take() {
+        _rethrow();
+    }
+};
+
+// Lazy coroutine that returns a T, with its frame placed by frame_promise.
+// Awaiting a task starts it, and resumes the awaiting coroutine when it finishes
+template <typename T>
+class task {
+public:
+    using promise_type = _task_promise<T>;
+
+    task() noexcept = default;
+    explicit task(std::coroutine_handle<promise_type> handle) noexcept : _handle(handle) {}
+    task(task&& other) noexcept : _handle(std::exchange(other._handle, {})) {}
+    task& operator=(task&& other) noexcept {
+        if (this != &other) {
+            if (_handle) { _handle.destroy(); }
+            _handle = std::exchange(other._handle, {});
+        }
+        return *this;
+    }
+    task(const task&) = delete;
+    task& operator=(const task&) = delete;
+    ~task() {
+        if (_handle) { _handle.destroy(); }
+    }
+
+    // Runs the task until it first suspends, for the task at the top of a tree
+    void start() {
+        if (_handle && !_handle.done()) { _handle.resume(); }
+    }
+    bool done() const noexcept {
+        return !_handle || _handle.done();
+    }
+    // Result of a finished task, rethrows what the coroutine threw
+    T result() {
+        return _handle.promise()._take();
+    }
+
+    auto operator co_await() noexcept {
+        struct awaiter {
+            std::coroutine_handle<promise_type> handle;
+
+            bool await_ready() noexcept { return !handle || handle.done(); }
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+                handle.promise().continuation = awaiting;
+                return handle;
+            }
+            T await_resume() { return handle.promise()._take(); }
+        };
+        return awaiter{ _handle };
+    }
+
+private:
+    std::coroutine_handle<promise_type> _handle;
+};
+
+template <typename T>
+task<T> _task_promise<T>::get_return_object() noexcept {
+    return task<T>(std::coroutine_handle<_task_promise<T>>::from_promise(*this));
+}
+inline task<void> _task_promise<void>::get_return_object() noexcept {
+    return task<void>(std::coroutine_handle<_task_promise<void>>::from_promise(*this));
+}
+
+#endif // SIA_HAS_COROUTINES
+
+} // namespace sia
+
+#endif // SI_ARENA_HPP
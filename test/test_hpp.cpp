@@ -0,0 +1,378 @@
+// Tests for si_arena.hpp, see test_hpp.sh
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+
+#include "../si_arena.hpp"
+
+#define TEST_ASSERT(b, m) \
+    if (!(b)) { printf("\x1b[35mAssert Failed: " m "\x1b[0m\n"); return false; }
+
+// Counts every global operator new, to tell when a frame went on the heap
+static int num_heap_allocs = 0;
+
+void* operator new(std::size_t size) {
+    num_heap_allocs++;
+    void* out = std::malloc(size == 0 ? 1 : size);
+    if (out == nullptr) {
+        std::abort();
+    }
+    return out;
+}
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+static void quiet_error_callback(sia_error err) {
+    (void)err;
+}
+
+static si_arena* create_arena(void) {
+    sia_desc desc = {};
+    desc.desired_max_size = SIA_MiB(4);
+    desc.desired_block_size = SIA_KiB(64);
+    desc.error_callback = quiet_error_callback;
+    return sia_create(&desc);
+}
+
+static int num_destroyed = 0;
+
+struct tracked {
+    int value;
+    explicit tracked(int v) : value(v) {}
+    ~tracked() { num_destroyed++; }
+};
+
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+struct throws_in_ctor {
+    long long data[4];
+    ~throws_in_ctor() { num_destroyed++; }
+    explicit throws_in_ctor(int v) {
+        data[0] = v;
+        throw v;
+    }
+};
+#endif
+
+bool test_emplace(void) {
+    si_arena* arena = create_arena();
+    TEST_ASSERT(arena != nullptr, "emplace create");
+
+    sia_u64 start_pos = sia_get_pos(arena);
+    num_destroyed = 0;
+
+    int* num = sia::emplace<int>(arena, 42);
+    TEST_ASSERT(num != nullptr && *num == 42, "emplace trivial");
+
+    tracked* obj = sia::emplace<tracked>(arena, 7);
+    TEST_ASSERT(obj != nullptr && obj->value == 7, "emplace object");
+
+    sia_pop_to(arena, start_pos);
+    TEST_ASSERT(num_destroyed == 1, "emplace destructor on pop");
+
+    sia_destroy(arena);
+    return true;
+}
+
+bool test_emplace_throw(void) {
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+    si_arena* arena = create_arena();
+    TEST_ASSERT(arena != nullptr, "emplace throw create");
+
+    sia_u64 start_pos = sia_get_pos(arena);
+    num_destroyed = 0;
+
+    int caught = 0;
+    try {
+        sia::emplace<throws_in_ctor>(arena, 5);
+    } catch (int v) {
+        caught = v;
+    }
+    TEST_ASSERT(caught == 5, "emplace rethrows");
+    TEST_ASSERT(sia_get_pos(arena) == start_pos, "emplace throw rolls back");
+
+    // No cleanup was registered for the object that was never constructed
+    sia_reset(arena);
+    TEST_ASSERT(num_destroyed == 0, "emplace throw no cleanup");
+
+    sia_destroy(arena);
+#endif
+    return true;
+}
+
+bool test_emplace_no_cleanup(void) {
+    alignas(16) static sia_u8 buffer[SIA_KiB(4)];
+    sia_desc desc = {};
+    desc.align = 1;
+    desc.error_callback = quiet_error_callback;
+    si_arena* arena = sia_create_from_buffer(buffer, sizeof(buffer), &desc);
+    TEST_ASSERT(arena != nullptr, "emplace no cleanup create");
+
+    // Leaves room for the object, but not for its cleanup record
+    sia_u64 filler = sia_get_size(arena) - sizeof(tracked) - sia_get_pos(arena);
+    TEST_ASSERT(sia_push(arena, filler) != nullptr, "emplace no cleanup fill");
+
+    sia_u64 before = sia_get_pos(arena);
+    num_destroyed = 0;
+    tracked* obj = sia::emplace<tracked>(arena, 3);
+    TEST_ASSERT(obj == nullptr, "emplace no cleanup fails");
+    TEST_ASSERT(num_destroyed == 1, "emplace no cleanup destroys");
+    TEST_ASSERT(sia_get_pos(arena) == before, "emplace no cleanup rolls back");
+    TEST_ASSERT(sia_get_error(arena).code == SIA_ERR_OUT_OF_MEMORY, "emplace no cleanup error");
+
+    // Trivially destructible types need no record, so they still fit
+    int* num = sia::emplace<int>(arena, 9);
+    TEST_ASSERT(num != nullptr && *num == 9, "emplace trivial fits");
+
+    sia_destroy(arena);
+    return true;
+}
+
+#ifdef SIA_HAS_COROUTINES
+
+static sia::task<int> leaf(si_arena* arena, int x) {
+    (void)arena;
+    co_return x * 2;
+}
+
+static sia::task<int> parent(si_arena* arena, int x) {
+    int a = co_await leaf(arena, x);
+    int b = co_await leaf(arena, x + 1);
+    co_return a + b;
+}
+
+static sia::task<std::string> pooled(sia_pool* pool, int x) {
+    (void)pool;
+    co_return std::to_string(x);
+}
+
+static sia::task<int> with_allocator(sia::frame_allocator alloc, int x) {
+    std::string text = co_await pooled(alloc.pool, x);
+    co_return (int)text.size();
+}
+
+static sia::task<> no_allocator(int* out) {
+    *out = 7;
+    co_return;
+}
+
+static sia::task<int> large_frame(sia_pool* pool) {
+    (void)pool;
+    volatile char local[1024];
+    local[0] = 1;
+    co_await std::suspend_always{};
+    co_return local[0];
+}
+
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+static sia::task<int> thrower(si_arena* arena) {
+    (void)arena;
+    throw 5;
+    co_return 1;
+}
+
+static sia::task<int> catcher(si_arena* arena) {
+    try {
+        co_await thrower(arena);
+    } catch (int v) {
+        co_return v;
+    }
+    co_return 0;
+}
+#endif
+
+static sia_pool* create_pool(si_arena* arena, sia_u64 block_size) {
+    sia_pool_desc desc = {};
+    desc.arena = arena;
+    desc.block_size = block_size;
+    desc.align = 16;
+    desc.initial_capacity = 8;
+    return sia_pool_create(&desc);
+}
+
+bool test_coro_arena(void) {
+    si_arena* arena = create_arena();
+    TEST_ASSERT(arena != nullptr, "coro arena create");
+
+    sia_temp temp = sia_temp_begin(arena);
+    sia_u64 start_pos = sia_get_pos(arena);
+    int heap_before = num_heap_allocs;
+    {
+        sia::task<int> task = parent(arena, 5);
+        TEST_ASSERT(sia_get_pos(arena) > start_pos, "coro frame in arena");
+        TEST_ASSERT(!task.done(), "coro lazy");
+
+        // Awaiting resumes the parent through its continuation
+        task.start();
+        TEST_ASSERT(task.done() && task.result() == 22, "coro continuation");
+    }
+    TEST_ASSERT(num_heap_allocs == heap_before, "coro arena no heap");
+    sia_temp_end(temp);
+    TEST_ASSERT(sia_get_pos(arena) == start_pos, "coro arena released");
+
+    sia_destroy(arena);
+    return true;
+}
+
+bool test_coro_pool(void) {
+    si_arena* arena = create_arena();
+    sia_pool* pool = create_pool(arena, 512);
+    TEST_ASSERT(pool != nullptr, "coro pool create");
+
+    sia_u64 arena_pos = sia_get_pos(arena);
+    {
+        sia::task<int> task = with_allocator(sia::frame_allocator{ nullptr, pool }, 12345);
+        TEST_ASSERT(sia_pool_get_used(pool) == 1, "coro frame in pool");
+        task.start();
+        TEST_ASSERT(task.done() && task.result() == 5, "coro pool result");
+    }
+    TEST_ASSERT(sia_pool_get_used(pool) == 0, "coro pool frame freed");
+    TEST_ASSERT(sia_get_pos(arena) == arena_pos, "coro pool no arena");
+
+    // A frame larger than a block goes in the arena of the pool
+    sia_pool* small = create_pool(arena, 64);
+    arena_pos = sia_get_pos(arena);
+    {
+        sia::task<int> task = large_frame(small);
+        TEST_ASSERT(sia_pool_get_used(small) == 0, "coro pool fallback");
+        TEST_ASSERT(sia_get_pos(arena) > arena_pos, "coro pool fallback arena");
+        task.start();
+        TEST_ASSERT(!task.done(), "coro suspended");
+    }
+
+    sia_destroy(arena);
+    return true;
+}
+
+bool test_coro_heap(void) {
+    int value = 0;
+    int heap_before = num_heap_allocs;
+    {
+        sia::task<> task = no_allocator(&value);
+        TEST_ASSERT(num_heap_allocs == heap_before + 1, "coro frame on heap");
+        task.start();
+    }
+    TEST_ASSERT(value == 7, "coro heap ran");
+
+    // The arena of the current scope is only used when passed in
+    sia_scope_begin();
+    si_arena* scope = sia_scope_get();
+    sia_u64 scope_pos = sia_get_pos(scope);
+    sia::task<> outlives = no_allocator(&value);
+    TEST_ASSERT(sia_get_pos(scope) == scope_pos, "coro scope not implicit");
+    sia_scope_end();
+    outlives.start();
+    TEST_ASSERT(outlives.done(), "coro outlives scope");
+
+    return true;
+}
+
+bool test_coro_exception(void) {
+#if defined(__cpp_exceptions) || defined(_CPPUNWIND)
+    si_arena* arena = create_arena();
+
+    {
+        sia::task<int> task = catcher(arena);
+        task.start();
+        TEST_ASSERT(task.done() && task.result() == 5, "coro exception awaited");
+    }
+    {
+        sia::task<int> task = thrower(arena);
+        task.start();
+        int caught = 0;
+        try {
+            task.result();
+        } catch (int v) {
+            caught = v;
+        }
+        TEST_ASSERT(caught == 5, "coro exception result");
+    }
+
+    sia_destroy(arena);
+#endif
+    return true;
+}
+
+bool test_coro_task(void) {
+    si_arena* arena = create_arena();
+    sia_pool* pool = create_pool(arena, 512);
+
+    sia::task<int> empty;
+    TEST_ASSERT(empty.done(), "coro empty task");
+
+    sia::task<int> first = with_allocator(sia::frame_allocator{ nullptr, pool }, 1);
+    sia::task<int> second = with_allocator(sia::frame_allocator{ nullptr, pool }, 22);
+    TEST_ASSERT(sia_pool_get_used(pool) == 2, "coro two frames");
+
+    // Move assignment destroys the frame it replaces
+    first = std::move(second);
+    TEST_ASSERT(sia_pool_get_used(pool) == 1, "coro move assign");
+    TEST_ASSERT(second.done(), "coro moved from");
+
+    sia::task<int> moved(std::move(first));
+    moved.start();
+    TEST_ASSERT(moved.done() && moved.result() == 2, "coro moved task");
+
+    moved = sia::task<int>();
+    TEST_ASSERT(sia_pool_get_used(pool) == 0, "coro destroy");
+
+    sia_destroy(arena);
+    return true;
+}
+
+#endif // SIA_HAS_COROUTINES
+
+#ifdef SIA_HAS_COROUTINES
+#   define TEST_CORO_XLIST \
+        X(CORO_ARENA, coro_arena) \
+        X(CORO_POOL, coro_pool) \
+        X(CORO_HEAP, coro_heap) \
+        X(CORO_EXCEPTION, coro_exception) \
+        X(CORO_TASK, coro_task)
+#else
+#   define TEST_CORO_XLIST
+#endif
+
+#define TEST_XLIST \
+    X(EMPLACE, emplace) \
+    X(EMPLACE_THROW, emplace_throw) \
+    X(EMPLACE_NO_CLEANUP, emplace_no_cleanup) \
+    TEST_CORO_XLIST
+
+enum {
+#define X(name, func_name) TEST_##name,
+    TEST_XLIST
+#undef X
+    TEST_COUNT
+};
+
+static const char* test_names[TEST_COUNT] = {
+#define X(name, func_name) #name,
+    TEST_XLIST
+#undef X
+};
+
+static bool (*test_funcs[TEST_COUNT])(void) = {
+#define X(name, func_name) test_##func_name,
+    TEST_XLIST
+#undef X
+};
+
+int main(void) {
+    int passed = 0;
+    for (int i = 0; i < TEST_COUNT; i++) {
+        if (test_funcs[i]()) {
+            passed++;
+        } else {
+            printf("\x1b[31mTest %s failed\x1b[0m\n", test_names[i]);
+        }
+    }
+
+    printf("Test Results: %d/%d passed.\n", passed, TEST_COUNT);
+    return passed == TEST_COUNT ? 0 : 1;
+}
@@ -0,0 +1,17 @@
+#!/bin/sh
+# Builds and runs test_hpp.cpp, the tests for si_arena.hpp (needs C++20 for the coroutine tests)
+set -e
+
+root="$(cd "$(dirname "$0")/.." && pwd)"
+out="${TMPDIR:-/tmp}/sia_hpp_test.$$"
+mkdir -p "$out"
+trap 'rm -rf "$out"' EXIT
+
+cc=${CC:-cc}
+cxx=${CXX:-c++}
+# The implementation is C, so it gets its own object
+$cc -std=gnu11 -O1 -g $CFLAGS -DSI_ARENA_IMPL -x c -c -o "$out/si_arena.o" "$root/si_arena.h"
+$cxx -std=c++20 -O1 -g $CXXFLAGS -c -o "$out/test_hpp.o" "$root/test/test_hpp.cpp"
+$cxx $CXXFLAGS -o "$out/test_hpp" "$out/test_hpp.o" "$out/si_arena.o" -lpthread
+
+"$out/test_hpp"
@@ -0,0 +1,143 @@
+// Runs under LD_PRELOAD with tools/sia_preload.c, see test_preload.sh
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dlfcn.h>
+#include <malloc.h>
+#include <pthread.h>
+
+#define TEST_ASSERT(b, m) \
+    if (!(b)) { printf("\x1b[35mAssert Failed: " m "\x1b[0m\n"); return false; }
+
+typedef void (scope_func)(void);
+static scope_func* scope_begin;
+static scope_func* scope_end;
+
+bool test_scope_memory(void) {
+    scope_begin();
+    char* a = (char*)malloc(64);
+    char* b = (char*)malloc(64);
+    TEST_ASSERT(a != NULL && b != NULL, "scope malloc");
+    strcpy(a, "scope");
+    free(a);
+
+    // Scope memory is never reused before the scope ends
+    char* c = (char*)malloc(64);
+    TEST_ASSERT(c != a, "scope free is a no-op");
+
+    strcpy(b, "scope");
+    char* grown = (char*)realloc(b, 4096);
+    TEST_ASSERT(grown != NULL && strcmp(grown, "scope") == 0, "scope realloc");
+
+    int* zeros = (int*)calloc(128, sizeof(int));
+    bool all_zero = true;
+    for (int i = 0; i < 128; i++) {
+        all_zero = all_zero && zeros[i] == 0;
+    }
+    TEST_ASSERT(all_zero, "scope calloc");
+    scope_end();
+
+    return true;
+}
+
+bool test_real_realloc_in_scope(void) {
+    char* heap = (char*)malloc(32);
+    TEST_ASSERT(heap != NULL, "real malloc");
+    strcpy(heap, "hello world");
+
+    // The pointer has to outlive the scope it was grown in
+    scope_begin();
+    heap = (char*)realloc(heap, 4096);
+    scope_end();
+
+    scope_begin();
+    char* later = (char*)malloc(4096);
+    memset(later, 'Z', 4096);
+    scope_end();
+
+    TEST_ASSERT(heap != NULL && strcmp(heap, "hello world") == 0, "real realloc in scope");
+    free(heap);
+
+    return true;
+}
+
+bool test_outside_scope(void) {
+    char* heap = (char*)malloc(100);
+    TEST_ASSERT(heap != NULL, "malloc outside scope");
+    heap = (char*)realloc(heap, 1000);
+    TEST_ASSERT(heap != NULL, "realloc outside scope");
+    free(heap);
+
+    return true;
+}
+
+static void* free_on_thread(void* ptr) {
+    // Scope memory of another thread is still told apart from real allocations
+    size_t size = malloc_usable_size(ptr);
+    free(ptr);
+    return (void*)size;
+}
+
+bool test_other_thread(void) {
+    scope_begin();
+    char* scoped = (char*)malloc(48);
+    TEST_ASSERT(scoped != NULL, "other thread malloc");
+    strcpy(scoped, "scope");
+
+    pthread_t thread;
+    void* size = NULL;
+    TEST_ASSERT(pthread_create(&thread, NULL, free_on_thread, scoped) == 0, "other thread create");
+    pthread_join(thread, &size);
+    TEST_ASSERT((size_t)size == 48, "other thread usable size");
+    TEST_ASSERT(strcmp(scoped, "scope") == 0, "other thread free is a no-op");
+    scope_end();
+
+    return true;
+}
+
+#define TEST_XLIST \
+    X(SCOPE_MEMORY, scope_memory) \
+    X(REAL_REALLOC_IN_SCOPE, real_realloc_in_scope) \
+    X(OUTSIDE_SCOPE, outside_scope) \
+    X(OTHER_THREAD, other_thread)
+
+enum {
+#define X(name, func_name) TEST_##name,
+    TEST_XLIST
+#undef X
+    TEST_COUNT
+};
+
+static const char* test_names[TEST_COUNT] = {
+#define X(name, func_name) #name,
+    TEST_XLIST
+#undef X
+};
+
+static bool (*test_funcs[TEST_COUNT])(void) = {
+#define X(name, func_name) test_##func_name,
+    TEST_XLIST
+#undef X
+};
+
+int main(void) {
+    scope_begin = (scope_func*)dlsym(RTLD_DEFAULT, "sia_scope_begin");
+    scope_end = (scope_func*)dlsym(RTLD_DEFAULT, "sia_scope_end");
+    if (scope_begin == NULL || scope_end == NULL) {
+        printf("sia_scope_begin not found, run with LD_PRELOAD=libsia_preload.so\n");
+        return 1;
+    }
+
+    int passed = 0;
+    for (int i = 0; i < TEST_COUNT; i++) {
+        if (test_funcs[i]()) {
+            passed++;
+        } else {
+            printf("\x1b[31mTest %s failed\x1b[0m\n", test_names[i]);
+        }
+    }
+
+    printf("Test Results: %d/%d passed.\n", passed, TEST_COUNT);
+    return passed == TEST_COUNT ? 0 : 1;
+}
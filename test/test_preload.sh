@@ -0,0 +1,14 @@
+#!/bin/sh
+# Builds tools/sia_preload.c and runs test_preload.c under LD_PRELOAD (Linux only)
+set -e
+
+root="$(cd "$(dirname "$0")/.." && pwd)"
+out="${TMPDIR:-/tmp}/sia_preload_test.$$"
+mkdir -p "$out"
+trap 'rm -rf "$out"' EXIT
+
+cc=${CC:-cc}
+$cc -shared -fPIC -O2 -ftls-model=initial-exec -o "$out/libsia_preload.so" "$root/tools/sia_preload.c" -ldl
+$cc -O1 -g -fno-builtin -o "$out/test_preload" "$root/test/test_preload.c" -ldl -lpthread
+
+LD_PRELOAD="$out/libsia_preload.so" "$out/test_preload"
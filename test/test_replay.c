@@ -0,0 +1,93 @@
+// Records a trace for tools/sia_replay.c, see test_replay.sh
+#include <stdio.h>
+#include <stdbool.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define SIA_ENABLE_TRACE
+#define SI_ARENA_IMPL
+#include "../si_arena.h"
+
+#define NUM_THREADS 4
+// More records than SIA_TRACE_BUFFER_SIZE, so the buffers are swapped while other threads add to them
+#define NUM_PUSHES 3000
+
+static void* churn(void* user) {
+    (void)user;
+    si_arena* arena = sia_create(&(sia_desc){ .desired_max_size = SIA_MiB(1) });
+    for (int i = 0; i < NUM_PUSHES; i++) {
+        sia_push(arena, 16);
+        sia_pop(arena, 16);
+    }
+    sia_destroy(arena);
+    return NULL;
+}
+
+// Every kind of operation once, returns the number of records it made
+static sia_u64 record_ops(void) {
+    si_arena* arena = sia_create(&(sia_desc){ .desired_max_size = SIA_MiB(16), .desired_block_size = SIA_KiB(64) });
+    sia_u64 start = sia_get_pos(arena);
+
+    void* data = sia_push(arena, 100);
+    data = sia_realloc(arena, data, 100, 4000);
+    sia_temp temp = sia_temp_begin(arena);
+    sia_push(arena, SIA_KiB(128));
+    sia_temp_end(temp);
+    sia_pop_to(arena, start);
+
+    sia_pool* pool = sia_pool_create(&(sia_pool_desc){ .arena = arena, .block_size = 32, .initial_capacity = 4 });
+    void* ptrs[8];
+    void* one = sia_pool_alloc(pool);
+    sia_pool_alloc_n(pool, ptrs, 8);
+    sia_pool_free(pool, one);
+    sia_pool_free_n(pool, ptrs, 8);
+    sia_pool_destroy(pool);
+
+    sia_reset(arena);
+    sia_destroy(arena);
+
+    // create, push, realloc, temp begin, push, temp end, pop to, pool create, alloc, alloc n + 8, free, free n + 8,
+    // pool destroy, reset, destroy
+    return 1 + 1 + 1 + 1 + 1 + 1 + 1 + 1 + 1 + 9 + 1 + 9 + 1 + 1 + 1;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        printf("Usage: %s trace\n", argv[0]);
+        return 1;
+    }
+
+    int fd = open(argv[1], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0 || !sia_trace_start(fd)) {
+        printf("Failed to start the trace\n");
+        return 1;
+    }
+
+    sia_u64 expected = record_ops();
+
+    pthread_t threads[NUM_THREADS];
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_create(&threads[i], NULL, churn, NULL);
+    }
+    for (int i = 0; i < NUM_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    expected += NUM_THREADS * (2 + 2 * NUM_PUSHES);
+
+    sia_trace_stop();
+    close(fd);
+
+    // Every record made it to the file, after the header
+    struct stat info;
+    if (stat(argv[1], &info) != 0 ||
+        (sia_u64)info.st_size != sizeof(sia_trace_header) + expected * sizeof(sia_trace_record)) {
+        printf("\x1b[35mTrace has %lld bytes, expected %llu records\x1b[0m\n",
+            (long long)info.st_size, (unsigned long long)expected);
+        return 1;
+    }
+
+    printf("Recorded %llu records.\n", (unsigned long long)expected);
+    return 0;
+}
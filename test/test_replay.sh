@@ -0,0 +1,27 @@
+#!/bin/sh
+# Records a trace with test_replay.c and replays it with tools/sia_replay.c on both backends (Linux and MacOS)
+set -e
+
+root="$(cd "$(dirname "$0")/.." && pwd)"
+out="${TMPDIR:-/tmp}/sia_replay_test.$$"
+mkdir -p "$out"
+trap 'rm -rf "$out"' EXIT
+
+cc=${CC:-cc}
+$cc -O1 -g -o "$out/test_replay" "$root/test/test_replay.c" -lpthread
+$cc -O2 -o "$out/sia_replay" "$root/tools/sia_replay.c"
+$cc -O2 -DSIA_FORCE_MALLOC -o "$out/sia_replay_malloc" "$root/tools/sia_replay.c"
+
+"$out/test_replay" "$out/trace.bin"
+
+failed=0
+for replay in sia_replay sia_replay_malloc; do
+    "$out/$replay" "$out/trace.bin" > "$out/result.txt"
+    cat "$out/result.txt"
+    if ! grep -q "(0 skipped)" "$out/result.txt" || ! grep -q "^errors: *0$" "$out/result.txt"; then
+        echo "$replay failed"
+        failed=1
+    fi
+done
+
+exit $failed
@@ -1,56 +1,59 @@
 #include <stdio.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
-#define MGA_STATIC
-#define MG_ARENA_IMPL
-#include "../mg_arena.h"
+#define SIA_STATIC
+#define SIA_ENABLE_REGISTRY
+#define SIA_ENABLE_TRACE
+#define SI_ARENA_IMPL
+#include "../si_arena.h"
 
 #define TEST_ASSERT(b, m) \
     if (!(b)) { printf("\x1b[35mAssert Failed: " m "\x1b[0m\n"); return false; }
 
-static mg_arena* arena;
+static si_arena* arena;
 
 #define IS_POW2(x) (((x) != 0) && (((x) & ((x) - 1)) == 0))
 
 bool test_misc(void) {
-    TEST_ASSERT(MGA_KiB(1) == 1024, "KiB");
-    TEST_ASSERT(MGA_KiB(2) == 2048, "KiB");
-    TEST_ASSERT(MGA_MiB(1) == 1048576, "MiB");
-    TEST_ASSERT(MGA_MiB(2) == 2097152, "MiB");
-    TEST_ASSERT(MGA_GiB(1) == 1073741824, "GiB");
-    TEST_ASSERT(MGA_GiB(2) == 2147483648, "GiB");
+    TEST_ASSERT(SIA_KiB(1) == 1024, "KiB");
+    TEST_ASSERT(SIA_KiB(2) == 2048, "KiB");
+    TEST_ASSERT(SIA_MiB(1) == 1048576, "MiB");
+    TEST_ASSERT(SIA_MiB(2) == 2097152, "MiB");
+    TEST_ASSERT(SIA_GiB(1) == 1073741824, "GiB");
+    TEST_ASSERT(SIA_GiB(2) == 2147483648, "GiB");
 
-    TEST_ASSERT(sizeof(mga_i32) == 4, "mga_i32 size");
-    TEST_ASSERT(sizeof(mga_u8 ) == 1, "mga_u8  size");
-    TEST_ASSERT(sizeof(mga_u32) == 4, "mga_u32 size");
-    TEST_ASSERT(sizeof(mga_u64) == 8, "mga_u64 size");
-    TEST_ASSERT(sizeof(mga_b32) == 4, "mga_b32 size");
+    TEST_ASSERT(sizeof(sia_i32) == 4, "sia_i32 size");
+    TEST_ASSERT(sizeof(sia_u8 ) == 1, "sia_u8  size");
+    TEST_ASSERT(sizeof(sia_u32) == 4, "sia_u32 size");
+    TEST_ASSERT(sizeof(sia_u64) == 8, "sia_u64 size");
+    TEST_ASSERT(sizeof(sia_b32) == 4, "sia_b32 size");
 
     return true;
 }
 
-void test_error_callback(mga_error err) { 
-    printf("MGA Error %u: %s\n", err.code, err.msg);
+void test_error_callback(sia_error err) { 
+    printf("SIA Error %u: %s\n", err.code, err.msg);
 }
 bool test_create(void) {
-    arena = mga_create(&(mga_desc){
-        .desired_max_size = MGA_MiB(4),
-        .desired_block_size = MGA_KiB(128),
+    arena = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(4),
+        .desired_block_size = SIA_KiB(128),
         .align = sizeof(void*),
         .error_callback = test_error_callback
     });
 
     TEST_ASSERT(arena != NULL, "Arena create");
     
-    mga_u64 size = mga_get_size(arena);
-    TEST_ASSERT(IS_POW2(size) && size >= MGA_MiB(4), "Max size");
+    sia_u64 size = sia_get_size(arena);
+    TEST_ASSERT(IS_POW2(size) && size >= SIA_MiB(4), "Max size");
     
-    mga_u32 block_size = mga_get_block_size(arena);
-    TEST_ASSERT(IS_POW2(block_size) && block_size >= MGA_KiB(128), "Block size");
+    sia_u32 block_size = sia_get_block_size(arena);
+    TEST_ASSERT(IS_POW2(block_size) && block_size >= SIA_KiB(128), "Block size");
     
-    mga_u32 align = mga_get_align(arena);
+    sia_u32 align = sia_get_align(arena);
     TEST_ASSERT(IS_POW2(align) && align == sizeof(void*), "Align");
 
     TEST_ASSERT(arena->error_callback == test_error_callback, "Error callback");
@@ -59,29 +62,29 @@ bool test_create(void) {
 }
 
 bool test_push(void) {
-    int* num_ptr = (int*)mga_push(arena, sizeof(int));
+    int* num_ptr = (int*)sia_push(arena, sizeof(int));
     TEST_ASSERT(num_ptr != NULL, "Num ptr");
     *num_ptr = 42;
 
-    int* num_arr = (int*)mga_push(arena, sizeof(int) * 64);
+    int* num_arr = (int*)sia_push(arena, sizeof(int) * 64);
     TEST_ASSERT(num_arr != NULL, "num_arr");
     for (int i = 0; i < 64; i++) {
         num_arr[i] = 123;
     }
 
-    int* zero_arr = (int*)mga_push_zero(arena, sizeof(int) * 256);
+    int* zero_arr = (int*)sia_push_zero(arena, sizeof(int) * 256);
     for (int i = 0; i < 256; i++) {
         TEST_ASSERT(zero_arr[i] == 0, "push zero");
     }
 
-    float* test_float = MGA_PUSH_STRUCT(arena, float);
+    float* test_float = SIA_PUSH_STRUCT(arena, float);
     TEST_ASSERT(test_float != NULL, "PUSH_STRUCT");
     *test_float = 3.14159f;
     
-    float* zero_float = MGA_PUSH_ZERO_STRUCT(arena, float);
+    float* zero_float = SIA_PUSH_ZERO_STRUCT(arena, float);
     TEST_ASSERT(test_float != NULL && *zero_float == 0.0f, "PUSH_STRUCT_ZERO");
 
-    char* char_arr = MGA_PUSH_ARRAY(arena, char, 6);
+    char* char_arr = SIA_PUSH_ARRAY(arena, char, 6);
     char_arr[0] = 'H';
     char_arr[1] = 'e';
     char_arr[2] = 'l';
@@ -90,60 +93,109 @@ bool test_push(void) {
     char_arr[5] = '\0';
     TEST_ASSERT(char_arr != NULL && strcmp(char_arr, "Hello") == 0, "PUSH_ARRAY");
 
-    float* float_zeros = MGA_PUSH_ZERO_ARRAY(arena, float, 10);
+    float* float_zeros = SIA_PUSH_ZERO_ARRAY(arena, float, 10);
     for (int i = 0; i < 10; i++) {
         TEST_ASSERT(float_zeros[i] == 0, "PUSH_ZERO_ARRAY");
     }
 
-    char* large_alloc = (char*)mga_push(arena, MGA_KiB(512));
+    char* large_alloc = (char*)sia_push(arena, SIA_KiB(512));
     TEST_ASSERT(large_alloc != NULL, "large alloc");
 
-    mga_error err = mga_get_error(arena);
-    TEST_ASSERT(err.code == MGA_ERR_NONE, "got mga error");
+    sia_error err = sia_get_error(arena);
+    TEST_ASSERT(err.code == SIA_ERR_NONE, "got mga error");
 
     return true;
 }
 
 bool test_getters(void) {
-    TEST_ASSERT(mga_get_pos(arena) == arena->_pos, "get pos");
-    TEST_ASSERT(mga_get_size(arena) == arena->_size, "get size");
-    TEST_ASSERT(mga_get_block_size(arena) == arena->_block_size, "get block_size");
-    TEST_ASSERT(mga_get_align(arena) == arena->_align, "get align");
+    TEST_ASSERT(sia_get_pos(arena) == arena->_pos, "get pos");
+    TEST_ASSERT(sia_get_size(arena) == arena->_size, "get size");
+    TEST_ASSERT(sia_get_block_size(arena) == arena->_block_size, "get block_size");
+    TEST_ASSERT(sia_get_align(arena) == arena->_align, "get align");
 
     return true;
 }
 
 bool test_pop(void) {
-    char* data = (char*)mga_push(arena, 1024);
+    char* data = (char*)sia_push(arena, 1024);
     (void)data;
-    mga_u64 start_pos = mga_get_pos(arena);
+    sia_u64 start_pos = sia_get_pos(arena);
 
-    mga_pop(arena, 1024);
+    sia_pop(arena, 1024);
 
-    mga_u64 end_pos = mga_get_pos(arena);
+    sia_u64 end_pos = sia_get_pos(arena);
 
     TEST_ASSERT(start_pos - end_pos == 1024, "pop");
 
-    mga_reset(arena);
-#ifdef MGA_MIN_POS
-    TEST_ASSERT(mga_get_pos(arena) == MGA_MIN_POS, "reset");
+    sia_reset(arena);
+#ifdef SIA_MIN_POS
+    TEST_ASSERT(sia_get_pos(arena) == SIA_MIN_POS, "reset");
 #else
-    TEST_ASSERT(mga_get_pos(arena) == 0, "reset");
+    TEST_ASSERT(sia_get_pos(arena) == 0, "reset");
 #endif
 
     return true;
 }
 
+bool test_fast_path(void) {
+    si_arena* fast = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(4),
+        .desired_block_size = SIA_KiB(64),
+        .error_callback = test_error_callback
+    });
+    TEST_ASSERT(fast != NULL, "fast path create");
+
+    // With sampling disabled, fast pushes leave the countdown alone
+    sia_u32 countdown = fast->_guard_countdown;
+    sia_u64 start_pos = sia_get_pos(fast);
+    sia_u8* first = (sia_u8*)sia_push_fast(fast, 64);
+    TEST_ASSERT(first != NULL && fast->_guard_countdown == countdown, "fast path countdown");
+
+    // Fills right up to the commit edge (the end of the node for the malloc backend)
+    sia_u64 limit = fast->_fast_limit;
+    sia_u64 fill_size = limit - fast->_pos;
+    sia_u8* fill = (sia_u8*)sia_push_aligned_fast(fast, fill_size, 1);
+    TEST_ASSERT(fill != NULL && fast->_pos == limit && fast->_fast_limit == limit, "fast path up to limit");
+    memset(fill, 0xab, fill_size);
+
+    // One byte more takes the slow path, which commits more or switches nodes
+    sia_u8* over = (sia_u8*)sia_push_aligned_fast(fast, 1, 1);
+    TEST_ASSERT(over != NULL && fast->_fast_limit > limit, "fast path past limit");
+    TEST_ASSERT(fast->_fast_floor <= fast->_pos && fast->_pos <= fast->_fast_limit, "fast path bounds after push");
+    *over = 0xcd;
+    TEST_ASSERT(fill[fill_size - 1] == 0xab, "fast path keeps memory");
+
+    // Popping back below the floor takes the slow path, which decommits or frees the node
+    TEST_ASSERT(fast->_fast_floor > start_pos, "fast path floor");
+    sia_pop_fast(fast, sia_get_pos(fast) - (start_pos + 64));
+    TEST_ASSERT(sia_get_pos(fast) == start_pos + 64, "fast path pop below floor");
+    TEST_ASSERT(fast->_fast_floor <= fast->_pos && fast->_pos <= fast->_fast_limit, "fast path bounds after pop");
+
+    // The exported functions share the same state
+    memset(first, 0xef, 64);
+    sia_pop(fast, 64);
+    sia_u8* again = (sia_u8*)sia_push_zero(fast, 64);
+    TEST_ASSERT(again == first && again[0] == 0 && again[63] == 0, "fast path exported");
+
+    sia_u8* next = (sia_u8*)sia_push_aligned(fast, 1, 1);
+    TEST_ASSERT(next == first + 64, "fast path exported push");
+    sia_pop_fast(fast, 1);
+    TEST_ASSERT(sia_get_pos(fast) == start_pos + 64, "fast path pop");
+
+    sia_destroy(fast);
+    return true;
+}
+
 bool test_temp(void) {
-    mga_u64 start_pos = arena->_pos;
-    mga_temp temp = mga_temp_begin(arena);
+    sia_u64 start_pos = arena->_pos;
+    sia_temp temp = sia_temp_begin(arena);
 
     TEST_ASSERT(temp._pos == arena->_pos, "temp begin");
 
-    mga_push(arena, arena->_block_size + 8);
-    mga_push(arena, arena->_block_size + 8);
+    sia_push(arena, arena->_block_size + 8);
+    sia_push(arena, arena->_block_size + 8);
 
-    mga_temp_end(temp);
+    sia_temp_end(temp);
 
     TEST_ASSERT(start_pos == arena->_pos, "temp end");
 
@@ -152,19 +204,19 @@ bool test_temp(void) {
 
 bool test_destroy(void) {
     // I guess this only fails if there is a seg fault
-    mga_destroy(arena);
+    sia_destroy(arena);
 
     return true;
 }
 
 bool test_scratch(void) {
-    mga_desc desc = {
-        .desired_max_size = MGA_MiB(1),
+    sia_desc desc = {
+        .desired_max_size = SIA_MiB(1),
         .error_callback = test_error_callback,
     };
-    mga_scratch_set_desc(&desc);
+    sia_scratch_set_desc(&desc);
 
-    mga_temp scratch0 = mga_scratch_get(NULL, 0);
+    sia_temp scratch0 = sia_scratch_get(NULL, 0);
 
     TEST_ASSERT (
         scratch0.arena->_size >= desc.desired_max_size && 
@@ -172,25 +224,1302 @@ bool test_scratch(void) {
         "scratch set desc"
     );
     
-    mga_u64 spos0 = mga_get_pos(scratch0.arena);
+    sia_u64 spos0 = sia_get_pos(scratch0.arena);
 
-    char* data0 = mga_push(scratch0.arena, MGA_KiB(512));
+    char* data0 = sia_push(scratch0.arena, SIA_KiB(512));
     TEST_ASSERT(data0 != NULL, "scratch push");
 
-    mga_temp scratch1 = mga_scratch_get(&scratch0.arena, 1);
+    sia_temp scratch1 = sia_scratch_get(&scratch0.arena, 1);
     TEST_ASSERT(scratch0.arena != scratch1.arena, "scratch conflicts");
 
-    mga_u64 spos1 = mga_get_pos(scratch1.arena);
+    sia_u64 spos1 = sia_get_pos(scratch1.arena);
 
-    char* data1 = mga_push(scratch1.arena, MGA_KiB(512));
+    char* data1 = sia_push(scratch1.arena, SIA_KiB(512));
     TEST_ASSERT(data1 != NULL, "scratch push");
 
-    mga_scratch_release(scratch0);
-    mga_scratch_release(scratch1);
+    sia_scratch_release(scratch0);
+    sia_scratch_release(scratch1);
+
+    TEST_ASSERT(sia_get_pos(scratch0.arena) == spos0, "scratch release");
+    TEST_ASSERT(sia_get_pos(scratch1.arena) == spos1, "scratch release");
+
+    return true;
+}
+
+bool test_guard(void) {
+    si_arena* guarded = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(1),
+        .error_callback = test_error_callback,
+        .guard_sample_rate = 1
+    });
+    TEST_ASSERT(guarded != NULL, "guard create");
+
+    sia_u64 start_pos = sia_get_pos(guarded);
+
+    char* data = (char*)sia_push(guarded, 64);
+    TEST_ASSERT(data != NULL, "guard push");
+    memset(data, 0xab, 64);
+
+    // Every push is sampled, so the allocation ends right at the guard page
+    TEST_ASSERT(((uintptr_t)(data + 64) & 4095) == 0, "guard page placement");
+    TEST_ASSERT(sia_get_pos(guarded) >= start_pos + 64, "guard pos");
+
+    data = (char*)sia_realloc(guarded, data, 64, 128);
+    TEST_ASSERT(data != NULL && (unsigned char)data[63] == 0xab, "guard realloc");
+
+    sia_pop_to(guarded, start_pos);
+    TEST_ASSERT(guarded->_mappings == NULL, "guard release");
+
+    sia_destroy(guarded);
+
+    return true;
+}
+
+bool test_aligned(void) {
+    si_arena* aligned = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(1),
+        .error_callback = test_error_callback
+    });
+    TEST_ASSERT(aligned != NULL, "aligned create");
+
+    sia_push(aligned, 1);
+
+    float* simd = SIA_PUSH_ARRAY_ALIGNED(aligned, float, 16, 64);
+    TEST_ASSERT(simd != NULL && ((uintptr_t)simd & 63) == 0, "push aligned");
+    for (int i = 0; i < 16; i++) {
+        simd[i] = (float)i;
+    }
+
+    float* grown = (float*)sia_realloc(aligned, simd, sizeof(float) * 16, sizeof(float) * 32);
+    TEST_ASSERT(grown == simd, "realloc aligned in place");
+
+    sia_push(aligned, 1);
+    float* moved = (float*)sia_realloc(aligned, grown, sizeof(float) * 32, sizeof(float) * 64);
+    TEST_ASSERT(moved != grown && ((uintptr_t)moved & 63) == 0, "realloc keeps alignment");
+    TEST_ASSERT(moved[15] == 15.0f, "realloc aligned copy");
+
+    char* page = (char*)sia_push_zero_aligned(aligned, 16, 8192);
+    TEST_ASSERT(page != NULL && ((uintptr_t)page & 8191) == 0 && page[15] == 0, "push zero aligned");
+
+    // Not a power of 2
+    TEST_ASSERT(sia_push_aligned(aligned, 16, 48) == NULL, "invalid align");
+    sia_error err = sia_get_error(aligned);
+    TEST_ASSERT(err.code == SIA_ERR_INVALID_ALIGN, "invalid align error");
+
+    sia_destroy(aligned);
+
+    return true;
+}
+
+static int cleanup_order[8];
+static int cleanup_count = 0;
+
+static void test_cleanup_func(void* ptr) {
+    cleanup_order[cleanup_count++] = *(int*)ptr;
+}
+
+bool test_cleanup(void) {
+    si_arena* owner = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(1),
+        .error_callback = test_error_callback
+    });
+    TEST_ASSERT(owner != NULL, "cleanup create");
+
+    cleanup_count = 0;
+
+    int* a = (int*)sia_push_with_cleanup(owner, sizeof(int), test_cleanup_func);
+    *a = 1;
 
-    TEST_ASSERT(mga_get_pos(scratch0.arena) == spos0, "scratch release");
-    TEST_ASSERT(mga_get_pos(scratch1.arena) == spos1, "scratch release");
+    sia_temp temp = sia_temp_begin(owner);
+    int* b = (int*)sia_push_with_cleanup(temp.arena, sizeof(int), test_cleanup_func);
+    *b = 2;
+    int* c = (int*)sia_push_aligned_with_cleanup(temp.arena, sizeof(int), 64, test_cleanup_func);
+    *c = 3;
+    sia_temp_end(temp);
 
+    TEST_ASSERT(cleanup_count == 2, "cleanup temp end");
+    TEST_ASSERT(cleanup_order[0] == 3 && cleanup_order[1] == 2, "cleanup LIFO");
+
+    int* d = (int*)sia_push_with_cleanup(owner, sizeof(int), test_cleanup_func);
+    *d = 4;
+    sia_destroy(owner);
+
+    TEST_ASSERT(cleanup_count == 4, "cleanup destroy");
+    TEST_ASSERT(cleanup_order[2] == 4 && cleanup_order[3] == 1, "cleanup destroy LIFO");
+
+    return true;
+}
+
+bool test_buffer(void) {
+    // Plain arrays are only guaranteed to be aligned for their element type
+    uint64_t buf[512];
+    char* buf_start = (char*)buf;
+    char* buf_end = buf_start + sizeof(buf);
+
+    si_arena* small = sia_create_from_buffer(buf, sizeof(buf), NULL);
+    TEST_ASSERT(small != NULL, "buffer create");
+
+    sia_u64 start_pos = sia_get_pos(small);
+    char* data = (char*)sia_push(small, 1024);
+    TEST_ASSERT(data >= buf_start && data + 1024 <= buf_end, "buffer push");
+
+    TEST_ASSERT(sia_push(small, sizeof(buf)) == NULL, "buffer full");
+    TEST_ASSERT(sia_get_error(small).code == SIA_ERR_OUT_OF_MEMORY, "buffer full error");
+
+    sia_reset(small);
+    TEST_ASSERT(sia_get_pos(small) == start_pos, "buffer reset");
+    sia_destroy(small);
+
+    si_arena* chained = sia_create_from_buffer(buf, sizeof(buf), &(sia_desc){
+        .desired_max_size = SIA_MiB(1),
+        .error_callback = test_error_callback,
+        .flags = SIA_FLAG_OVERFLOW
+    });
+    TEST_ASSERT(chained != NULL, "overflow create");
+
+    int* ints = SIA_PUSH_ARRAY(chained, int, 256);
+    TEST_ASSERT((char*)ints >= buf_start && (char*)(ints + 256) <= buf_end, "overflow push in buffer");
+    for (int i = 0; i < 256; i++) {
+        ints[i] = i;
+    }
+
+    sia_temp temp = sia_temp_begin(chained);
+
+    char* big = (char*)sia_push(chained, SIA_KiB(16));
+    TEST_ASSERT(big != NULL && (big + SIA_KiB(16) <= buf_start || big >= buf_end), "overflow push");
+    memset(big, 1, SIA_KiB(16));
+
+    int* moved = (int*)sia_realloc(chained, ints, sizeof(int) * 256, sizeof(int) * 2048);
+    TEST_ASSERT(moved != NULL && moved != ints && moved[255] == 255, "overflow realloc");
+
+    sia_temp_end(temp);
+    TEST_ASSERT(sia_get_pos(chained) == temp._pos, "overflow temp end");
+
+    char* back = (char*)sia_push(chained, 64);
+    TEST_ASSERT(back >= buf_start && back + 64 <= buf_end, "overflow back in buffer");
+
+    sia_destroy(chained);
+
+    return true;
+}
+
+bool test_checkpoint(void) {
+#if defined(__linux__) && !defined(SIA_FORCE_MALLOC)
+    si_arena* state = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(4),
+        .desired_block_size = SIA_KiB(64),
+        .error_callback = test_error_callback,
+        .flags = SIA_FLAG_CHECKPOINT
+    });
+    TEST_ASSERT(state != NULL, "checkpoint create");
+
+    int* values = SIA_PUSH_ARRAY(state, int, 1024);
+    for (int i = 0; i < 1024; i++) {
+        values[i] = i;
+    }
+    sia_u64 pos = sia_get_pos(state);
+
+    sia_snapshot snapshot = sia_checkpoint(state);
+    TEST_ASSERT(snapshot.arena == state, "checkpoint begin");
+
+    values[10] = -1;
+    char* extra = (char*)sia_push(state, SIA_KiB(256));
+    memset(extra, 1, SIA_KiB(256));
+
+    sia_pop_to(state, pos - 64);
+    TEST_ASSERT(sia_get_error(state).code == SIA_ERR_CANNOT_POP_MORE, "checkpoint pop floor");
+
+    sia_rollback(snapshot);
+    TEST_ASSERT(values[10] == 10, "rollback restores data");
+    TEST_ASSERT(sia_get_pos(state) == pos, "rollback restores pos");
+
+    snapshot = sia_checkpoint(state);
+    values[20] = -1;
+    extra = (char*)sia_push(state, 64);
+    extra[0] = 42;
+    sia_accept(snapshot);
+    TEST_ASSERT(values[20] == -1 && extra[0] == 42, "accept keeps data");
+
+    // After accepting, a new checkpoint starts from the accepted state
+    snapshot = sia_checkpoint(state);
+    values[20] = 20;
+    sia_rollback(snapshot);
+    TEST_ASSERT(values[20] == -1 && extra[0] == 42, "rollback after accept");
+
+    sia_destroy(state);
+
+    // Growing a large allocation from before the checkpoint leaves its record alone
+    si_arena* large = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(4),
+        .error_callback = test_error_callback,
+        .flags = SIA_FLAG_CHECKPOINT,
+        .large_threshold = SIA_MiB(1)
+    });
+    sia_u64 large_start = sia_get_pos(large);
+    char* old_data = (char*)sia_push(large, SIA_MiB(1));
+    TEST_ASSERT(old_data != NULL && large->_mappings != NULL, "checkpoint large push");
+    old_data[0] = 7;
+    _sia_mapping* old_record = large->_mappings;
+
+    snapshot = sia_checkpoint(large);
+    char* grown = (char*)sia_realloc(large, old_data, SIA_MiB(1), SIA_MiB(64));
+    TEST_ASSERT(grown != NULL && grown != old_data && grown[0] == 7, "checkpoint large realloc");
+    TEST_ASSERT(old_record->base == old_data && old_record->map_size == SIA_MiB(1), "checkpoint large record kept");
+    grown[SIA_MiB(64) - 1] = 1;
+
+    sia_rollback(snapshot);
+    TEST_ASSERT(large->_mappings == old_record && old_record->base == old_data, "checkpoint large rollback");
+    TEST_ASSERT(old_data[0] == 7, "checkpoint large rollback data");
+
+    sia_pop_to(large, large_start);
+    TEST_ASSERT(large->_mappings == NULL, "checkpoint large release");
+    sia_destroy(large);
+
+    si_arena* plain = sia_create(&(sia_desc){ .desired_max_size = SIA_MiB(1) });
+    snapshot = sia_checkpoint(plain);
+    TEST_ASSERT(snapshot.arena == NULL, "checkpoint needs flag");
+    TEST_ASSERT(sia_get_error(plain).code == SIA_ERR_CHECKPOINT_FAILED, "checkpoint error");
+    sia_destroy(plain);
+#endif
+
+    return true;
+}
+
+bool test_stats(void) {
+    si_arena* tracked = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(4),
+        .desired_block_size = SIA_KiB(64),
+        .error_callback = test_error_callback
+    });
+    TEST_ASSERT(tracked != NULL, "stats create");
+
+    sia_memory_stats stats = sia_get_memory_stats(tracked);
+    TEST_ASSERT(stats.committed > 0 && stats.num_commits == 1, "stats initial");
+
+    sia_u64 start_pos = sia_get_pos(tracked);
+    char* data = (char*)sia_push(tracked, SIA_KiB(512));
+    memset(data, 1, SIA_KiB(512));
+
+    stats = sia_get_memory_stats(tracked);
+    TEST_ASSERT(stats.committed >= SIA_KiB(512), "stats committed");
+    TEST_ASSERT(stats.num_commits > 1, "stats commits");
+    TEST_ASSERT(stats.resident >= SIA_KiB(256) && stats.resident <= stats.committed, "stats resident");
+    TEST_ASSERT(stats.faulted_pages * 4096 >= SIA_KiB(256), "stats faulted");
+
+    sia_pop_to(tracked, start_pos);
+
+    stats = sia_get_memory_stats(tracked);
+    TEST_ASSERT(stats.pos == start_pos, "stats pos");
+    TEST_ASSERT(stats.peak_pos >= start_pos + SIA_KiB(512), "stats peak");
+    TEST_ASSERT(stats.faulted_pages * 4096 >= SIA_KiB(256), "stats faulted after pop");
+#ifndef SIA_FORCE_MALLOC
+    // The malloc backend keeps the last node around when it is emptied
+    TEST_ASSERT(stats.num_decommits > 0, "stats decommits");
+#endif
+
+#ifdef SIA_FORCE_MALLOC
+    // A push that does not fit leaves the rest of the node unused
+    sia_push(tracked, SIA_KiB(60));
+    sia_push(tracked, SIA_KiB(8));
+    stats = sia_get_memory_stats(tracked);
+    TEST_ASSERT(stats.slack >= SIA_KiB(4) - 64, "stats slack");
+#endif
+
+    sia_destroy(tracked);
+
+    return true;
+}
+
+bool test_registry(void) {
+    si_arena* named = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(1),
+        .error_callback = test_error_callback,
+        .name = "test \"registry\""
+    });
+    TEST_ASSERT(named != NULL, "registry create");
+
+    sia_pool* pool = sia_pool_create(&(sia_pool_desc){
+        .arena = named,
+        .block_size = 32,
+        .initial_capacity = 16,
+        .name = "test_pool"
+    });
+    TEST_ASSERT(pool != NULL, "registry pool create");
+    sia_pool_alloc(pool);
+
+    // A pool whose initial capacity does not fit is popped, which takes it out of the registry
+    sia_u64 before_pool = sia_get_pos(named);
+    TEST_ASSERT(sia_pool_create(&(sia_pool_desc){
+        .arena = named,
+        .block_size = 32,
+        .initial_capacity = SIA_MiB(1),
+        .name = "too_large"
+    }) == NULL, "registry pool create fails");
+    TEST_ASSERT(sia_get_pos(named) == before_pool, "registry pool create failure pops");
+
+    FILE* file = tmpfile();
+    TEST_ASSERT(file != NULL, "registry tmpfile");
+
+    sia_registry_dump(fileno(file));
+
+    char dump[8192] = { 0 };
+    rewind(file);
+    fread(dump, 1, sizeof(dump) - 1, file);
+
+    TEST_ASSERT(strstr(dump, "\"type\":\"arena\"") != NULL, "registry arena line");
+    TEST_ASSERT(strstr(dump, "\"name\":\"test \\\"registry\\\"\"") != NULL, "registry escaped name");
+    TEST_ASSERT(strstr(dump, "\"name\":\"test_pool\",\"block_size\":32,\"capacity\":16,\"used\":1") != NULL, "registry pool line");
+    TEST_ASSERT(strstr(dump, "too_large") == NULL, "registry failed pool removed");
+
+    // Dumps unpin every entry once its line is formatted
+    TEST_ASSERT(_sia_registry_slots[named->_registry_slot] == (sia_u64)named, "registry entry unpinned");
+    TEST_ASSERT(_sia_registry_slots[pool->_registry_slot] == ((sia_u64)pool | 1), "registry pool unpinned");
+
+    // Like a dump from a signal handler that interrupted another dump, which has the entry pinned
+    _sia_registry_slots[named->_registry_slot] += _SIA_REGISTRY_READ_ONE;
+    fclose(file);
+    file = tmpfile();
+    TEST_ASSERT(file != NULL, "registry tmpfile");
+    sia_registry_dump(fileno(file));
+    memset(dump, 0, sizeof(dump));
+    rewind(file);
+    fread(dump, 1, sizeof(dump) - 1, file);
+    TEST_ASSERT(strstr(dump, "\"name\":\"test \\\"registry\\\"\"") != NULL, "registry pinned entry dumped");
+    TEST_ASSERT(_sia_registry_slots[named->_registry_slot] == (sia_u64)named + _SIA_REGISTRY_READ_ONE, "registry pin kept");
+    _sia_registry_slots[named->_registry_slot] -= _SIA_REGISTRY_READ_ONE;
+
+    // Popping the pool removes it from the registry
+    sia_reset(named);
+    fclose(file);
+    file = tmpfile();
+    TEST_ASSERT(file != NULL, "registry tmpfile");
+
+    sia_registry_dump(fileno(file));
+    memset(dump, 0, sizeof(dump));
+    rewind(file);
+    fread(dump, 1, sizeof(dump) - 1, file);
+    TEST_ASSERT(strstr(dump, "test_pool") == NULL, "registry pool removed");
+
+    sia_destroy(named);
+    fclose(file);
+
+    return true;
+}
+
+bool test_ring(void) {
+#ifdef __linux__
+    sia_ring* ring = sia_ring_create(&(sia_ring_desc){ .size = 100 });
+    TEST_ASSERT(ring != NULL, "ring create");
+
+    sia_u64 size = sia_ring_get_size(ring);
+    TEST_ASSERT(size >= 4096 && (size & (size - 1)) == 0, "ring size");
+
+    sia_u64 available = 0;
+    sia_ring_peek(ring, &available);
+    TEST_ASSERT(available == 0, "ring empty");
+
+    char* first = (char*)sia_ring_push(ring, size - 16);
+    memset(first, 'a', size - 16);
+    sia_ring_publish(ring);
+
+    TEST_ASSERT(sia_ring_push(ring, 32) == NULL, "ring full");
+    TEST_ASSERT(sia_ring_get_error(ring).code == SIA_ERR_OUT_OF_MEMORY, "ring full error");
+
+    char* read = (char*)sia_ring_peek(ring, &available);
+    TEST_ASSERT(read == first && available == size - 16, "ring peek");
+    sia_ring_consume(ring, size - 32);
+
+    // This push runs past the end of the ring, and stays contiguous
+    char* wrapped = (char*)sia_ring_push(ring, 64);
+    TEST_ASSERT(wrapped == first + size - 16, "ring wrap push");
+    for (int i = 0; i < 64; i++) {
+        wrapped[i] = (char)i;
+    }
+    TEST_ASSERT(first[47] == 63, "ring views share memory");
+
+    sia_ring_peek(ring, &available);
+    TEST_ASSERT(available == 16, "ring unpublished");
+    sia_ring_publish(ring);
+
+    read = (char*)sia_ring_peek(ring, &available);
+    TEST_ASSERT(available == 80 && read[0] == 'a' && read[16] == 0 && read[79] == 63, "ring peek wrapped");
+
+    sia_ring_consume(ring, 100);
+    TEST_ASSERT(sia_ring_get_error(ring).code == SIA_ERR_CANNOT_POP_MORE, "ring consume too much");
+    sia_ring_peek(ring, &available);
+    TEST_ASSERT(available == 0, "ring consumed");
+
+    sia_ring_destroy(ring);
+#endif
+
+    return true;
+}
+
+bool test_frames(void) {
+    si_arena* owner = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(1),
+        .error_callback = test_error_callback
+    });
+    sia_frame_ring* ring = sia_frame_ring_create(&(sia_frame_ring_desc){
+        .arena = owner,
+        .num_frames = 2,
+        .frame_desc = { .desired_max_size = SIA_MiB(1), .error_callback = test_error_callback }
+    });
+    TEST_ASSERT(ring != NULL, "frames create");
+
+    sia_u32 reader = sia_frame_reader_register(ring);
+    TEST_ASSERT(reader != SIA_FRAME_NO_READER, "frames register");
+    TEST_ASSERT(sia_frame_acquire(ring, reader).arena == NULL, "frames none published");
+
+    si_arena* first = sia_frame_begin(ring);
+    sia_u64 start_pos = sia_get_pos(first);
+    int* value = SIA_PUSH_STRUCT(first, int);
+    *value = 1;
+    sia_frame_publish(ring, value);
+
+    si_arena* second = sia_frame_begin(ring);
+    TEST_ASSERT(second != NULL && second != first, "frames second");
+    SIA_PUSH_STRUCT(second, int);
+    sia_frame_publish(ring, NULL);
+
+    // Both frames are still held by the reader
+    TEST_ASSERT(sia_frame_begin(ring) == NULL, "frames busy");
+
+    sia_frame frame = sia_frame_acquire(ring, reader);
+    TEST_ASSERT(frame.arena == first && frame.index == 0 && *(int*)frame.data == 1, "frames acquire");
+    sia_frame_release(frame);
+
+    TEST_ASSERT(sia_frame_begin(ring) == first, "frames reuse");
+    TEST_ASSERT(sia_get_pos(first) == start_pos, "frames reset");
+    sia_frame_publish(ring, NULL);
+
+    frame = sia_frame_acquire(ring, reader);
+    TEST_ASSERT(frame.arena == second && frame.index == 1, "frames in order");
+    sia_frame_release(frame);
+
+    // Without readers, frames are reused right away
+    sia_frame_reader_unregister(ring, reader);
+    for (int i = 0; i < 4; i++) {
+        TEST_ASSERT(sia_frame_begin(ring) != NULL, "frames no readers");
+        sia_frame_publish(ring, NULL);
+    }
+
+    // Only the first frame fits under the governor, so the ring gives back everything it made
+    sia_u64 owner_pos = sia_get_pos(owner);
+    sia_u64 used = sia_governor_get_used();
+    sia_governor_set(&(sia_governor_desc){ .limit = used + SIA_KiB(64) });
+    sia_frame_ring* failed = sia_frame_ring_create(&(sia_frame_ring_desc){
+        .arena = owner,
+        .num_frames = 2,
+        .frame_desc = {
+            .desired_max_size = SIA_MiB(1),
+            .desired_block_size = SIA_KiB(64),
+            .error_callback = test_error_callback,
+            .flags = SIA_FLAG_GOVERNED
+        }
+    });
+    sia_governor_set(NULL);
+    TEST_ASSERT(failed == NULL, "frames create fails");
+    TEST_ASSERT(sia_get_pos(owner) == owner_pos, "frames create failure pops");
+    TEST_ASSERT(sia_governor_get_used() == used, "frames create failure destroys frames");
+
+    // Destroys the frame arenas through a cleanup
+    sia_destroy(owner);
+
+    return true;
+}
+
+bool test_bitmap(void) {
+    si_arena* backing = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(4),
+        .error_callback = test_error_callback
+    });
+    sia_pool* pool = sia_pool_create(&(sia_pool_desc){
+        .arena = backing,
+        .block_size = 24,
+        .align = 8,
+        .flags = SIA_FLAG_BITMAP
+    });
+    TEST_ASSERT(pool != NULL, "bitmap create");
+
+    void* blocks[1000];
+    TEST_ASSERT(sia_pool_alloc_n(pool, blocks, 1000), "bitmap alloc_n");
+    TEST_ASSERT(sia_pool_get_used(pool) == 1000, "bitmap used");
+    for (int i = 1; i < 1000; i++) {
+        if (((sia_u64)blocks[i] & 4095) == ((sia_u64)blocks[i - 1] & 4095) + 24) { continue; }
+        TEST_ASSERT(((sia_u64)blocks[i] & ~(sia_u64)4095) != ((sia_u64)blocks[i - 1] & ~(sia_u64)4095), "bitmap address order");
+    }
+
+    // Freed blocks are handed out again lowest address first
+    sia_pool_free(pool, blocks[700]);
+    sia_pool_free(pool, blocks[3]);
+    sia_pool_free(pool, blocks[500]);
+    TEST_ASSERT(sia_pool_alloc(pool) == blocks[3], "bitmap lowest first");
+    TEST_ASSERT(sia_pool_alloc(pool) == blocks[500], "bitmap next lowest");
+
+    sia_pool_free(pool, blocks[3]);
+    sia_pool_free(pool, blocks[3]);
+    TEST_ASSERT(sia_get_error(backing).code == SIA_ERR_INVALID_POOL_PTR, "bitmap double free");
+    sia_pool_free(pool, (char*)blocks[10] + 8);
+    TEST_ASSERT(sia_get_error(backing).code == SIA_ERR_INVALID_POOL_PTR, "bitmap misaligned free");
+
+    sia_pool_free_n(pool, blocks + 100, 200);
+    TEST_ASSERT(sia_pool_get_used(pool) == 1000 - 202, "bitmap free_n");
+
+    void* again[201];
+    TEST_ASSERT(sia_pool_alloc_n(pool, again, 201), "bitmap alloc_n reuse");
+    TEST_ASSERT(again[0] == blocks[3] && again[1] == blocks[100] && again[200] == blocks[299], "bitmap alloc_n order");
+    TEST_ASSERT(sia_pool_alloc(pool) == blocks[700], "bitmap after alloc_n");
+
+    sia_destroy(backing);
+
+    return true;
+}
+
+bool test_slot_map(void) {
+    si_arena* backing = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(4),
+        .error_callback = test_error_callback
+    });
+
+    // An initial capacity that does not fit leaves nothing pushed
+    sia_u64 start_pos = sia_get_pos(backing);
+    TEST_ASSERT(sia_slot_map_create(&(sia_slot_map_desc){
+        .arena = backing,
+        .item_size = sizeof(int),
+        .initial_capacity = 1 << 22
+    }) == NULL, "slot map create too large");
+    TEST_ASSERT(sia_get_pos(backing) == start_pos, "slot map create failure pops");
+
+    sia_slot_map* map = sia_slot_map_create(&(sia_slot_map_desc){
+        .arena = backing,
+        .item_size = sizeof(int)
+    });
+    TEST_ASSERT(map != NULL, "slot map create");
+
+    sia_handle handles[100];
+    for (int i = 0; i < 100; i++) {
+        int* item = SIA_SLOT_MAP_ALLOC_STRUCT(map, int, &handles[i]);
+        TEST_ASSERT(item != NULL, "slot map alloc");
+        *item = i;
+    }
+    TEST_ASSERT(map->count == 100 && *SIA_SLOT_MAP_GET_STRUCT(map, int, handles[42]) == 42, "slot map get after grow");
+
+    // The last item moves into the hole, and its handle still finds it
+    TEST_ASSERT(sia_slot_map_free(map, handles[10]), "slot map free");
+    TEST_ASSERT(map->count == 99 && ((int*)map->items)[10] == 99, "slot map swap remove");
+    TEST_ASSERT(*SIA_SLOT_MAP_GET_STRUCT(map, int, handles[99]) == 99, "slot map moved handle");
+
+    TEST_ASSERT(sia_slot_map_get(map, handles[10]) == NULL, "slot map stale get");
+    TEST_ASSERT(!sia_slot_map_free(map, handles[10]), "slot map stale free");
+    TEST_ASSERT(sia_get_error(backing).code == SIA_ERR_INVALID_HANDLE, "slot map stale error");
+    TEST_ASSERT(sia_slot_map_get(map, (sia_handle){ 0 }) == NULL, "slot map zero handle");
+
+    // A reused slot gets a new generation
+    sia_handle reused;
+    *SIA_SLOT_MAP_ALLOC_STRUCT(map, int, &reused) = 1000;
+    TEST_ASSERT(reused.index == handles[10].index && reused.gen != handles[10].gen, "slot map reuse slot");
+    TEST_ASSERT(sia_slot_map_get(map, handles[10]) == NULL, "slot map stale after reuse");
+
+    sia_handle from_index = sia_slot_map_get_handle(map, 10);
+    TEST_ASSERT(from_index.index == handles[99].index && from_index.gen == handles[99].gen, "slot map handle of item");
+
+    int sum = 0;
+    for (sia_u32 i = 0; i < map->count; i++) {
+        sum += ((int*)map->items)[i];
+    }
+    TEST_ASSERT(sum == 4950 - 10 + 1000, "slot map iterate");
+
+    sia_destroy(backing);
+
+    return true;
+}
+
+bool test_tlsf(void) {
+    sia_tlsf* tlsf = sia_tlsf_create(&(sia_tlsf_desc){
+        .arena_desc = {
+            .desired_max_size = SIA_MiB(16),
+            .desired_block_size = SIA_KiB(64),
+            .error_callback = test_error_callback
+        },
+        .initial_size = SIA_KiB(64)
+    });
+    TEST_ASSERT(tlsf != NULL, "tlsf create");
+
+    char* a = (char*)sia_tlsf_alloc(tlsf, 100);
+    char* b = (char*)sia_tlsf_alloc(tlsf, 1000);
+    char* c = (char*)sia_tlsf_alloc(tlsf, 10000);
+    TEST_ASSERT(a != NULL && b != NULL && c != NULL, "tlsf alloc");
+    TEST_ASSERT(((sia_u64)a & 7) == 0 && sia_tlsf_get_size(b) >= 1000, "tlsf size and align");
+    memset(a, 1, 100);
+    memset(b, 2, 1000);
+    memset(c, 3, 10000);
+
+    // Freeing the middle block last merges all three
+    sia_tlsf_free(tlsf, a);
+    sia_tlsf_free(tlsf, c);
+    sia_tlsf_free(tlsf, b);
+    char* merged = (char*)sia_tlsf_alloc(tlsf, 11000);
+    TEST_ASSERT(merged == a, "tlsf coalesce");
+    sia_tlsf_free(tlsf, merged);
+
+    sia_tlsf_free(tlsf, merged);
+    TEST_ASSERT(sia_get_error(tlsf->arena).code == SIA_ERR_INVALID_PTR, "tlsf double free");
+
+    // Grows past the initial memory
+    char* large = (char*)sia_tlsf_alloc(tlsf, SIA_KiB(200));
+    TEST_ASSERT(large != NULL, "tlsf grow");
+    large[SIA_KiB(200) - 1] = 1;
+    sia_tlsf_free(tlsf, large);
+
+#ifndef SIA_FORCE_MALLOC
+    // The reserve backend pushes right after the last memory, so the regions merge
+    sia_u64 pos = sia_get_pos(tlsf->arena);
+    char* spanning = (char*)sia_tlsf_alloc(tlsf, SIA_KiB(250));
+    TEST_ASSERT(spanning == a && sia_get_pos(tlsf->arena) == pos, "tlsf grow merges");
+    sia_tlsf_free(tlsf, spanning);
+#endif
+
+    sia_tlsf_destroy(tlsf);
+
+    return true;
+}
+
+bool test_scope(void) {
+    TEST_ASSERT(sia_scope_get() == NULL, "scope none");
+
+    sia_scope_begin();
+    si_arena* outer = sia_scope_get();
+    TEST_ASSERT(outer != NULL, "scope begin");
+    sia_u64 outer_pos = sia_get_pos(outer);
+    sia_push(outer, 128);
+
+    sia_scope_begin();
+    TEST_ASSERT(sia_scope_get() == outer, "scope nested");
+    sia_u64 inner_pos = sia_get_pos(outer);
+    sia_push(outer, 256);
+    sia_scope_end();
+    TEST_ASSERT(sia_get_pos(outer) == inner_pos, "scope inner end");
+
+    sia_scope_end();
+    TEST_ASSERT(sia_get_pos(outer) == outer_pos && sia_scope_get() == NULL, "scope outer end");
+
+    // Unbalanced ends are ignored
+    sia_scope_end();
+    TEST_ASSERT(sia_scope_get() == NULL, "scope extra end");
+
+    return true;
+}
+
+bool test_large(void) {
+    si_arena* arena = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(1),
+        .error_callback = test_error_callback,
+        .large_threshold = SIA_KiB(64)
+    });
+    TEST_ASSERT(arena != NULL, "large create");
+
+    sia_u64 start_pos = sia_get_pos(arena);
+
+    // Larger than the whole arena, so it only fits in its own mapping
+    char* data = (char*)sia_push(arena, SIA_MiB(4));
+    TEST_ASSERT(data != NULL && ((uintptr_t)data & 4095) == 0, "large push");
+    TEST_ASSERT(sia_get_pos(arena) < start_pos + SIA_KiB(64), "large pos");
+    data[0] = 1;
+    data[SIA_MiB(4) - 1] = 2;
+
+    // Small pushes still go in the arena
+    char* small = (char*)sia_push(arena, 64);
+    TEST_ASSERT(small != NULL && (small < data || small >= data + SIA_MiB(4)), "large small push");
+
+    data = (char*)sia_realloc(arena, data, SIA_MiB(4), SIA_MiB(8));
+    TEST_ASSERT(data != NULL && data[0] == 1 && data[SIA_MiB(4) - 1] == 2, "large realloc");
+    data[SIA_MiB(8) - 1] = 3;
+
+    sia_pop_to(arena, start_pos);
+    TEST_ASSERT(arena->_mappings == NULL, "large release");
+
+    // Destroying the arena releases the mapping too
+    TEST_ASSERT(sia_push(arena, SIA_KiB(64)) != NULL, "large threshold push");
+    TEST_ASSERT(arena->_mappings != NULL, "large threshold mapping");
+
+    sia_destroy(arena);
+
+    return true;
+}
+
+bool test_trace(void) {
+    FILE* file = tmpfile();
+    TEST_ASSERT(file != NULL, "trace tmpfile");
+
+    TEST_ASSERT(sia_trace_start(fileno(file)), "trace start");
+    TEST_ASSERT(!sia_trace_start(fileno(file)), "trace start twice");
+
+    si_arena* traced = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(1),
+        .error_callback = test_error_callback
+    });
+    TEST_ASSERT(traced != NULL, "trace create");
+
+    sia_temp temp = sia_temp_begin(traced);
+    void* data = sia_push(traced, 100);
+    data = sia_realloc(traced, data, 100, 200);
+    sia_temp_end(temp);
+
+    // Growing the pool pushes to the arena, but that push is part of the pool operation
+    sia_pool* pool = sia_pool_create(&(sia_pool_desc){ .arena = traced, .block_size = 16 });
+    void* block = sia_pool_alloc(pool);
+    void* blocks[2];
+    sia_pool_alloc_n(pool, blocks, 2);
+    sia_pool_free(pool, block);
+
+    sia_destroy(traced);
+    sia_trace_stop();
+
+    // Not recorded after the trace stops
+    sia_destroy(sia_create(&(sia_desc){ .desired_max_size = SIA_MiB(1) }));
+
+    sia_trace_header header = { 0 };
+    sia_trace_record records[16] = { 0 };
+    rewind(file);
+    TEST_ASSERT(fread(&header, sizeof(header), 1, file) == 1, "trace header read");
+    TEST_ASSERT(memcmp(header.magic, SIA_TRACE_MAGIC, 8) == 0 && header.record_size == sizeof(sia_trace_record), "trace header");
+    size_t num_records = fread(records, sizeof(sia_trace_record), 16, file);
+    fclose(file);
+
+    static const sia_u32 expected[] = {
+        SIA_TRACE_CREATE, SIA_TRACE_TEMP_BEGIN, SIA_TRACE_PUSH, SIA_TRACE_REALLOC, SIA_TRACE_TEMP_END,
+        SIA_TRACE_POOL_CREATE, SIA_TRACE_POOL_ALLOC, SIA_TRACE_POOL_ALLOC_N, SIA_TRACE_PTR, SIA_TRACE_PTR,
+        SIA_TRACE_POOL_FREE, SIA_TRACE_DESTROY
+    };
+    TEST_ASSERT(num_records == sizeof(expected) / sizeof(expected[0]), "trace record count");
+    for (size_t i = 0; i < num_records; i++) {
+        TEST_ASSERT(records[i].op == expected[i], "trace record op");
+    }
+
+    TEST_ASSERT(records[2].size == 100 && records[2].result == records[3].ptr, "trace push");
+    TEST_ASSERT(records[3].arg == 100 && records[3].size == 200, "trace realloc");
+    TEST_ASSERT(records[4].pos == records[1].pos, "trace temp end");
+    TEST_ASSERT(records[8].result == (sia_u64)blocks[0] && records[10].ptr == (sia_u64)block, "trace pool pointers");
+
+    return true;
+}
+
+bool test_adaptive(void) {
+    si_arena* adaptive = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(64),
+        .error_callback = test_error_callback,
+        .flags = SIA_FLAG_ADAPTIVE,
+        .min_block_size = SIA_KiB(64),
+        .max_block_size = SIA_MiB(1)
+    });
+    TEST_ASSERT(adaptive != NULL, "adaptive create");
+    TEST_ASSERT(sia_get_block_size(adaptive) == SIA_KiB(64), "adaptive min step");
+
+    for (int i = 0; i < 128; i++) {
+        TEST_ASSERT(sia_push(adaptive, SIA_KiB(64)) != NULL, "adaptive push");
+    }
+
+    // A fixed 64 KiB step would take over 100 commits
+    sia_memory_stats stats = sia_get_memory_stats(adaptive);
+    TEST_ASSERT(sia_get_block_size(adaptive) == SIA_MiB(1), "adaptive max step");
+    TEST_ASSERT(stats.num_commits < 20, "adaptive commits");
+
+    sia_reset(adaptive);
+    stats = sia_get_memory_stats(adaptive);
+    TEST_ASSERT(sia_get_block_size(adaptive) == SIA_KiB(64), "adaptive reset step");
+    TEST_ASSERT(stats.committed <= SIA_KiB(64), "adaptive reset commit");
+
+    sia_destroy(adaptive);
+
+    return true;
+}
+
+bool test_noreserve(void) {
+    si_arena* lazy = sia_create(&(sia_desc){
+        .desired_max_size = SIA_GiB(1),
+        .desired_block_size = SIA_KiB(64),
+        .error_callback = test_error_callback,
+        .flags = SIA_FLAG_NORESERVE
+    });
+    TEST_ASSERT(lazy != NULL, "noreserve create");
+
+#if defined(__linux__) && !defined(SIA_FORCE_MALLOC)
+    TEST_ASSERT(lazy->_flags & SIA_FLAG_NORESERVE, "noreserve mode");
+#else
+    TEST_ASSERT(!(lazy->_flags & SIA_FLAG_NORESERVE), "noreserve ignored");
+#endif
+
+    sia_u64 start_pos = sia_get_pos(lazy);
+    char* data = (char*)sia_push(lazy, SIA_MiB(1));
+    TEST_ASSERT(data != NULL, "noreserve push");
+    memset(data, 0xcd, SIA_MiB(1));
+
+    sia_memory_stats stats = sia_get_memory_stats(lazy);
+    TEST_ASSERT(stats.committed >= SIA_MiB(1), "noreserve committed");
+#if defined(__linux__) && !defined(SIA_FORCE_MALLOC)
+    TEST_ASSERT(stats.num_commits == 0, "noreserve no commit calls");
+#endif
+
+    sia_pop_to(lazy, start_pos);
+#if defined(__linux__) && !defined(SIA_FORCE_MALLOC)
+    stats = sia_get_memory_stats(lazy);
+    TEST_ASSERT(stats.num_decommits > 0 && stats.committed < SIA_MiB(1), "noreserve decommit");
+#endif
+
+    data = (char*)sia_push_zero(lazy, SIA_MiB(1));
+    TEST_ASSERT(data != NULL && data[SIA_MiB(1) - 1] == 0, "noreserve reuse");
+
+    sia_destroy(lazy);
+
+    return true;
+}
+
+bool test_space(void) {
+#ifdef SIA_FORCE_MALLOC
+    sia_error_callback* prev_callback = sia_get_global_error_callback();
+    sia_set_global_error_callback(test_error_callback);
+    sia_space* missing = sia_space_create(&(sia_space_desc){ .slot_size = SIA_MiB(1) });
+    sia_set_global_error_callback(prev_callback);
+    TEST_ASSERT(missing == NULL, "space needs low level backend");
+#else
+    sia_space* space = sia_space_create(&(sia_space_desc){
+        .size = SIA_MiB(64),
+        .slot_size = SIA_MiB(1) + 1,
+        .warm_size = SIA_KiB(128),
+        .error_callback = test_error_callback
+    });
+    TEST_ASSERT(space != NULL, "space create");
+    TEST_ASSERT(sia_space_get_slot_size(space) == SIA_MiB(2), "space slot size rounded");
+    TEST_ASSERT(sia_space_get_capacity(space) == 32, "space capacity");
+    TEST_ASSERT(!space->_noreserve, "space reserves by default");
+
+    sia_desc desc = {
+        .desired_block_size = SIA_KiB(64),
+        .error_callback = test_error_callback,
+        .space = space
+    };
+
+    si_arena* arenas[3] = { 0 };
+    for (int i = 0; i < 3; i++) {
+        arenas[i] = sia_create(&desc);
+        TEST_ASSERT(arenas[i] != NULL, "space arena create");
+        TEST_ASSERT(((sia_u64)arenas[i] & (SIA_MiB(2) - 1)) == 0, "space slot aligned");
+        TEST_ASSERT(sia_get_size(arenas[i]) == SIA_MiB(2), "space arena defaults to slot");
+    }
+    TEST_ASSERT(sia_space_get_used(space) == 3, "space used");
+
+    char* data = (char*)sia_push(arenas[1], SIA_KiB(512));
+    TEST_ASSERT(data != NULL, "space push");
+    memset(data, 0xab, SIA_KiB(512));
+
+    // The slot comes back with the warm size still committed
+    si_arena* old = arenas[1];
+    sia_destroy(arenas[1]);
+    TEST_ASSERT(sia_space_get_used(space) == 2, "space slot returned");
+
+    arenas[1] = sia_create(&desc);
+    TEST_ASSERT(arenas[1] == old, "space slot recycled");
+    sia_memory_stats stats = sia_get_memory_stats(arenas[1]);
+    TEST_ASSERT(stats.num_commits == 0 && stats.committed == SIA_KiB(128), "space slot warm");
+
+    data = (char*)sia_push_zero(arenas[1], SIA_KiB(512));
+    TEST_ASSERT(data != NULL && data[SIA_KiB(512) - 1] == 0, "space recycled push");
+
+    desc.desired_max_size = SIA_MiB(4);
+    TEST_ASSERT(sia_create(&desc) == NULL, "space arena too large");
+    TEST_ASSERT(sia_get_error(NULL).code == SIA_ERR_INIT_FAILED, "space arena too large error");
+    desc.desired_max_size = 0;
+
+    for (int i = 0; i < 3; i++) {
+        sia_destroy(arenas[i]);
+    }
+    TEST_ASSERT(sia_space_get_used(space) == 0, "space empty");
+
+    // Every slot can be handed out, and no more
+    si_arena* all[32] = { 0 };
+    for (int i = 0; i < 32; i++) {
+        all[i] = sia_create(&desc);
+        TEST_ASSERT(all[i] != NULL, "space fill");
+    }
+    TEST_ASSERT(sia_create(&desc) == NULL, "space full");
+    for (int i = 0; i < 32; i++) {
+        sia_destroy(all[i]);
+    }
+
+    sia_space_destroy(space);
+
+#ifdef SIA_HAS_NORESERVE
+    sia_space* lazy_space = sia_space_create(&(sia_space_desc){
+        .size = SIA_MiB(8),
+        .slot_size = SIA_MiB(1),
+        .error_callback = test_error_callback,
+        .flags = SIA_FLAG_NORESERVE
+    });
+    TEST_ASSERT(lazy_space != NULL && lazy_space->_noreserve, "space noreserve");
+
+    si_arena* lazy = sia_create(&(sia_desc){ .error_callback = test_error_callback, .space = lazy_space });
+    TEST_ASSERT(lazy != NULL && (lazy->_flags & SIA_FLAG_NORESERVE), "space noreserve arena");
+    data = (char*)sia_push_zero(lazy, SIA_KiB(256));
+    TEST_ASSERT(data != NULL && data[SIA_KiB(256) - 1] == 0, "space noreserve push");
+
+    sia_destroy(lazy);
+    sia_space_destroy(lazy_space);
+#endif
+#endif
+
+    return true;
+}
+
+bool test_string(void) {
+    si_arena* text = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(16),
+        .desired_block_size = SIA_KiB(64),
+        .error_callback = test_error_callback
+    });
+    TEST_ASSERT(text != NULL, "string arena create");
+
+    sia_u64 start_pos = sia_get_pos(text);
+
+    sia_str_builder builder = sia_str_begin(text);
+    sia_str_append(&builder, SIA_STR("GET "));
+    sia_str_append_cstr(&builder, "/index");
+    sia_str_append_char(&builder, '?');
+    sia_str_appendf(&builder, "id=%d&name=%s", 42, "sia");
+    sia_str request = sia_str_end(&builder);
+    TEST_ASSERT(sia_str_eq(request, SIA_STR("GET /index?id=42&name=sia")), "string build");
+    TEST_ASSERT(request.data[request.len] == 0, "string null terminated");
+    TEST_ASSERT(sia_get_pos(text) == start_pos + request.len + 1, "string trimmed");
+
+    // A long format grows the builder in place
+    builder = sia_str_begin(text);
+    for (int i = 0; i < 1000; i++) {
+        sia_str_appendf(&builder, "%04d,", i);
+    }
+    sia_str numbers = sia_str_end(&builder);
+    TEST_ASSERT(numbers.len == 5000, "string long build");
+    TEST_ASSERT(sia_str_eq(sia_str_slice(numbers, 4995, 5000), SIA_STR("0999,")), "string long content");
+
+    // Splits and slices point into the string
+    sia_str rest = numbers;
+    sia_str part;
+    sia_u64 count = 0;
+    while (sia_str_split(&rest, SIA_STR(","), &part)) {
+        TEST_ASSERT(part.data >= numbers.data && part.data + part.len <= numbers.data + numbers.len, "string split view");
+        count++;
+    }
+    TEST_ASSERT(count == 1001 && part.len == 0, "string split count");
+
+    TEST_ASSERT(sia_str_find(request, SIA_STR("id=")) == 11, "string find");
+    TEST_ASSERT(sia_str_find(request, SIA_STR("missing")) == SIA_STR_NPOS, "string find missing");
+    TEST_ASSERT(sia_str_slice(request, 4, 100).len == request.len - 4, "string slice clamp");
+
+    sia_str parts[3] = { SIA_STR("a"), SIA_STR("bb"), SIA_STR("ccc") };
+    sia_str joined = sia_str_join(text, parts, 3, SIA_STR(", "));
+    TEST_ASSERT(sia_str_eq(joined, SIA_STR("a, bb, ccc")), "string join");
+
+    sia_str formatted = sia_str_fmt(text, "%s-%u", "key", 7u);
+    TEST_ASSERT(sia_str_eq(formatted, SIA_STR("key-7")), "string fmt");
+
+    // A push in the middle of a build moves the builder instead of overwriting the push
+    builder = sia_str_begin(text);
+    sia_str_append(&builder, SIA_STR("first"));
+    char* other = (char*)sia_push(text, 16);
+    memset(other, 'x', 16);
+    for (int i = 0; i < 64; i++) {
+        sia_str_append(&builder, SIA_STR(" more"));
+    }
+    sia_str moved = sia_str_end(&builder);
+    TEST_ASSERT(moved.len == 5 + 64 * 5 && other[15] == 'x', "string moved build");
+
+    sia_destroy(text);
+
+    return true;
+}
+
+static sia_u32 budget_calls = 0;
+static sia_u32 budget_tag = 0;
+static void test_budget_callback(si_arena* budget_arena, sia_u32 tag, sia_u64 bytes) {
+    (void)budget_arena;
+    (void)bytes;
+    budget_calls++;
+    budget_tag = tag;
+}
+
+bool test_tags(void) {
+    enum { TAG_NET = 1, TAG_CACHE = 2 };
+
+    si_arena* shared = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(64),
+        .desired_block_size = SIA_KiB(64),
+        .error_callback = test_error_callback,
+        .budget_callback = test_budget_callback
+    });
+    TEST_ASSERT(shared != NULL, "tags create");
+    sia_set_tag_budget(shared, TAG_CACHE, SIA_KiB(100));
+
+    sia_temp temp = sia_temp_begin(shared);
+    char* packet = (char*)sia_push_tagged(shared, 1000, TAG_NET);
+    TEST_ASSERT(packet != NULL, "tags push");
+    sia_u64 after_packet = sia_get_pos(shared);
+    sia_push(shared, 500);
+    char* zeroed = (char*)sia_push_zero_tagged(shared, SIA_KiB(64), TAG_CACHE);
+    TEST_ASSERT(zeroed != NULL && zeroed[SIA_KiB(64) - 1] == 0, "tags push zero");
+    TEST_ASSERT(sia_get_tag_bytes(shared, TAG_NET) == 1000, "tags net bytes");
+    TEST_ASSERT(sia_get_tag_bytes(shared, TAG_CACHE) == SIA_KiB(64), "tags cache bytes");
+    TEST_ASSERT(budget_calls == 0, "tags under budget");
+
+    // The last tagged push grows in place, and crosses the budget
+    char* grown = (char*)sia_realloc_tagged(shared, zeroed, SIA_KiB(64), SIA_KiB(128), TAG_CACHE);
+    TEST_ASSERT(grown == zeroed, "tags realloc in place");
+    TEST_ASSERT(sia_get_tag_bytes(shared, TAG_CACHE) == SIA_KiB(128), "tags realloc bytes");
+    TEST_ASSERT(budget_calls == 1 && budget_tag == TAG_CACHE, "tags budget callback");
+    sia_push_tagged(shared, 16, TAG_CACHE);
+    TEST_ASSERT(budget_calls == 1, "tags budget callback once");
+
+    // Popping the untagged push and the allocations after it keeps the packet counted
+    sia_pop_to(shared, after_packet);
+    TEST_ASSERT(sia_get_tag_bytes(shared, TAG_CACHE) == 0, "tags pop");
+    TEST_ASSERT(sia_get_tag_bytes(shared, TAG_NET) == 1000, "tags pop keeps older");
+
+    sia_pool* pool = sia_pool_create(&(sia_pool_desc){
+        .arena = shared,
+        .block_size = 64,
+        .initial_capacity = 32,
+        .tag = TAG_NET
+    });
+    TEST_ASSERT(pool != NULL, "tags pool create");
+    TEST_ASSERT(sia_get_tag_bytes(shared, TAG_NET) >= 1000 + 64 * 32, "tags pool bytes");
+
+    sia_temp_end(temp);
+    TEST_ASSERT(sia_get_tag_bytes(shared, TAG_NET) == 0, "tags temp end");
+
+    TEST_ASSERT(sia_push_tagged(shared, 16, SIA_MAX_TAGS) == NULL, "tags invalid");
+    TEST_ASSERT(sia_get_error(shared).code == SIA_ERR_INVALID_TAG, "tags invalid error");
+
+    sia_destroy(shared);
+
+    return true;
+}
+
+static si_arena* trim_victim = NULL;
+static si_arena* trim_arena = NULL;
+static sia_u32 trim_calls = 0;
+static void test_trim_callback(si_arena* pushing, sia_u64 used, void* user) {
+    (void)used;
+    trim_calls++;
+    trim_arena = pushing;
+    if (*(bool*)user && trim_victim != NULL) {
+        sia_reset(trim_victim);
+    }
+}
+
+bool test_governor(void) {
+    bool free_victim = false;
+    sia_governor_set(&(sia_governor_desc){ .limit = SIA_MiB(2), .watermark = SIA_MiB(1) });
+    TEST_ASSERT(sia_governor_add_trim(test_trim_callback, &free_victim), "governor add trim");
+
+    sia_desc desc = {
+        .desired_max_size = SIA_MiB(16),
+        .desired_block_size = SIA_KiB(64),
+        .error_callback = test_error_callback,
+        .flags = SIA_FLAG_GOVERNED
+    };
+
+    sia_u64 start_used = sia_governor_get_used();
+    trim_victim = sia_create(&desc);
+    TEST_ASSERT(trim_victim != NULL, "governor create");
+    TEST_ASSERT(sia_governor_get_used() == start_used + SIA_KiB(64), "governor initial commit");
+
+    // The malloc backend keeps the first node on a reset, so the victim uses it too
+    TEST_ASSERT(sia_push(trim_victim, SIA_KiB(32)) != NULL, "governor push");
+    TEST_ASSERT(sia_push(trim_victim, SIA_KiB(768)) != NULL, "governor push");
+    TEST_ASSERT(trim_calls == 0, "governor below watermark");
+
+    // Crossing the watermark only notifies
+    si_arena* pusher = sia_create(&desc);
+    TEST_ASSERT(sia_push(pusher, SIA_KiB(512)) != NULL, "governor push over watermark");
+    TEST_ASSERT(trim_calls == 1 && trim_arena == pusher, "governor watermark trim");
+
+    // Going over the limit trims once more, which frees enough for the push
+    free_victim = true;
+    TEST_ASSERT(sia_push(pusher, SIA_MiB(1)) != NULL, "governor push after trim");
+    TEST_ASSERT(trim_calls == 2, "governor limit trim");
+    TEST_ASSERT(sia_governor_get_used() <= start_used + SIA_MiB(2), "governor under limit");
+
+    TEST_ASSERT(sia_push(pusher, SIA_MiB(4)) == NULL, "governor limit");
+    TEST_ASSERT(sia_get_error(pusher).code == SIA_ERR_GOVERNOR_LIMIT, "governor limit error");
+
+    sia_destroy(pusher);
+    sia_destroy(trim_victim);
+    trim_victim = NULL;
+    TEST_ASSERT(sia_governor_get_used() == start_used, "governor released");
+
+    sia_governor_remove_trim(test_trim_callback, &free_victim);
+
+    // Large objects are charged for their own mappings
+    sia_governor_set(&(sia_governor_desc){ .limit = SIA_MiB(8) });
+    si_arena* large = sia_create(&(sia_desc){
+        .desired_max_size = SIA_MiB(16),
+        .desired_block_size = SIA_KiB(64),
+        .error_callback = test_error_callback,
+        .large_threshold = SIA_MiB(1),
+        .flags = SIA_FLAG_GOVERNED
+    });
+    TEST_ASSERT(large != NULL, "governor large create");
+    sia_u64 large_pos = sia_get_pos(large);
+    sia_u64 large_used = sia_governor_get_used();
+
+    char* data = (char*)sia_push(large, SIA_MiB(2));
+    TEST_ASSERT(data != NULL, "governor large push");
+    TEST_ASSERT(sia_governor_get_used() >= large_used + SIA_MiB(2), "governor large charged");
+
+    data = (char*)sia_realloc(large, data, SIA_MiB(2), SIA_MiB(4));
+    TEST_ASSERT(data != NULL, "governor large realloc");
+    TEST_ASSERT(sia_governor_get_used() >= large_used + SIA_MiB(4), "governor large realloc charged");
+
+    TEST_ASSERT(sia_push(large, SIA_MiB(512)) == NULL, "governor large limit");
+    TEST_ASSERT(sia_get_error(large).code == SIA_ERR_GOVERNOR_LIMIT, "governor large limit error");
+    TEST_ASSERT(sia_realloc(large, data, SIA_MiB(4), SIA_MiB(16)) == NULL, "governor large realloc limit");
+
+    sia_pop_to(large, large_pos);
+    TEST_ASSERT(sia_governor_get_used() == large_used, "governor large refunded");
+
+    sia_destroy(large);
+    TEST_ASSERT(sia_governor_get_used() == start_used, "governor large released");
+
+    sia_governor_set(NULL);
+
+    return true;
+}
+
+bool test_io(void) {
+#ifdef __linux__
+    si_arena* io = sia_create(&(sia_desc){ .desired_max_size = SIA_MiB(16), .error_callback = test_error_callback });
+    sia_u64 start = sia_get_pos(io);
+
+    // Only what was read stays pushed
+    int fds[2];
+    TEST_ASSERT(pipe(fds) == 0, "io pipe");
+    TEST_ASSERT(write(fds[1], "hello", 5) == 5, "io pipe write");
+
+    sia_u64 size = 0;
+    char* read_data = (char*)sia_push_read(io, fds[0], 64, &size);
+    TEST_ASSERT(read_data != NULL && size == 5 && memcmp(read_data, "hello", 5) == 0, "io push read");
+    TEST_ASSERT(sia_get_pos(io) == start + 5, "io push read gives back the tail");
+
+    close(fds[1]);
+    TEST_ASSERT(sia_push_read(io, fds[0], 64, &size) == NULL && size == 0, "io push read end");
+    TEST_ASSERT(sia_get_pos(io) == start + 5, "io push read end pops everything");
+    TEST_ASSERT(sia_get_error(io).code == SIA_ERR_NONE, "io push read end is not an error");
+    close(fds[0]);
+    sia_pop_to(io, start);
+
+    char path[] = "/tmp/sia_test_io_XXXXXX";
+    int fd = mkstemp(path);
+    TEST_ASSERT(fd >= 0, "io temp file");
+    sia_u8 expected[10000];
+    for (int i = 0; i < 10000; i++) {
+        expected[i] = (sia_u8)(i * 7);
+    }
+    TEST_ASSERT(write(fd, expected, sizeof(expected)) == (ssize_t)sizeof(expected), "io temp write");
+    close(fd);
+
+    sia_u8* file = (sia_u8*)sia_push_file(io, path, SIA_FILE_NONE, &size);
+    TEST_ASSERT(file != NULL && size == sizeof(expected), "io push file");
+    TEST_ASSERT(memcmp(file, expected, size) == 0 && file[size] == 0, "io push file data");
+    TEST_ASSERT(sia_get_pos(io) == start + size + 1, "io push file trims the tail");
+
+    // Works the same on file systems without O_DIRECT (tmpfs), which fall back to regular reads
+    sia_u8* direct = (sia_u8*)sia_push_file(io, path, SIA_FILE_DIRECT, &size);
+    TEST_ASSERT(direct != NULL && size == sizeof(expected), "io push file direct");
+    TEST_ASSERT(((sia_u64)direct & 511) == 0, "io push file direct alignment");
+    TEST_ASSERT(memcmp(direct, expected, size) == 0 && direct[size] == 0, "io push file direct data");
+
+    // No size up front, so the buffer grows while reading
+    char* status = (char*)sia_push_file(io, "/proc/self/status", SIA_FILE_NONE, &size);
+    TEST_ASSERT(status != NULL && size > 0 && strncmp(status, "Name:", 5) == 0, "io push file without size");
+    TEST_ASSERT(strlen(status) == size, "io push file without size terminator");
+    sia_pop_to(io, start);
+
+    const sia_u8* mapped = (const sia_u8*)sia_map_file(io, path, &size);
+    TEST_ASSERT(mapped != NULL && size == sizeof(expected), "io map file");
+    TEST_ASSERT(memcmp(mapped, expected, size) == 0, "io map file data");
+    TEST_ASSERT(sia_get_pos(io) > start, "io map file record");
+    sia_pop_to(io, start);
+
+    TEST_ASSERT(sia_push_file(io, "/tmp/sia_test_io_missing", SIA_FILE_NONE, &size) == NULL && size == 0, "io missing file");
+    TEST_ASSERT(sia_get_error(io).code == SIA_ERR_IO_FAILED, "io missing file error");
+
+    // Running out of memory while growing gives back everything that was pushed
+    si_arena* small = sia_create(&(sia_desc){ .desired_max_size = SIA_KiB(64), .error_callback = test_error_callback });
+    TEST_ASSERT(small != NULL && pipe(fds) == 0, "io small arena");
+    static sia_u8 pipe_data[SIA_KiB(40)];
+    TEST_ASSERT(write(fds[1], pipe_data, sizeof(pipe_data)) == (ssize_t)sizeof(pipe_data), "io pipe fill");
+    close(fds[1]);
+
+    char pipe_path[64];
+    snprintf(pipe_path, sizeof(pipe_path), "/proc/self/fd/%d", fds[0]);
+    sia_u64 small_start = sia_get_pos(small);
+    TEST_ASSERT(sia_push_file(small, pipe_path, SIA_FILE_NONE, &size) == NULL && size == 0, "io push file out of memory");
+    TEST_ASSERT(sia_get_error(small).code == SIA_ERR_REALLOC_FAILED, "io push file out of memory error");
+    TEST_ASSERT(sia_get_pos(small) == small_start, "io push file out of memory pops");
+    close(fds[0]);
+    sia_destroy(small);
+
+    remove(path);
+    sia_destroy(io);
+#endif
+    return true;
+}
+
+bool test_cache(void) {
+#ifndef SIA_FORCE_MALLOC
+    sia_cache_set_limit(SIA_KiB(256));
+
+    sia_desc desc = {
+        .desired_max_size = SIA_MiB(1),
+        .desired_block_size = SIA_KiB(64),
+        .error_callback = test_error_callback
+    };
+
+    // Only the first block stays committed in the cache
+    si_arena* first = sia_create(&desc);
+    TEST_ASSERT(first != NULL, "cache create");
+    TEST_ASSERT(sia_push(first, SIA_KiB(200)) != NULL, "cache push");
+    sia_destroy(first);
+    TEST_ASSERT(sia_cache_get_retained() == SIA_KiB(64), "cache retained");
+
+    si_arena* second = sia_create(&desc);
+    TEST_ASSERT(second == first, "cache reuse");
+    TEST_ASSERT(sia_get_pos(second) == SIA_MIN_POS && sia_cache_get_retained() == 0, "cache reuse reset");
+    TEST_ASSERT(second->_num_commits == 0, "cache reuse without commit");
+    TEST_ASSERT(sia_push(second, SIA_KiB(200)) != NULL, "cache push after reuse");
+
+    // Sizes round up to a power of 2, so both sizes share the class
+    si_arena* other = sia_create(&(sia_desc){ .desired_max_size = SIA_KiB(700), .desired_block_size = SIA_KiB(64) });
+    sia_destroy(second);
+    sia_destroy(other);
+    TEST_ASSERT(sia_cache_get_retained() == SIA_KiB(128), "cache two arenas");
+
+    si_arena* larger = sia_create(&(sia_desc){ .desired_max_size = SIA_MiB(4), .desired_block_size = SIA_KiB(64) });
+    TEST_ASSERT(larger != first && larger != other, "cache other class");
+    TEST_ASSERT(sia_cache_get_retained() == SIA_KiB(128), "cache other class keeps");
+    sia_destroy(larger);
+    TEST_ASSERT(sia_cache_get_retained() == SIA_KiB(192), "cache other class give");
+
+    // Over the limit, arenas are released as before
+    desc.desired_max_size = SIA_MiB(2);
+    si_arena* extra[2] = { sia_create(&desc), sia_create(&desc) };
+    sia_destroy(extra[0]);
+    sia_destroy(extra[1]);
+    TEST_ASSERT(sia_cache_get_retained() == SIA_KiB(256), "cache limit");
+
+    sia_cache_trim(SIA_KiB(100));
+    TEST_ASSERT(sia_cache_get_retained() <= SIA_KiB(100), "cache trim");
+    sia_cache_set_limit(0);
+    TEST_ASSERT(sia_cache_get_retained() == 0, "cache disable");
+#endif
     return true;
 }
 
@@ -200,9 +1529,33 @@ bool test_scratch(void) {
     X(PUSH, push) \
     X(GETTERS, getters) \
     X(POP, pop) \
+    X(FAST_PATH, fast_path) \
     X(TEMP, temp) \
     X(DESTROY, destroy) \
-    X(SCRATCH, scratch)
+    X(SCRATCH, scratch) \
+    X(GUARD, guard) \
+    X(ALIGNED, aligned) \
+    X(CLEANUP, cleanup) \
+    X(BUFFER, buffer) \
+    X(CHECKPOINT, checkpoint) \
+    X(STATS, stats) \
+    X(REGISTRY, registry) \
+    X(RING, ring) \
+    X(FRAMES, frames) \
+    X(BITMAP, bitmap) \
+    X(SLOT_MAP, slot_map) \
+    X(TLSF, tlsf) \
+    X(SCOPE, scope) \
+    X(LARGE, large) \
+    X(TRACE, trace) \
+    X(ADAPTIVE, adaptive) \
+    X(NORESERVE, noreserve) \
+    X(SPACE, space) \
+    X(STRING, string) \
+    X(TAGS, tags) \
+    X(GOVERNOR, governor) \
+    X(IO, io) \
+    X(CACHE, cache)
 
 enum {
 #define X(name, func_name) TEST_##name,
@@ -0,0 +1,297 @@
+// Routes malloc, calloc, realloc, and free into scratch arenas inside of sia_scope_begin/sia_scope_end.
+// Outside of a scope, every call goes to the real allocator.
+//
+// Build (Linux):
+//     cc -shared -fPIC -O2 -ftls-model=initial-exec -o libsia_preload.so tools/sia_preload.c -ldl
+//
+// Run:
+//     LD_PRELOAD=./libsia_preload.so ./program
+//
+// The program starts and ends scopes with the functions from si_arena.h.
+// Link it against libsia_preload.so, or find them with dlsym(RTLD_DEFAULT, "sia_scope_begin")
+//
+// Test:
+//     test/test_preload.sh
+
+#ifndef __linux__
+#   error "sia_preload only supports Linux"
+#endif
+#ifdef SIA_FORCE_MALLOC
+#   error "sia_preload needs the low level backend, the malloc backend would call itself"
+#endif
+
+#ifndef _GNU_SOURCE
+#   define _GNU_SOURCE
+#endif
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stddef.h>
+#include <string.h>
+
+// stdio can call malloc
+#define SIA_NO_STDIO
+#define SI_ARENA_IMPL
+// Wrapped below, so the scratch arenas of every thread go in one address space
+#define sia_scope_begin _sia_preload_scope_begin
+#include "../si_arena.h"
+#undef sia_scope_begin
+
+#define EXPORT __attribute__((visibility("default")))
+
+// Every allocation made in a scope has this right before it, for realloc.
+// Whether a pointer is scope memory is decided by its address, never by the header
+typedef struct {
+    sia_u64 size;
+} scope_header;
+
+#define SCOPE_ALIGN 16
+
+typedef void* (malloc_func)(size_t);
+typedef void* (calloc_func)(size_t, size_t);
+typedef void* (realloc_func)(void*, size_t);
+typedef void (free_func)(void*);
+typedef int (memalign_func)(void**, size_t, size_t);
+typedef size_t (usable_size_func)(void*);
+
+static malloc_func* real_malloc = NULL;
+static calloc_func* real_calloc = NULL;
+static realloc_func* real_realloc = NULL;
+static free_func* real_free = NULL;
+static memalign_func* real_posix_memalign = NULL;
+static usable_size_func* real_usable_size = NULL;
+
+// dlsym can allocate before the real functions are known
+static sia_u8 bootstrap_memory[SIA_KiB(16)] __attribute__((aligned(SCOPE_ALIGN)));
+static sia_u64 bootstrap_pos = 0;
+static SIA_THREAD_VAR sia_b32 resolving = SIA_FALSE;
+
+static void resolve(void) {
+    if (real_free != NULL) {
+        return;
+    }
+
+    resolving = SIA_TRUE;
+    real_malloc = (malloc_func*)dlsym(RTLD_NEXT, "malloc");
+    real_calloc = (calloc_func*)dlsym(RTLD_NEXT, "calloc");
+    real_realloc = (realloc_func*)dlsym(RTLD_NEXT, "realloc");
+    real_posix_memalign = (memalign_func*)dlsym(RTLD_NEXT, "posix_memalign");
+    real_usable_size = (usable_size_func*)dlsym(RTLD_NEXT, "malloc_usable_size");
+    // Set last, because it is what resolve checks
+    __atomic_store_n(&real_free, (free_func*)dlsym(RTLD_NEXT, "free"), __ATOMIC_RELEASE);
+    resolving = SIA_FALSE;
+}
+
+static void* bootstrap_alloc(size_t size) {
+    sia_u64 start = __atomic_fetch_add(&bootstrap_pos, SIA_ALIGN_UP_POW2(size, SCOPE_ALIGN), __ATOMIC_RELAXED);
+    if (start + size > sizeof(bootstrap_memory)) {
+        return NULL;
+    }
+    // Zeroed, since the bootstrap memory is never reused
+    return bootstrap_memory + start;
+}
+
+static sia_b32 is_bootstrap(void* ptr) {
+    return (sia_u8*)ptr >= bootstrap_memory && (sia_u8*)ptr < bootstrap_memory + sizeof(bootstrap_memory);
+}
+
+// Holds the scratch arenas of every thread, so scope memory from any thread is one range
+static sia_space* scope_space = NULL;
+static SIA_THREAD_VAR sia_b32 scope_ready = SIA_FALSE;
+
+static sia_space* get_space(void) {
+    sia_space* space = __atomic_load_n(&scope_space, __ATOMIC_ACQUIRE);
+    if (space != NULL) {
+        return space;
+    }
+
+    // Only reserves address space, so it does not allocate.
+    // Systems that limit the address space get a smaller one, down to 16 threads with 2 scratch arenas
+    sia_space* created = NULL;
+    for (sia_u64 size = SIA_GiB(256); created == NULL && size >= SIA_GiB(2); size /= 2) {
+        created = sia_space_create(&(sia_space_desc){ .size = size });
+        sia_space_get_error(NULL);
+    }
+    if (created == NULL) {
+        return NULL;
+    }
+    if (!__atomic_compare_exchange_n(&scope_space, &space, created, SIA_FALSE, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        sia_space_destroy(created);
+    }
+    return __atomic_load_n(&scope_space, __ATOMIC_ACQUIRE);
+}
+
+static sia_b32 is_scope(void* ptr) {
+    sia_space* space = __atomic_load_n(&scope_space, __ATOMIC_ACQUIRE);
+    if (space == NULL) {
+        return SIA_FALSE;
+    }
+
+    sia_u64 offset = (sia_u64)((uintptr_t)ptr - (uintptr_t)space->_slots);
+    return offset < sia_space_get_slot_size(space) * sia_space_get_capacity(space);
+}
+
+static scope_header* get_header(void* ptr) {
+    return is_scope(ptr) ? (scope_header*)ptr - 1 : NULL;
+}
+
+// Returns NULL if the arena is out of memory, or not in the address space
+// (a scratch arena made before the first scope), so that the caller can use the real allocator
+static void* scope_alloc(si_arena* arena, size_t size, size_t align, sia_b32 zero) {
+    if (!is_scope(arena)) {
+        return NULL;
+    }
+    align = SIA_MAX(align, SCOPE_ALIGN);
+
+    // The header goes at the end of a whole alignment unit in front of the allocation
+    sia_u8* start = (sia_u8*)sia_push_aligned(arena, align + size, (sia_u32)align);
+    if (start == NULL) {
+        sia_get_error(arena);
+        return NULL;
+    }
+
+    sia_u8* out = start + align;
+    scope_header* header = (scope_header*)out - 1;
+    header->size = size;
+
+    if (zero) {
+        memset(out, 0, size);
+    }
+
+    return out;
+}
+
+// The scratch arenas of a thread are made by its first scope, so the first scope puts them in the address space
+EXPORT void sia_scope_begin(void) {
+    if (!scope_ready) {
+        scope_ready = SIA_TRUE;
+
+        sia_space* space = get_space();
+        if (space != NULL) {
+            sia_scratch_set_desc(&(sia_desc){
+                .desired_max_size = sia_space_get_slot_size(space),
+                .desired_block_size = SIA_KiB(256),
+                .space = space
+            });
+        }
+    }
+
+    _sia_preload_scope_begin();
+}
+
+EXPORT void* malloc(size_t size) {
+    si_arena* arena = sia_scope_get();
+    if (arena != NULL) {
+        void* out = scope_alloc(arena, size, SCOPE_ALIGN, SIA_FALSE);
+        if (out != NULL) {
+            return out;
+        }
+    }
+
+    if (resolving) {
+        return bootstrap_alloc(size);
+    }
+    resolve();
+    return real_malloc(size);
+}
+
+EXPORT void* calloc(size_t num, size_t size) {
+    if (size != 0 && num > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    si_arena* arena = sia_scope_get();
+    if (arena != NULL) {
+        void* out = scope_alloc(arena, num * size, SCOPE_ALIGN, SIA_TRUE);
+        if (out != NULL) {
+            return out;
+        }
+    }
+
+    if (resolving) {
+        return bootstrap_alloc(num * size);
+    }
+    resolve();
+    return real_calloc(num, size);
+}
+
+EXPORT void free(void* ptr) {
+    // Scope memory is freed when the scope ends
+    if (ptr == NULL || is_bootstrap(ptr) || is_scope(ptr)) {
+        return;
+    }
+
+    resolve();
+    real_free(ptr);
+}
+
+EXPORT void* realloc(void* ptr, size_t size) {
+    if (ptr == NULL) {
+        return malloc(size);
+    }
+
+    // Real allocations stay with the real allocator, even inside of a scope.
+    // The caller can keep them past the end of the scope, when scope memory is gone
+    scope_header* header = get_header(ptr);
+    if (header == NULL && !is_bootstrap(ptr)) {
+        resolve();
+        return real_realloc(ptr, size);
+    }
+
+    sia_u64 old_size = header != NULL ?
+        header->size : sizeof(bootstrap_memory) - (sia_u64)((sia_u8*)ptr - bootstrap_memory);
+
+    // Memory from a scope or the bootstrap buffer is never freed, so it is only copied
+    void* out = malloc(size);
+    if (out != NULL) {
+        memcpy(out, ptr, SIA_MIN(old_size, size));
+    }
+
+    return out;
+}
+
+EXPORT int posix_memalign(void** out, size_t align, size_t size) {
+    if (align < sizeof(void*) || (align & (align - 1)) != 0) {
+        return EINVAL;
+    }
+
+    si_arena* arena = sia_scope_get();
+    if (arena != NULL) {
+        *out = scope_alloc(arena, size, align, SIA_FALSE);
+        if (*out != NULL) {
+            return 0;
+        }
+    }
+
+    resolve();
+    return real_posix_memalign(out, align, size);
+}
+
+EXPORT void* aligned_alloc(size_t align, size_t size) {
+    void* out = NULL;
+    int err = posix_memalign(&out, SIA_MAX(align, sizeof(void*)), size);
+    if (err != 0) {
+        errno = err;
+        return NULL;
+    }
+    return out;
+}
+
+EXPORT void* memalign(size_t align, size_t size) {
+    return aligned_alloc(align, size);
+}
+
+EXPORT size_t malloc_usable_size(void* ptr) {
+    if (ptr == NULL) {
+        return 0;
+    }
+
+    scope_header* header = get_header(ptr);
+    if (header != NULL) {
+        return header->size;
+    }
+
+    resolve();
+    return real_usable_size(ptr);
+}
@@ -0,0 +1,518 @@
+// Replays a trace recorded with SIA_ENABLE_TRACE, and reports the time, commits, page faults, and peak RSS.
+// Arenas, pools, pointers, and positions from the trace are mapped to the ones made by the replay,
+// so a trace can run with a different backend or sia_desc than the program that recorded it.
+//
+// Build (Linux or MacOS), once for each backend:
+//     cc -O2 -o sia_replay tools/sia_replay.c
+//     cc -O2 -DSIA_FORCE_MALLOC -o sia_replay_malloc tools/sia_replay.c
+//
+// Run:
+//     ./sia_replay trace.bin [--max-size BYTES] [--block-size BYTES] [--align N] [--no-touch]
+//
+// Without options, every arena is created with the sizes and alignment it had in the trace.
+// Pushed memory is written to, like the program would, unless --no-touch is given
+//
+// Test:
+//     test/test_replay.sh
+
+#if defined(_WIN32)
+#   error "sia_replay only supports Linux and MacOS"
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define SI_ARENA_IMPL
+#include "../si_arena.h"
+
+typedef struct {
+    sia_u64 max_size;
+    sia_u64 block_size;
+    sia_u32 align;
+    sia_b32 touch;
+} options;
+
+static options opts = { .touch = SIA_TRUE };
+static sia_u64 num_errors = 0;
+
+static void on_error(sia_error err) {
+    SIA_UNUSED(err);
+    num_errors++;
+}
+
+// Open addressing map from addresses in the trace to the matching values in the replay.
+// A value of 0 means the key is not mapped
+typedef struct {
+    sia_u64* keys;
+    sia_u64* values;
+    sia_u64 capacity;
+    sia_u64 count;
+} map;
+
+static sia_u64 map_hash(sia_u64 key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    return key;
+}
+
+static sia_u64 map_get(map* m, sia_u64 key) {
+    if (m->capacity == 0 || key == 0) {
+        return 0;
+    }
+
+    for (sia_u64 i = map_hash(key) & (m->capacity - 1); m->keys[i] != 0; i = (i + 1) & (m->capacity - 1)) {
+        if (m->keys[i] == key) {
+            return m->values[i];
+        }
+    }
+    return 0;
+}
+
+static void map_set(map* m, sia_u64 key, sia_u64 value) {
+    if (key == 0) {
+        return;
+    }
+
+    if ((m->count + 1) * 2 > m->capacity) {
+        map old = *m;
+        m->capacity = old.capacity == 0 ? 1024 : old.capacity * 2;
+        m->keys = (sia_u64*)calloc(m->capacity, sizeof(sia_u64));
+        m->values = (sia_u64*)calloc(m->capacity, sizeof(sia_u64));
+        m->count = 0;
+        if (m->keys == NULL || m->values == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+
+        for (sia_u64 i = 0; i < old.capacity; i++) {
+            if (old.keys[i] != 0) {
+                map_set(m, old.keys[i], old.values[i]);
+            }
+        }
+        free(old.keys);
+        free(old.values);
+    }
+
+    sia_u64 i = map_hash(key) & (m->capacity - 1);
+    while (m->keys[i] != 0 && m->keys[i] != key) {
+        i = (i + 1) & (m->capacity - 1);
+    }
+    if (m->keys[i] == 0) {
+        m->keys[i] = key;
+        m->count++;
+    }
+    m->values[i] = value;
+}
+
+// Position in the trace and the matching position in the replay.
+// Each arena keeps a stack of these, so that pops can be translated
+typedef struct {
+    sia_u64 traced;
+    sia_u64 replayed;
+} pos_pair;
+
+typedef struct {
+    si_arena* arena;
+    sia_u32 traced_align;
+    pos_pair* stack;
+    sia_u64 count;
+    sia_u64 capacity;
+} arena_state;
+
+typedef struct {
+    sia_pool* pool;
+    arena_state* state;
+} pool_state;
+
+typedef struct {
+    sia_u64 commits;
+    sia_u64 decommits;
+    sia_u64 faulted_pages;
+} totals;
+
+static map arenas = { 0 };
+static map pools = { 0 };
+static map ptrs = { 0 };
+static totals total = { 0 };
+
+// Drops every entry at or above traced, and adds the new pair
+static void sync_pos(arena_state* state, sia_u64 traced) {
+    while (state->count > 1 && state->stack[state->count - 1].traced >= traced) {
+        state->count--;
+    }
+
+    if (state->count == state->capacity) {
+        state->capacity *= 2;
+        state->stack = (pos_pair*)realloc(state->stack, state->capacity * sizeof(pos_pair));
+        if (state->stack == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+    }
+    state->stack[state->count++] = (pos_pair){ traced, sia_get_pos(state->arena) };
+}
+
+static sia_u64 translate_pos(arena_state* state, sia_u64 traced) {
+    while (state->count > 1 && state->stack[state->count - 1].traced > traced) {
+        state->count--;
+    }
+
+    pos_pair top = state->stack[state->count - 1];
+    return traced > top.traced ? top.replayed + (traced - top.traced) : top.replayed;
+}
+
+static void touch(void* ptr, sia_u64 size) {
+    if (opts.touch && ptr != NULL) {
+        memset(ptr, 0x5a, size);
+    }
+}
+
+static void destroy_arena(sia_u64 traced, arena_state* state) {
+    sia_memory_stats stats = sia_get_memory_stats(state->arena);
+    total.commits += stats.num_commits;
+    total.decommits += stats.num_decommits;
+    total.faulted_pages += stats.faulted_pages;
+
+    sia_destroy(state->arena);
+    free(state->stack);
+    free(state);
+    map_set(&arenas, traced, 0);
+}
+
+// Returns SIA_FALSE if the record is for an arena or pool created before the trace started
+static sia_b32 replay_record(const sia_trace_record* records, sia_u64 num_records, sia_u64* index) {
+    const sia_trace_record* rec = &records[*index];
+    arena_state* state = (arena_state*)map_get(&arenas, rec->target);
+    pool_state* pool = (pool_state*)map_get(&pools, rec->target);
+
+    switch (rec->op) {
+        case SIA_TRACE_CREATE: {
+            si_arena* arena = sia_create(&(sia_desc){
+                .desired_max_size = opts.max_size ? opts.max_size : rec->size,
+                .desired_block_size = (sia_u32)(opts.block_size ? opts.block_size : rec->arg),
+                .align = opts.align ? opts.align : rec->align,
+                .error_callback = on_error
+            });
+            if (arena == NULL) {
+                return SIA_FALSE;
+            }
+
+            state = (arena_state*)calloc(1, sizeof(arena_state));
+            state->arena = arena;
+            state->traced_align = rec->align;
+            state->capacity = 64;
+            state->stack = (pos_pair*)malloc(state->capacity * sizeof(pos_pair));
+            if (state->stack == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
+            state->stack[state->count++] = (pos_pair){ rec->pos, sia_get_pos(arena) };
+
+            map_set(&arenas, rec->target, (sia_u64)state);
+        } break;
+
+        case SIA_TRACE_DESTROY: {
+            if (state == NULL) {
+                return SIA_FALSE;
+            }
+            destroy_arena(rec->target, state);
+        } break;
+
+        case SIA_TRACE_PUSH: {
+            if (state == NULL) {
+                return SIA_FALSE;
+            }
+
+            // Pushes with the default alignment follow --align
+            sia_u32 align = rec->align == state->traced_align ? sia_get_align(state->arena) : rec->align;
+            void* out = sia_push_aligned(state->arena, rec->size, align);
+            touch(out, rec->size);
+
+            map_set(&ptrs, rec->result, (sia_u64)out);
+            sync_pos(state, rec->pos);
+        } break;
+
+        case SIA_TRACE_POP:
+        case SIA_TRACE_POP_TO:
+        case SIA_TRACE_TEMP_END: {
+            if (state == NULL) {
+                return SIA_FALSE;
+            }
+            sia_pop_to(state->arena, translate_pos(state, rec->pos));
+        } break;
+
+        case SIA_TRACE_RESET: {
+            if (state == NULL) {
+                return SIA_FALSE;
+            }
+            sia_reset(state->arena);
+            state->count = 1;
+        } break;
+
+        case SIA_TRACE_REALLOC: {
+            if (state == NULL) {
+                return SIA_FALSE;
+            }
+
+            // Allocations from before the trace started become new pushes
+            void* ptr = (void*)map_get(&ptrs, rec->ptr);
+            sia_u64 old_size = ptr == NULL ? 0 : rec->arg;
+            sia_u32 align = rec->align == state->traced_align ? sia_get_align(state->arena) : rec->align;
+
+            void* out = sia_realloc_aligned(state->arena, ptr, old_size, rec->size, align);
+            if (out != NULL && rec->size > old_size) {
+                touch((sia_u8*)out + old_size, rec->size - old_size);
+            }
+
+            map_set(&ptrs, rec->result, (sia_u64)out);
+            sync_pos(state, rec->pos);
+        } break;
+
+        case SIA_TRACE_TEMP_BEGIN: {
+            if (state == NULL) {
+                return SIA_FALSE;
+            }
+            sync_pos(state, rec->pos);
+        } break;
+
+        case SIA_TRACE_POOL_CREATE: {
+            state = (arena_state*)map_get(&arenas, rec->ptr);
+            if (state == NULL) {
+                return SIA_FALSE;
+            }
+
+            sia_pool* created = sia_pool_create(&(sia_pool_desc){
+                .arena = state->arena,
+                .block_size = rec->size,
+                .align = rec->align,
+                .initial_capacity = rec->arg,
+                .flags = (sia_u32)rec->result
+            });
+            if (created == NULL) {
+                return SIA_FALSE;
+            }
+
+            pool = (pool_state*)malloc(sizeof(pool_state));
+            if (pool == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
+            *pool = (pool_state){ created, state };
+            map_set(&pools, rec->target, (sia_u64)pool);
+            sync_pos(state, rec->pos);
+        } break;
+
+        case SIA_TRACE_POOL_DESTROY: {
+            if (pool == NULL) {
+                return SIA_FALSE;
+            }
+            sia_pool_destroy(pool->pool);
+            free(pool);
+            map_set(&pools, rec->target, 0);
+        } break;
+
+        case SIA_TRACE_POOL_GROW: {
+            if (pool == NULL) {
+                return SIA_FALSE;
+            }
+            sia_pool_grow(pool->pool, rec->size);
+            sync_pos(pool->state, rec->pos);
+        } break;
+
+        case SIA_TRACE_POOL_ALLOC: {
+            if (pool == NULL) {
+                return SIA_FALSE;
+            }
+
+            void* out = sia_pool_alloc(pool->pool);
+            touch(out, sia_pool_get_block_size(pool->pool));
+
+            map_set(&ptrs, rec->result, (sia_u64)out);
+            sync_pos(pool->state, rec->pos);
+        } break;
+
+        case SIA_TRACE_POOL_FREE: {
+            void* ptr = (void*)map_get(&ptrs, rec->ptr);
+            if (pool == NULL || ptr == NULL) {
+                return SIA_FALSE;
+            }
+            sia_pool_free(pool->pool, ptr);
+        } break;
+
+        case SIA_TRACE_POOL_ALLOC_N:
+        case SIA_TRACE_POOL_FREE_N: {
+            // The pointers are in the records after this one
+            sia_u64 num = rec->op == SIA_TRACE_POOL_FREE_N || rec->result ? rec->size : 0;
+            num = SIA_MIN(num, num_records - *index - 1);
+            const sia_trace_record* batch = rec + 1;
+            *index += num;
+
+            if (pool == NULL) {
+                return SIA_FALSE;
+            }
+
+            void** replayed = (void**)malloc(SIA_MAX(num, 1) * sizeof(void*));
+            if (replayed == NULL) {
+                fprintf(stderr, "Out of memory\n");
+                exit(1);
+            }
+
+            if (rec->op == SIA_TRACE_POOL_ALLOC_N) {
+                if (sia_pool_alloc_n(pool->pool, replayed, rec->size)) {
+                    for (sia_u64 i = 0; i < num; i++) {
+                        touch(replayed[i], sia_pool_get_block_size(pool->pool));
+                        map_set(&ptrs, batch[i].result, (sia_u64)replayed[i]);
+                    }
+                }
+                sync_pos(pool->state, rec->pos);
+            } else {
+                sia_u64 num_found = 0;
+                for (sia_u64 i = 0; i < num; i++) {
+                    void* ptr = (void*)map_get(&ptrs, batch[i].ptr);
+                    if (ptr != NULL) {
+                        replayed[num_found++] = ptr;
+                    }
+                }
+                sia_pool_free_n(pool->pool, replayed, num_found);
+            }
+
+            free(replayed);
+        } break;
+
+        default: {
+            return SIA_FALSE;
+        } break;
+    }
+
+    return SIA_TRUE;
+}
+
+static sia_u64 parse_size(const char* str) {
+    char* end = NULL;
+    sia_u64 out = strtoull(str, &end, 0);
+
+    switch (*end) {
+        case 'k': case 'K': out = SIA_KiB(out); break;
+        case 'm': case 'M': out = SIA_MiB(out); break;
+        case 'g': case 'G': out = SIA_GiB(out); break;
+        default: break;
+    }
+
+    return out;
+}
+
+static void print_usage(const char* name) {
+    fprintf(stderr, "Usage: %s trace [--max-size BYTES] [--block-size BYTES] [--align N] [--no-touch]\n", name);
+    fprintf(stderr, "Sizes take a K, M, or G suffix\n");
+}
+
+int main(int argc, char** argv) {
+    const char* path = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+            opts.max_size = parse_size(argv[++i]);
+        } else if (strcmp(argv[i], "--block-size") == 0 && i + 1 < argc) {
+            opts.block_size = parse_size(argv[++i]);
+        } else if (strcmp(argv[i], "--align") == 0 && i + 1 < argc) {
+            opts.align = (sia_u32)parse_size(argv[++i]);
+        } else if (strcmp(argv[i], "--no-touch") == 0) {
+            opts.touch = SIA_FALSE;
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            print_usage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (path == NULL) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return 1;
+    }
+
+    sia_trace_header header;
+    if (fread(&header, sizeof(header), 1, file) != 1 ||
+        memcmp(header.magic, SIA_TRACE_MAGIC, sizeof(header.magic)) != 0 ||
+        header.version != SIA_TRACE_VERSION || header.record_size != sizeof(sia_trace_record)) {
+        fprintf(stderr, "%s is not a trace from this version of si_arena\n", path);
+        fclose(file);
+        return 1;
+    }
+
+    // The whole trace is loaded first, so that reading it is not part of the time
+    fseek(file, 0, SEEK_END);
+    sia_u64 num_records = ((sia_u64)ftell(file) - sizeof(header)) / sizeof(sia_trace_record);
+    fseek(file, sizeof(header), SEEK_SET);
+
+    sia_trace_record* records = (sia_trace_record*)malloc(SIA_MAX(num_records, 1) * sizeof(sia_trace_record));
+    if (records == NULL || fread(records, sizeof(sia_trace_record), num_records, file) != num_records) {
+        fprintf(stderr, "Failed to read %s\n", path);
+        fclose(file);
+        return 1;
+    }
+    fclose(file);
+
+    struct rusage usage_before;
+    getrusage(RUSAGE_SELF, &usage_before);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    sia_u64 num_skipped = 0;
+    for (sia_u64 i = 0; i < num_records; i++) {
+        if (!replay_record(records, num_records, &i)) {
+            num_skipped++;
+        }
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    struct rusage usage_after;
+    getrusage(RUSAGE_SELF, &usage_after);
+
+    // Arenas that were still alive at the end of the trace
+    for (sia_u64 i = 0; i < arenas.capacity; i++) {
+        if (arenas.values[i] != 0) {
+            destroy_arena(arenas.keys[i], (arena_state*)arenas.values[i]);
+        }
+    }
+
+    double ns = (double)(end.tv_sec - start.tv_sec) * 1e9 + (double)(end.tv_nsec - start.tv_nsec);
+
+#ifdef SIA_FORCE_MALLOC
+    const char* backend = "malloc";
+#else
+    const char* backend = "low level";
+#endif
+
+#ifdef __APPLE__
+    // Bytes on MacOS, KiB everywhere else
+    long max_rss_kib = usage_after.ru_maxrss / 1024;
+#else
+    long max_rss_kib = usage_after.ru_maxrss;
+#endif
+
+    printf("backend:       %s\n", backend);
+    printf("records:       %llu (%llu skipped)\n", (unsigned long long)num_records, (unsigned long long)num_skipped);
+    printf("time:          %.3f ms (%.1f ns per record)\n", ns / 1e6, num_records ? ns / (double)num_records : 0.0);
+    printf("commits:       %llu\n", (unsigned long long)total.commits);
+    printf("decommits:     %llu\n", (unsigned long long)total.decommits);
+    printf("faulted pages: %llu\n", (unsigned long long)total.faulted_pages);
+    printf("page faults:   %ld\n", usage_after.ru_minflt - usage_before.ru_minflt);
+    printf("peak rss:      %ld KiB\n", max_rss_kib);
+    printf("errors:        %llu\n", (unsigned long long)num_errors);
+
+    free(records);
+    return 0;
+}